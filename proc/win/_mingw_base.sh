@@ -26,6 +26,7 @@ libs=(
 	-lWinmm
 	-lAdvapi32
 	-lm
+	-lpthread
 )
 
 # Build game
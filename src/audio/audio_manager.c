@@ -22,6 +22,13 @@ void mg_audio_manager_init()
 	// Allocate
 	g_audio_manager		= gs_malloc_init(mg_audio_manager_t);
 	g_audio_manager->assets = gs_dyn_array_new(mg_audio_asset_t);
+	mg_name_map_init(&g_audio_manager->lookup, 64);
+
+	g_audio_manager->snd_master			   = mg_cvar("snd_master");
+	g_audio_manager->snd_mixers[MG_AUDIO_TYPE_EFFECT]  = mg_cvar("snd_effect");
+	g_audio_manager->snd_mixers[MG_AUDIO_TYPE_MUSIC]   = mg_cvar("snd_music");
+	g_audio_manager->snd_mixers[MG_AUDIO_TYPE_AMBIENT] = mg_cvar("snd_ambient");
+	g_audio_manager->cl_timescale			   = mg_cvar("cl_timescale");
 
 	// Player sounds
 	_mg_audio_manager_load("player/jump1.wav", MG_AUDIO_TYPE_EFFECT, false, false, 1.0f);
@@ -35,42 +42,43 @@ void mg_audio_manager_free()
 	}
 
 	gs_dyn_array_free(g_audio_manager->assets);
+	mg_name_map_free(&g_audio_manager->lookup);
 	gs_free(g_audio_manager);
 	g_audio_manager = NULL;
 }
 
 void mg_audio_manager_play(char *name, float pitch_var)
 {
-	mg_audio_asset_t *asset = _mg_audio_manager_find(name);
-	if (asset == NULL)
+	uint32_t handle = mg_name_map_find(&g_audio_manager->lookup, name);
+	if (handle == MG_NAME_MAP_INVALID)
 	{
 		mg_println("WARN: mg_audio_manager_play invalid audio %s", name);
 		return;
 	}
 
-	mg_cvar_t *snd_master = mg_cvar("snd_master");
-	mg_cvar_t *snd_mixer  = NULL;
-	switch (asset->type)
+	mg_audio_manager_play_handle(handle, pitch_var);
+}
+
+// Plays audio resolved with mg_audio_manager_get_handle, ignores invalid handles
+void mg_audio_manager_play_handle(uint32_t handle, float pitch_var)
+{
+	if (handle >= gs_dyn_array_size(g_audio_manager->assets))
+	{
+		return;
+	}
+
+	mg_audio_asset_t *asset = &g_audio_manager->assets[handle];
+	mg_cvar_t *snd_mixer	= g_audio_manager->snd_master;
+	if (asset->type < MG_AUDIO_TYPE_COUNT)
+	{
+		snd_mixer = g_audio_manager->snd_mixers[asset->type];
+	}
+	else
 	{
-	case MG_AUDIO_TYPE_EFFECT:
-		snd_mixer = mg_cvar("snd_effect");
-		break;
-
-	case MG_AUDIO_TYPE_MUSIC:
-		snd_mixer = mg_cvar("snd_music");
-		break;
-
-	case MG_AUDIO_TYPE_AMBIENT:
-		snd_mixer = mg_cvar("snd_ambient");
-		break;
-
-	default:
-		mg_println("WARN: mg_audio_manager_play invalid type %d", asset->type);
-		snd_mixer = snd_master;
-		break;
+		mg_println("WARN: mg_audio_manager_play_handle invalid type %d", asset->type);
 	}
 
-	float pitch = mg_cvar("cl_timescale")->value.f;
+	float pitch = g_audio_manager->cl_timescale->value.f;
 	if (pitch_var != 0.0f)
 	{
 		pitch += (float)rand_range(-512, 512) * pitch_var / 512.0f;
@@ -88,8 +96,21 @@ void mg_audio_manager_play(char *name, float pitch_var)
 	else
 	{
 		// gs_audio_play(asset->instance);
-		gs_audio_play_source_with_pitch(asset->source, snd_master->value.f * snd_mixer->value.f * asset->volume, pitch);
+		gs_audio_play_source_with_pitch(asset->source, g_audio_manager->snd_master->value.f * snd_mixer->value.f * asset->volume, pitch);
+	}
+}
+
+// Resolves name once for mg_audio_manager_play_handle,
+// MG_NAME_MAP_INVALID if there is no such audio
+uint32_t mg_audio_manager_get_handle(char *name)
+{
+	uint32_t handle = mg_name_map_find(&g_audio_manager->lookup, name);
+	if (handle == MG_NAME_MAP_INVALID)
+	{
+		mg_println("WARN: mg_audio_manager_get_handle invalid audio %s", name);
 	}
+
+	return handle;
 }
 
 void mg_audio_manager_stop(char *name)
@@ -174,21 +195,12 @@ void _mg_audio_manager_load(char *filename, mg_audio_type type, bool loop, bool
 	}
 
 	gs_free(path);
+	mg_name_map_set(&g_audio_manager->lookup, filename, gs_dyn_array_size(g_audio_manager->assets));
 	gs_dyn_array_push(g_audio_manager->assets, asset);
 }
 
 mg_audio_asset_t *_mg_audio_manager_find(char *name)
 {
-	mg_audio_asset_t *asset = NULL;
-
-	for (size_t i = 0; i < gs_dyn_array_size(g_audio_manager->assets); i++)
-	{
-		if (strcmp(g_audio_manager->assets[i].name, name) == 0)
-		{
-			asset = &g_audio_manager->assets[i];
-			break;
-		}
-	}
-
-	return asset;
+	uint32_t handle = mg_name_map_find(&g_audio_manager->lookup, name);
+	return handle != MG_NAME_MAP_INVALID ? &g_audio_manager->assets[handle] : NULL;
 }
\ No newline at end of file
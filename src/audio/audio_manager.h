@@ -12,6 +12,9 @@
 
 #include <gs/gs.h>
 
+#include "../game/config.h"
+#include "../util/name_map.h"
+
 typedef enum mg_audio_type
 {
 	MG_AUDIO_TYPE_EFFECT,
@@ -34,11 +37,17 @@ typedef struct mg_audio_asset_t
 typedef struct mg_audio_manager_t
 {
 	gs_dyn_array(mg_audio_asset_t) assets;
+	mg_name_map_t lookup; // name to index in assets
+	mg_cvar_t *snd_master;
+	mg_cvar_t *snd_mixers[MG_AUDIO_TYPE_COUNT];
+	mg_cvar_t *cl_timescale;
 } mg_audio_manager_t;
 
 void mg_audio_manager_init();
 void mg_audio_manager_free();
 void mg_audio_manager_play(char *name, float pitch_var);
+void mg_audio_manager_play_handle(uint32_t handle, float pitch_var);
+uint32_t mg_audio_manager_get_handle(char *name);
 void mg_audio_manager_stop(char *name);
 void mg_audio_manager_pause(char *name);
 void mg_audio_manager_restart(char *name);
@@ -0,0 +1,580 @@
+/*================================================================
+	* bsp/bsp_cache.c
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Compiled .bspc files next to the .bsp with the data
+	bsp_map_init would otherwise build on every load:
+	entities, render faces, tesselated patches and the
+	merged vertex and index arrays.
+
+	Everything is validated before the map is touched,
+	stale or broken caches are ignored with a warning.
+=================================================================*/
+
+#include <stdio.h>
+
+#include "bsp_cache.h"
+#include "../game/config.h"
+#include "../game/console.h"
+#include "../game/job_manager.h"
+#include "../util/hash.h"
+#include "bsp_loader.h"
+#include "bsp_map.h"
+
+// Copies count elements from src into a new dyn array
+#define _BSP_CACHE_COPY(ARR, SRC, COUNT)                       \
+	do                                                     \
+	{                                                      \
+		gs_dyn_array_reserve(ARR, gs_max((COUNT), 1)); \
+		memcpy(ARR, (SRC), (COUNT) * sizeof(*(ARR)));  \
+		gs_dyn_array_head(ARR)->size = (COUNT);        \
+	} while (0)
+
+// "maps/q3dm1.bsp" -> "maps/q3dm1.bspc", caller frees
+char *bsp_cache_filename(char *bsp_filename)
+{
+	return mg_append_string(bsp_filename, BSP_CACHE_EXTENSION);
+}
+
+// Builds and writes the cache of a .bsp. CPU only, works without
+// textures or a window, used by the bsp_compile command and -compile.
+bool32_t bsp_cache_compile(char *bsp_filename)
+{
+	double start   = gs_platform_elapsed_time();
+	bsp_map_t *map = gs_malloc_init(bsp_map_t);
+
+	if (!load_bsp(bsp_filename, map) || !map->valid)
+	{
+		mg_println("WARN: bsp_cache_compile failed to load '%s'", bsp_filename);
+		bsp_map_free(map);
+		return false;
+	}
+
+	bsp_map_init_data(map, MG_JOB_MANAGER_THREADS);
+	_bsp_map_build_arrays(map);
+
+	char *filename	 = bsp_cache_filename(bsp_filename);
+	bool32_t success = bsp_cache_write(map, filename);
+	if (success)
+	{
+		mg_println("bsp_cache_compile: wrote '%s' in %.2f ms", filename, gs_platform_elapsed_time() - start);
+	}
+
+	gs_free(filename);
+	bsp_map_free(map);
+	return success;
+}
+
+bool32_t bsp_cache_write(bsp_map_t *map, char *filename)
+{
+	gs_dyn_array(bsp_cache_patch_t) patches		= gs_dyn_array_new(bsp_cache_patch_t);
+	gs_dyn_array(bsp_cache_quadratic_t) quadratics	= gs_dyn_array_new(bsp_cache_quadratic_t);
+	gs_dyn_array(bsp_vert_lump_t) patch_vertices	= gs_dyn_array_new(bsp_vert_lump_t);
+	gs_dyn_array(uint16_t) patch_indices		= gs_dyn_array_new(uint16_t);
+	gs_dyn_array(bsp_cache_entity_t) entities	= gs_dyn_array_new(bsp_cache_entity_t);
+	gs_dyn_array(bsp_cache_key_t) keys		= gs_dyn_array_new(bsp_cache_key_t);
+	gs_dyn_array(char) strings			= gs_dyn_array_new(char);
+
+	// Flatten patches
+	for (size_t i = 0; i < gs_dyn_array_size(map->patches); i++)
+	{
+		bsp_patch_t *patch = &map->patches[i];
+		gs_dyn_array_push(patches, ((bsp_cache_patch_t){
+					       .texture_idx	= patch->texture_idx,
+					       .lightmap_idx	= patch->lightmap_idx,
+					       .width		= patch->width,
+					       .height		= patch->height,
+					       .first_quadratic = gs_dyn_array_size(quadratics),
+					       .num_quadratics	= gs_dyn_array_size(patch->quadratic_patches),
+				       }));
+
+		for (size_t j = 0; j < gs_dyn_array_size(patch->quadratic_patches); j++)
+		{
+			bsp_quadratic_patch_t *quadratic = &patch->quadratic_patches[j];
+			bsp_cache_quadratic_t cached	 = {
+				    .tesselation  = quadratic->tesselation,
+				    .first_vertex = gs_dyn_array_size(patch_vertices),
+				    .num_vertices = gs_dyn_array_size(quadratic->vertices),
+				    .first_index  = gs_dyn_array_size(patch_indices),
+				    .num_indices  = gs_dyn_array_size(quadratic->indices),
+			    };
+			memcpy(cached.control_points, quadratic->control_points, sizeof(cached.control_points));
+			gs_dyn_array_push(quadratics, cached);
+
+			for (size_t k = 0; k < cached.num_vertices; k++)
+			{
+				gs_dyn_array_push(patch_vertices, quadratic->vertices[k]);
+			}
+			for (size_t k = 0; k < cached.num_indices; k++)
+			{
+				gs_dyn_array_push(patch_indices, quadratic->indices[k]);
+			}
+		}
+	}
+
+	// Flatten entities, strings are offsets into one block
+	for (size_t i = 0; i < gs_dyn_array_size(map->entities); i++)
+	{
+		bsp_entity_t *ent	  = &map->entities[i];
+		bsp_cache_entity_t cached = {
+			.content   = _bsp_cache_add_string(&strings, ent->content),
+			.first_key = gs_dyn_array_size(keys),
+		};
+
+		for (
+			gs_slot_map_iter it = gs_slot_map_iter_new(ent->slot_map);
+			gs_slot_map_iter_valid(ent->slot_map, it);
+			gs_slot_map_iter_advance(ent->slot_map, it))
+		{
+			bsp_cache_key_t key = {
+				.key   = _bsp_cache_add_string(&strings, gs_slot_map_iter_getk(ent->slot_map, it)),
+				.value = _bsp_cache_add_string(&strings, gs_slot_map_iter_get(ent->slot_map, it)),
+			};
+			gs_dyn_array_push(keys, key);
+			cached.num_keys++;
+		}
+
+		gs_dyn_array_push(entities, cached);
+	}
+
+	const void *section_data[BSP_CACHE_SECTION_COUNT] = {
+		[BSP_CACHE_SECTION_RENDER_FACES]   = map->render_faces,
+		[BSP_CACHE_SECTION_PATCHES]	   = patches,
+		[BSP_CACHE_SECTION_QUADRATICS]	   = quadratics,
+		[BSP_CACHE_SECTION_PATCH_VERTICES] = patch_vertices,
+		[BSP_CACHE_SECTION_PATCH_INDICES]  = patch_indices,
+		[BSP_CACHE_SECTION_VERTICES]	   = map->bsp_graphics_vert_arr,
+		[BSP_CACHE_SECTION_INDICES]	   = map->bsp_graphics_index_arr,
+		[BSP_CACHE_SECTION_ENTITIES]	   = entities,
+		[BSP_CACHE_SECTION_ENTITY_KEYS]	   = keys,
+		[BSP_CACHE_SECTION_STRINGS]	   = strings,
+	};
+	uint32_t section_count[BSP_CACHE_SECTION_COUNT] = {
+		[BSP_CACHE_SECTION_RENDER_FACES]   = gs_dyn_array_size(map->render_faces),
+		[BSP_CACHE_SECTION_PATCHES]	   = gs_dyn_array_size(patches),
+		[BSP_CACHE_SECTION_QUADRATICS]	   = gs_dyn_array_size(quadratics),
+		[BSP_CACHE_SECTION_PATCH_VERTICES] = gs_dyn_array_size(patch_vertices),
+		[BSP_CACHE_SECTION_PATCH_INDICES]  = gs_dyn_array_size(patch_indices),
+		[BSP_CACHE_SECTION_VERTICES]	   = gs_dyn_array_size(map->bsp_graphics_vert_arr),
+		[BSP_CACHE_SECTION_INDICES]	   = gs_dyn_array_size(map->bsp_graphics_index_arr),
+		[BSP_CACHE_SECTION_ENTITIES]	   = gs_dyn_array_size(entities),
+		[BSP_CACHE_SECTION_ENTITY_KEYS]	   = gs_dyn_array_size(keys),
+		[BSP_CACHE_SECTION_STRINGS]	   = gs_dyn_array_size(strings),
+	};
+
+	// Header, then aligned sections
+	bsp_cache_header_t header = {
+		.magic	     = {'B', 'S', 'P', 'C'},
+		.version     = BSP_CACHE_VERSION,
+		.params_hash = _bsp_cache_params_hash(),
+		.source_hash = bsp_cache_source_hash(map),
+	};
+
+	uint64_t size = sizeof(bsp_cache_header_t);
+	for (size_t i = 0; i < BSP_CACHE_SECTION_COUNT; i++)
+	{
+		size			  = (size + BSP_CACHE_ALIGN - 1) & ~(uint64_t)(BSP_CACHE_ALIGN - 1);
+		header.sections[i].offset = size;
+		header.sections[i].count  = section_count[i];
+		size += (uint64_t)section_count[i] * _bsp_cache_section_size(i);
+	}
+	header.size = size;
+
+	bool32_t success = size <= uint32_max;
+	uint8_t *file	 = success ? gs_calloc(size, 1) : NULL;
+	if (file != NULL)
+	{
+		for (size_t i = 0; i < BSP_CACHE_SECTION_COUNT; i++)
+		{
+			if (section_count[i] > 0)
+			{
+				memcpy(file + header.sections[i].offset, section_data[i], section_count[i] * _bsp_cache_section_size(i));
+			}
+		}
+
+		header.data_hash = mg_hash_bytes(file + sizeof(bsp_cache_header_t), size - sizeof(bsp_cache_header_t), MG_HASH_SEED);
+		memcpy(file, &header, sizeof(bsp_cache_header_t));
+
+		FILE *fp = fopen(filename, "wb");
+		success	 = fp != NULL && fwrite(file, 1, size, fp) == size;
+		if (fp != NULL && fclose(fp) != 0)
+		{
+			success = false;
+		}
+		if (!success)
+		{
+			mg_println("WARN: bsp_cache_write failed to write '%s'", filename);
+		}
+	}
+	else
+	{
+		mg_println("WARN: bsp_cache_write map too large for a cache, %zu bytes", (size_t)size);
+		success = false;
+	}
+
+	gs_free(file);
+	gs_dyn_array_free(patches);
+	gs_dyn_array_free(quadratics);
+	gs_dyn_array_free(patch_vertices);
+	gs_dyn_array_free(patch_indices);
+	gs_dyn_array_free(entities);
+	gs_dyn_array_free(keys);
+	gs_dyn_array_free(strings);
+
+	return success;
+}
+
+// Uses the cache if it's valid for the loaded lumps.
+// Fills entities, render faces, patches and the vertex and index arrays,
+// bsp_map_init_data and bsp_map_init_buffers skip building them.
+// Returns false without a warning if there's no cache.
+bool32_t bsp_cache_load(bsp_map_t *map, char *filename)
+{
+	if (!gs_platform_file_exists(filename))
+	{
+		return false;
+	}
+
+	double start		= gs_platform_elapsed_time();
+	gs_byte_buffer_t buffer = {0};
+	size_t size		= 0;
+	uint8_t *data		= NULL;
+
+	if (mg_cvar("cl_map_mmap")->value.i)
+	{
+		data = _load_bsp_map_view(filename, &size);
+	}
+	bool32_t mapped = data != NULL;
+	if (!mapped)
+	{
+		buffer = gs_byte_buffer_new();
+		gs_byte_buffer_read_from_file(&buffer, filename);
+		data = buffer.data;
+		size = buffer.size;
+	}
+
+	const char *reason = NULL;
+	bool32_t valid	   = _bsp_cache_validate(map, data, size, &reason);
+	if (valid)
+	{
+		_bsp_cache_read(map, data);
+	}
+
+	if (mapped)
+	{
+		_load_bsp_unmap_view(data, size);
+	}
+	else
+	{
+		gs_byte_buffer_free(&buffer);
+	}
+
+	if (!valid)
+	{
+		mg_println("WARN: bsp_cache_load ignoring '%s': %s, run bsp_compile to rebuild", filename, reason);
+		return false;
+	}
+
+	mg_println("bsp_cache_load: using '%s', %zu bytes in %.2f ms", filename, size, gs_platform_elapsed_time() - start);
+	return true;
+}
+
+// Lumps the cached data is built from
+uint64_t bsp_cache_source_hash(bsp_map_t *map)
+{
+	uint64_t h = MG_HASH_SEED;
+	if (map->entity_lump.ents != NULL)
+	{
+		h = mg_hash_bytes(map->entity_lump.ents, gs_string_length(map->entity_lump.ents), h);
+	}
+	h = mg_hash_bytes(map->faces.data, map->faces.count * sizeof(bsp_face_lump_t), h);
+	h = mg_hash_bytes(map->vertices.data, map->vertices.count * sizeof(bsp_vert_lump_t), h);
+	h = mg_hash_bytes(map->indices.data, map->indices.count * sizeof(bsp_index_lump_t), h);
+
+	// Atlas placement only depends on the lightmap count
+	uint64_t lightmaps = map->lightmaps.count;
+	return mg_hash_bytes(&lightmaps, sizeof(lightmaps), h);
+}
+
+// Anything that changes the built data without changing the .bsp
+uint64_t _bsp_cache_params_hash()
+{
+	uint64_t params[] = {
+		BSP_PATCH_RENDER_TESSELATION,
+		BSP_LIGHTMAP_ATLAS_PADDING,
+		BSP_LIGHTMAP_ATLAS_MIN_SIZE,
+		BSP_LIGHTMAP_ATLAS_MAX_SIZE,
+		sizeof(bsp_cache_header_t),
+		sizeof(bsp_face_renderable_t),
+		sizeof(bsp_cache_patch_t),
+		sizeof(bsp_cache_quadratic_t),
+		sizeof(bsp_vert_lump_t),
+		sizeof(bsp_cache_entity_t),
+		sizeof(bsp_cache_key_t),
+	};
+
+	return mg_hash_bytes(params, sizeof(params), MG_HASH_SEED);
+}
+
+uint32_t _bsp_cache_section_size(bsp_cache_section_type type)
+{
+	switch (type)
+	{
+	case BSP_CACHE_SECTION_RENDER_FACES:
+		return sizeof(bsp_face_renderable_t);
+	case BSP_CACHE_SECTION_PATCHES:
+		return sizeof(bsp_cache_patch_t);
+	case BSP_CACHE_SECTION_QUADRATICS:
+		return sizeof(bsp_cache_quadratic_t);
+	case BSP_CACHE_SECTION_PATCH_VERTICES:
+	case BSP_CACHE_SECTION_VERTICES:
+		return sizeof(bsp_vert_lump_t);
+	case BSP_CACHE_SECTION_PATCH_INDICES:
+		return sizeof(uint16_t);
+	case BSP_CACHE_SECTION_INDICES:
+		return sizeof(uint32_t);
+	case BSP_CACHE_SECTION_ENTITIES:
+		return sizeof(bsp_cache_entity_t);
+	case BSP_CACHE_SECTION_ENTITY_KEYS:
+		return sizeof(bsp_cache_key_t);
+	case BSP_CACHE_SECTION_STRINGS:
+		return sizeof(char);
+	default:
+		return 0;
+	}
+}
+
+// Checks the whole file so _bsp_cache_read can trust every offset and index
+bool32_t _bsp_cache_validate(bsp_map_t *map, const uint8_t *data, size_t size, const char **reason)
+{
+	bsp_cache_header_t header;
+	if (data == NULL || size < sizeof(bsp_cache_header_t))
+	{
+		*reason = "file too small";
+		return false;
+	}
+	memcpy(&header, data, sizeof(bsp_cache_header_t));
+
+	if (memcmp(header.magic, "BSPC", 4) != 0 || header.version != BSP_CACHE_VERSION)
+	{
+		*reason = "unknown version";
+		return false;
+	}
+
+	if (header.params_hash != _bsp_cache_params_hash())
+	{
+		*reason = "built with different settings";
+		return false;
+	}
+
+	if (header.size != size)
+	{
+		*reason = "truncated";
+		return false;
+	}
+
+	for (size_t i = 0; i < BSP_CACHE_SECTION_COUNT; i++)
+	{
+		bsp_cache_section_t section = header.sections[i];
+		if (section.offset % BSP_CACHE_ALIGN != 0 || section.offset < sizeof(bsp_cache_header_t)
+			|| (uint64_t)section.offset + (uint64_t)section.count * _bsp_cache_section_size(i) > size)
+		{
+			*reason = "section out of file bounds";
+			return false;
+		}
+	}
+
+	if (header.source_hash != bsp_cache_source_hash(map))
+	{
+		*reason = "out of date";
+		return false;
+	}
+
+	if (header.data_hash != mg_hash_bytes(data + sizeof(bsp_cache_header_t), size - sizeof(bsp_cache_header_t), MG_HASH_SEED))
+	{
+		*reason = "checksum mismatch";
+		return false;
+	}
+
+	// Contents, sections are aligned so they can be read in place
+	const bsp_cache_section_t *sections  = header.sections;
+	const bsp_face_renderable_t *faces   = (const void *)(data + sections[BSP_CACHE_SECTION_RENDER_FACES].offset);
+	const bsp_cache_patch_t *patches     = (const void *)(data + sections[BSP_CACHE_SECTION_PATCHES].offset);
+	const bsp_cache_quadratic_t *quads   = (const void *)(data + sections[BSP_CACHE_SECTION_QUADRATICS].offset);
+	const uint16_t *patch_indices	     = (const void *)(data + sections[BSP_CACHE_SECTION_PATCH_INDICES].offset);
+	const uint32_t *indices		     = (const void *)(data + sections[BSP_CACHE_SECTION_INDICES].offset);
+	const bsp_cache_entity_t *entities   = (const void *)(data + sections[BSP_CACHE_SECTION_ENTITIES].offset);
+	const bsp_cache_key_t *keys	     = (const void *)(data + sections[BSP_CACHE_SECTION_ENTITY_KEYS].offset);
+	const char *strings		     = (const void *)(data + sections[BSP_CACHE_SECTION_STRINGS].offset);
+	uint32_t num_patches		     = sections[BSP_CACHE_SECTION_PATCHES].count;
+	uint32_t num_quads		     = sections[BSP_CACHE_SECTION_QUADRATICS].count;
+	uint32_t num_patch_vertices	     = sections[BSP_CACHE_SECTION_PATCH_VERTICES].count;
+	uint32_t num_patch_indices	     = sections[BSP_CACHE_SECTION_PATCH_INDICES].count;
+	uint32_t num_vertices		     = sections[BSP_CACHE_SECTION_VERTICES].count;
+	uint32_t num_indices		     = sections[BSP_CACHE_SECTION_INDICES].count;
+	uint32_t num_keys		     = sections[BSP_CACHE_SECTION_ENTITY_KEYS].count;
+	uint32_t num_strings		     = sections[BSP_CACHE_SECTION_STRINGS].count;
+
+	*reason = "invalid contents";
+
+	if (sections[BSP_CACHE_SECTION_RENDER_FACES].count != map->faces.count || num_vertices < map->vertices.count)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < map->faces.count; i++)
+	{
+		bsp_face_renderable_t face = faces[i];
+		uint32_t index_count	   = face.type == BSP_FACE_TYPE_PATCH ? num_patches : map->faces.count;
+		if (face.type != map->faces.data[i].type || face.index < 0 || face.index >= index_count
+			|| (uint64_t)face.first_ibo_index + face.num_ibo_indices > num_indices)
+		{
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < num_patches; i++)
+	{
+		if ((uint64_t)patches[i].first_quadratic + patches[i].num_quadratics > num_quads)
+		{
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < num_quads; i++)
+	{
+		bsp_cache_quadratic_t quad = quads[i];
+		if ((uint64_t)quad.first_vertex + quad.num_vertices > num_patch_vertices
+			|| (uint64_t)quad.first_index + quad.num_indices > num_patch_indices)
+		{
+			return false;
+		}
+
+		for (size_t j = 0; j < quad.num_indices; j++)
+		{
+			if (patch_indices[quad.first_index + j] >= quad.num_vertices)
+			{
+				return false;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < num_indices; i++)
+	{
+		if (indices[i] >= num_vertices)
+		{
+			return false;
+		}
+	}
+
+	if (num_strings > 0 && strings[num_strings - 1] != '\0')
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < sections[BSP_CACHE_SECTION_ENTITIES].count; i++)
+	{
+		if (entities[i].content >= num_strings || (uint64_t)entities[i].first_key + entities[i].num_keys > num_keys)
+		{
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < num_keys; i++)
+	{
+		if (keys[i].key >= num_strings || keys[i].value >= num_strings)
+		{
+			return false;
+		}
+	}
+
+	*reason = NULL;
+	return true;
+}
+
+// Copies a validated cache into the map's runtime arrays
+void _bsp_cache_read(bsp_map_t *map, const uint8_t *data)
+{
+	bsp_cache_header_t header;
+	memcpy(&header, data, sizeof(bsp_cache_header_t));
+
+	const bsp_cache_section_t *sections	  = header.sections;
+	const bsp_cache_patch_t *patches	  = (const void *)(data + sections[BSP_CACHE_SECTION_PATCHES].offset);
+	const bsp_cache_quadratic_t *quads	  = (const void *)(data + sections[BSP_CACHE_SECTION_QUADRATICS].offset);
+	const bsp_vert_lump_t *patch_vertices	  = (const void *)(data + sections[BSP_CACHE_SECTION_PATCH_VERTICES].offset);
+	const uint16_t *patch_indices		  = (const void *)(data + sections[BSP_CACHE_SECTION_PATCH_INDICES].offset);
+	const bsp_cache_entity_t *entities	  = (const void *)(data + sections[BSP_CACHE_SECTION_ENTITIES].offset);
+	const bsp_cache_key_t *keys		  = (const void *)(data + sections[BSP_CACHE_SECTION_ENTITY_KEYS].offset);
+	const char *strings			  = (const void *)(data + sections[BSP_CACHE_SECTION_STRINGS].offset);
+	bsp_cache_section_t render_faces	  = sections[BSP_CACHE_SECTION_RENDER_FACES];
+	bsp_cache_section_t vertices		  = sections[BSP_CACHE_SECTION_VERTICES];
+	bsp_cache_section_t indices		  = sections[BSP_CACHE_SECTION_INDICES];
+
+	_BSP_CACHE_COPY(map->render_faces, data + render_faces.offset, render_faces.count);
+	_BSP_CACHE_COPY(map->bsp_graphics_vert_arr, data + vertices.offset, vertices.count);
+	_BSP_CACHE_COPY(map->bsp_graphics_index_arr, data + indices.offset, indices.count);
+
+	map->patches = gs_dyn_array_new(bsp_patch_t);
+	gs_dyn_array_reserve(map->patches, gs_max(sections[BSP_CACHE_SECTION_PATCHES].count, 1));
+	for (size_t i = 0; i < sections[BSP_CACHE_SECTION_PATCHES].count; i++)
+	{
+		bsp_patch_t patch = {
+			.texture_idx	   = patches[i].texture_idx,
+			.lightmap_idx	   = patches[i].lightmap_idx,
+			.width		   = patches[i].width,
+			.height		   = patches[i].height,
+			.quadratic_patches = gs_dyn_array_new(bsp_quadratic_patch_t),
+		};
+		gs_dyn_array_reserve(patch.quadratic_patches, gs_max(patches[i].num_quadratics, 1));
+
+		for (size_t j = 0; j < patches[i].num_quadratics; j++)
+		{
+			bsp_cache_quadratic_t cached	= quads[patches[i].first_quadratic + j];
+			bsp_quadratic_patch_t quadratic = {
+				.tesselation = cached.tesselation,
+			};
+			memcpy(quadratic.control_points, cached.control_points, sizeof(quadratic.control_points));
+			_BSP_CACHE_COPY(quadratic.vertices, patch_vertices + cached.first_vertex, cached.num_vertices);
+			_BSP_CACHE_COPY(quadratic.indices, patch_indices + cached.first_index, cached.num_indices);
+			gs_dyn_array_push(patch.quadratic_patches, quadratic);
+		}
+
+		gs_dyn_array_push(map->patches, patch);
+	}
+
+	map->entities = gs_dyn_array_new(bsp_entity_t);
+	for (size_t i = 0; i < sections[BSP_CACHE_SECTION_ENTITIES].count; i++)
+	{
+		bsp_entity_t ent = {
+			.content  = mg_duplicate_string((char *)strings + entities[i].content),
+			.slot_map = gs_slot_map_new(char *, char *),
+		};
+
+		for (size_t j = 0; j < entities[i].num_keys; j++)
+		{
+			bsp_cache_key_t key = keys[entities[i].first_key + j];
+			char *k		    = mg_duplicate_string((char *)strings + key.key);
+			char *v		    = mg_duplicate_string((char *)strings + key.value);
+			gs_slot_map_insert(ent.slot_map, k, v);
+		}
+
+		gs_dyn_array_push(map->entities, ent);
+	}
+
+	map->from_cache = true;
+}
+
+// Appends str with its terminator, returns its offset
+uint32_t _bsp_cache_add_string(gs_dyn_array(char) * strings, const char *str)
+{
+	uint32_t offset = gs_dyn_array_size(*strings);
+	size_t len	= gs_string_length(str) + 1;
+	for (size_t i = 0; i < len; i++)
+	{
+		gs_dyn_array_push(*strings, str[i]);
+	}
+
+	return offset;
+}
@@ -0,0 +1,103 @@
+/*================================================================
+	* bsp/bsp_cache.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Compiled .bspc files next to the .bsp with the data
+	bsp_map_init would otherwise build on every load:
+	entities, render faces, tesselated patches and the
+	merged vertex and index arrays.
+
+	Sections are aligned plain arrays in native byte order,
+	so the file can be used from a read-only mapping.
+=================================================================*/
+
+#ifndef BSP_CACHE_H
+#define BSP_CACHE_H
+
+#include <gs/gs.h>
+
+#include "bsp_types.h"
+
+#define BSP_CACHE_VERSION   1
+#define BSP_CACHE_ALIGN	    16	// section alignment in the file
+#define BSP_CACHE_EXTENSION "c" // appended to the .bsp filename
+
+typedef enum bsp_cache_section_type
+{
+	BSP_CACHE_SECTION_RENDER_FACES,	  // bsp_face_renderable_t
+	BSP_CACHE_SECTION_PATCHES,	  // bsp_cache_patch_t
+	BSP_CACHE_SECTION_QUADRATICS,	  // bsp_cache_quadratic_t
+	BSP_CACHE_SECTION_PATCH_VERTICES, // bsp_vert_lump_t
+	BSP_CACHE_SECTION_PATCH_INDICES,  // uint16_t
+	BSP_CACHE_SECTION_VERTICES,	  // bsp_vert_lump_t, merged for rendering
+	BSP_CACHE_SECTION_INDICES,	  // uint32_t, merged for rendering
+	BSP_CACHE_SECTION_ENTITIES,	  // bsp_cache_entity_t
+	BSP_CACHE_SECTION_ENTITY_KEYS,	  // bsp_cache_key_t
+	BSP_CACHE_SECTION_STRINGS,	  // char, null terminated
+	BSP_CACHE_SECTION_COUNT,
+} bsp_cache_section_type;
+
+typedef struct bsp_cache_section_t
+{
+	uint32_t offset; // from the start of the file
+	uint32_t count;	 // elements
+} bsp_cache_section_t;
+
+typedef struct bsp_cache_header_t
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t params_hash; // of build constants and struct sizes
+	uint64_t source_hash; // of the .bsp lumps the data is built from
+	uint64_t data_hash;   // of everything after the header
+	uint64_t size;	      // whole file
+	bsp_cache_section_t sections[BSP_CACHE_SECTION_COUNT];
+} bsp_cache_header_t;
+
+typedef struct bsp_cache_patch_t
+{
+	int32_t texture_idx;
+	int32_t lightmap_idx;
+	int32_t width;
+	int32_t height;
+	uint32_t first_quadratic;
+	uint32_t num_quadratics;
+} bsp_cache_patch_t;
+
+typedef struct bsp_cache_quadratic_t
+{
+	int32_t tesselation;
+	bsp_vert_lump_t control_points[9];
+	uint32_t first_vertex;
+	uint32_t num_vertices;
+	uint32_t first_index;
+	uint32_t num_indices;
+} bsp_cache_quadratic_t;
+
+typedef struct bsp_cache_entity_t
+{
+	uint32_t content; // string offset
+	uint32_t first_key;
+	uint32_t num_keys;
+} bsp_cache_entity_t;
+
+typedef struct bsp_cache_key_t
+{
+	uint32_t key;	// string offset
+	uint32_t value; // string offset
+} bsp_cache_key_t;
+
+char *bsp_cache_filename(char *bsp_filename);
+bool32_t bsp_cache_compile(char *bsp_filename);
+bool32_t bsp_cache_write(bsp_map_t *map, char *filename);
+bool32_t bsp_cache_load(bsp_map_t *map, char *filename);
+uint64_t bsp_cache_source_hash(bsp_map_t *map);
+uint64_t _bsp_cache_params_hash();
+uint32_t _bsp_cache_section_size(bsp_cache_section_type type);
+bool32_t _bsp_cache_validate(bsp_map_t *map, const uint8_t *data, size_t size, const char **reason);
+void _bsp_cache_read(bsp_map_t *map, const uint8_t *data);
+uint32_t _bsp_cache_add_string(gs_dyn_array(char) * strings, const char *str);
+
+#endif // BSP_CACHE_H
@@ -0,0 +1,190 @@
+/*================================================================
+	* bsp/bsp_cluster_draw.c
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Static per cluster index ranges for BSP faces.
+	Visible clusters are drawn without rebuilding indices.
+=================================================================*/
+
+#include <float.h>
+
+#include "bsp_cluster_draw.h"
+#include "bsp_map.h"
+
+// Groups faces of each cluster's leaves by material and lays
+// the clusters out one after another in a single index array.
+// Uses the visible face bitset as scratch.
+void bsp_cluster_draws_build(bsp_cluster_draws_t *draws, bsp_map_t *map, const int32_t *texture_keys)
+{
+	int32_t max_cluster = -1;
+	for (size_t i = 0; i < map->leaves.count; i++)
+	{
+		max_cluster = gs_max(max_cluster, map->leaves.data[i].cluster);
+	}
+
+	*draws = (bsp_cluster_draws_t){
+		.num_clusters	= max_cluster + 1,
+		.indices	= gs_dyn_array_new(uint32_t),
+		.ranges		= gs_dyn_array_new(bsp_draw_range_t),
+		.clusters	= gs_dyn_array_new(bsp_cluster_draw_t),
+		.visible_ranges = gs_dyn_array_new(bsp_draw_range_t),
+	};
+
+	uint32_t num_clusters = draws->num_clusters;
+	for (size_t i = 0; i < 3; i++)
+	{
+		draws->mins[i] = gs_malloc(gs_max(num_clusters, 1) * sizeof(float));
+		draws->maxs[i] = gs_malloc(gs_max(num_clusters, 1) * sizeof(float));
+		for (size_t j = 0; j < num_clusters; j++)
+		{
+			draws->mins[i][j] = FLT_MAX;
+			draws->maxs[i][j] = -FLT_MAX;
+		}
+	}
+	draws->in_frustum = gs_calloc(gs_max(num_clusters, 1), sizeof(uint8_t));
+
+	// Bucket leaves by cluster
+	uint32_t *cluster_offsets = gs_calloc(num_clusters + 1, sizeof(uint32_t));
+	uint32_t *cluster_leaves  = gs_malloc(gs_max(map->leaves.count, 1) * sizeof(uint32_t));
+	for (size_t i = 0; i < map->leaves.count; i++)
+	{
+		int32_t cluster = map->leaves.data[i].cluster;
+		if (cluster >= 0) cluster_offsets[cluster + 1]++;
+	}
+	for (size_t i = 0; i < num_clusters; i++)
+	{
+		cluster_offsets[i + 1] += cluster_offsets[i];
+	}
+	uint32_t *cursor = gs_malloc(gs_max(num_clusters, 1) * sizeof(uint32_t));
+	memcpy(cursor, cluster_offsets, num_clusters * sizeof(uint32_t));
+	for (size_t i = 0; i < map->leaves.count; i++)
+	{
+		int32_t cluster = map->leaves.data[i].cluster;
+		if (cluster >= 0) cluster_leaves[cursor[cluster]++] = i;
+	}
+	gs_free(cursor);
+
+	bsp_draw_list_t list;
+	bsp_draw_list_init(&list);
+
+	for (uint32_t c = 0; c < num_clusters; c++)
+	{
+		mg_bitset_clear(&map->visible_faces);
+
+		for (uint32_t i = cluster_offsets[c]; i < cluster_offsets[c + 1]; i++)
+		{
+			bsp_leaf_lump_t lump = map->leaves.data[cluster_leaves[i]];
+
+			for (size_t k = 0; k < 3; k++)
+			{
+				draws->mins[k][c] = gs_min(draws->mins[k][c], lump.mins[k]);
+				draws->maxs[k][c] = gs_max(draws->maxs[k][c], lump.maxs[k]);
+			}
+
+			for (size_t j = 0; j < lump.num_leaf_faces; j++)
+			{
+				mg_bitset_set(&map->visible_faces, map->leaf_faces.data[lump.first_leaf_face + j].face);
+			}
+		}
+
+		bsp_draw_list_build(&list, map->render_faces, &map->visible_faces, map->bsp_graphics_index_arr, texture_keys);
+
+		// Ranges are relative to the list, offset to the shared array
+		uint32_t base		   = gs_dyn_array_size(draws->indices);
+		bsp_cluster_draw_t cluster = {
+			.first_range = gs_dyn_array_size(draws->ranges),
+			.num_ranges  = gs_dyn_array_size(list.ranges),
+			.num_indices = gs_dyn_array_size(list.indices),
+		};
+		gs_dyn_array_push(draws->clusters, cluster);
+
+		for (size_t i = 0; i < gs_dyn_array_size(list.ranges); i++)
+		{
+			bsp_draw_range_t range = list.ranges[i];
+			range.first_index += base;
+			gs_dyn_array_push(draws->ranges, range);
+		}
+		for (size_t i = 0; i < gs_dyn_array_size(list.indices); i++)
+		{
+			gs_dyn_array_push(draws->indices, list.indices[i]);
+		}
+	}
+
+	mg_bitset_clear(&map->visible_faces);
+	bsp_draw_list_free(&list);
+	gs_free(cluster_offsets);
+	gs_free(cluster_leaves);
+}
+
+// Collects draw ranges of clusters in the view cluster's PVS
+// that pass the frustum and occlusion tests, returns number of
+// visible clusters. Clusters behind occluders go to occluded.
+uint32_t bsp_cluster_draws_cull(bsp_cluster_draws_t *draws, bsp_map_t *map, const mg_camera_frustum_t *fr, int32_t view_cluster, uint32_t *occluded)
+{
+	gs_dyn_array_clear(draws->visible_ranges);
+	*occluded = 0;
+
+	if (draws->num_clusters == 0)
+	{
+		return 0;
+	}
+
+	mg_camera_aabbs_in_frustum(
+		fr,
+		(const float *const *)draws->mins,
+		(const float *const *)draws->maxs,
+		draws->num_clusters,
+		draws->in_frustum);
+
+	uint32_t visible = 0;
+	for (uint32_t c = 0; c < draws->num_clusters; c++)
+	{
+		bsp_cluster_draw_t cluster = draws->clusters[c];
+		if (!draws->in_frustum[c] || cluster.num_ranges == 0 || !bsp_cluster_can_see(&map->vis, view_cluster, c))
+		{
+			continue;
+		}
+
+		// Behind occluders drawn this frame
+		gs_vec3 mins = gs_v3(draws->mins[0][c], draws->mins[1][c], draws->mins[2][c]);
+		gs_vec3 maxs = gs_v3(draws->maxs[0][c], draws->maxs[1][c], draws->maxs[2][c]);
+		if (!bsp_occlusion_aabb_visible(&map->occlusion, mins, maxs))
+		{
+			(*occluded)++;
+			continue;
+		}
+
+		visible++;
+		for (uint32_t i = 0; i < cluster.num_ranges; i++)
+		{
+			gs_dyn_array_push(draws->visible_ranges, draws->ranges[cluster.first_range + i]);
+		}
+	}
+
+	return visible;
+}
+
+void bsp_cluster_draws_free(bsp_cluster_draws_t *draws)
+{
+	gs_dyn_array_free(draws->indices);
+	gs_dyn_array_free(draws->ranges);
+	gs_dyn_array_free(draws->clusters);
+	gs_dyn_array_free(draws->visible_ranges);
+	for (size_t i = 0; i < 3; i++)
+	{
+		gs_free(draws->mins[i]);
+		gs_free(draws->maxs[i]);
+		draws->mins[i] = NULL;
+		draws->maxs[i] = NULL;
+	}
+	gs_free(draws->in_frustum);
+
+	draws->indices	      = NULL;
+	draws->ranges	      = NULL;
+	draws->clusters	      = NULL;
+	draws->visible_ranges = NULL;
+	draws->in_frustum     = NULL;
+	draws->num_clusters   = 0;
+}
@@ -0,0 +1,21 @@
+/*================================================================
+	* bsp/bsp_cluster_draw.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Static per cluster index ranges for BSP faces.
+	Visible clusters are drawn without rebuilding indices.
+=================================================================*/
+
+#ifndef BSP_CLUSTER_DRAW_H
+#define BSP_CLUSTER_DRAW_H
+
+#include "../util/camera.h"
+#include "bsp_types.h"
+
+void bsp_cluster_draws_build(bsp_cluster_draws_t *draws, bsp_map_t *map, const int32_t *texture_keys);
+uint32_t bsp_cluster_draws_cull(bsp_cluster_draws_t *draws, bsp_map_t *map, const mg_camera_frustum_t *fr, int32_t view_cluster, uint32_t *occluded);
+void bsp_cluster_draws_free(bsp_cluster_draws_t *draws);
+
+#endif // BSP_CLUSTER_DRAW_H
@@ -0,0 +1,91 @@
+/*================================================================
+	* bsp/bsp_draw_list.c
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Material sorted draw list for visible BSP faces.
+	CPU only, doesn't touch graphics state.
+=================================================================*/
+
+#include "bsp_draw_list.h"
+
+void bsp_draw_list_init(bsp_draw_list_t *list)
+{
+	list->keys    = gs_dyn_array_new(uint64_t);
+	list->indices = gs_dyn_array_new(uint32_t);
+	list->ranges  = gs_dyn_array_new(bsp_draw_range_t);
+}
+
+void bsp_draw_list_free(bsp_draw_list_t *list)
+{
+	gs_dyn_array_free(list->keys);
+	gs_dyn_array_free(list->indices);
+	gs_dyn_array_free(list->ranges);
+
+	list->keys    = NULL;
+	list->indices = NULL;
+	list->ranges  = NULL;
+}
+
+// Sorts visible faces by (texture, lightmap) and copies their
+// indices from index_arr so each material is one contiguous range.
+// texture_keys optionally maps textures to the texture to sort by,
+// textures sharing a key end up in the same range.
+void bsp_draw_list_build(bsp_draw_list_t *list, const bsp_face_renderable_t *faces, const mg_bitset_t *visible, const uint32_t *index_arr, const int32_t *texture_keys)
+{
+	gs_dyn_array_clear(list->keys);
+	gs_dyn_array_clear(list->indices);
+	gs_dyn_array_clear(list->ranges);
+
+	// Key layout: texture + 1 (16 bits), lightmap + 1 (16 bits), face index (32 bits)
+	for (int32_t i = mg_bitset_next(visible, 0); i >= 0; i = mg_bitset_next(visible, i + 1))
+	{
+		if (faces[i].num_ibo_indices == 0) continue;
+
+		int32_t texture	  = texture_keys != NULL && faces[i].texture >= 0 ? texture_keys[faces[i].texture] : faces[i].texture;
+		uint64_t material = ((uint64_t)(uint16_t)(texture + 1) << 16) | (uint16_t)(faces[i].lm_index + 1);
+		gs_dyn_array_push(list->keys, (material << 32) | i);
+	}
+
+	uint32_t num_keys = gs_dyn_array_size(list->keys);
+	if (num_keys == 0)
+	{
+		return;
+	}
+
+	qsort(list->keys, num_keys, sizeof(uint64_t), _bsp_draw_list_compare_keys);
+
+	uint64_t current_material = UINT64_MAX;
+	for (uint32_t i = 0; i < num_keys; i++)
+	{
+		uint64_t material		 = list->keys[i] >> 32;
+		const bsp_face_renderable_t face = faces[(uint32_t)list->keys[i]];
+
+		if (material != current_material)
+		{
+			bsp_draw_range_t range = {
+				.texture     = (int32_t)(material >> 16) - 1,
+				.lm_index    = face.lm_index,
+				.first_index = gs_dyn_array_size(list->indices),
+				.num_indices = 0,
+			};
+			gs_dyn_array_push(list->ranges, range);
+			current_material = material;
+		}
+
+		for (uint32_t j = 0; j < face.num_ibo_indices; j++)
+		{
+			gs_dyn_array_push(list->indices, index_arr[face.first_ibo_index + j]);
+		}
+
+		list->ranges[gs_dyn_array_size(list->ranges) - 1].num_indices += face.num_ibo_indices;
+	}
+}
+
+int _bsp_draw_list_compare_keys(const void *a, const void *b)
+{
+	uint64_t ka = *(const uint64_t *)a;
+	uint64_t kb = *(const uint64_t *)b;
+	return (ka > kb) - (ka < kb);
+}
@@ -0,0 +1,21 @@
+/*================================================================
+	* bsp/bsp_draw_list.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Material sorted draw list for visible BSP faces.
+	CPU only, doesn't touch graphics state.
+=================================================================*/
+
+#ifndef BSP_DRAW_LIST_H
+#define BSP_DRAW_LIST_H
+
+#include "bsp_types.h"
+
+void bsp_draw_list_init(bsp_draw_list_t *list);
+void bsp_draw_list_free(bsp_draw_list_t *list);
+void bsp_draw_list_build(bsp_draw_list_t *list, const bsp_face_renderable_t *faces, const mg_bitset_t *visible, const uint32_t *index_arr, const int32_t *texture_keys);
+int _bsp_draw_list_compare_keys(const void *a, const void *b);
+
+#endif // BSP_DRAW_LIST_H
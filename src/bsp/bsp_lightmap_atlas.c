@@ -0,0 +1,135 @@
+/*================================================================
+	* bsp/bsp_lightmap_atlas.c
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Packs BSP lightmaps into atlas pages.
+	CPU only, doesn't touch graphics state.
+=================================================================*/
+
+#include "bsp_lightmap_atlas.h"
+#include "../game/console.h"
+
+// All lightmaps are the same size, so pages are a grid of cells.
+// Each cell is a lightmap surrounded by padding pixels that repeat
+// its edges, so bilinear filtering doesn't bleed between lightmaps.
+bool32_t bsp_lightmap_atlas_build(bsp_lightmap_atlas_t *atlas, const bsp_lightmap_lump_t *lightmaps, uint32_t count, uint32_t padding, uint32_t max_page_size)
+{
+	*atlas = (bsp_lightmap_atlas_t){0};
+
+	uint32_t cell_size = BSP_LIGHTMAP_SIZE + padding * 2;
+	if (cell_size > max_page_size)
+	{
+		mg_println("WARN: bsp_lightmap_atlas_build page size %u too small for padding %u", max_page_size, padding);
+		return false;
+	}
+
+	// Smallest power of two page that fits everything,
+	// or as many max size pages as needed.
+	uint32_t page_size = BSP_LIGHTMAP_ATLAS_MIN_SIZE;
+	while (page_size < max_page_size && (page_size / cell_size) * (page_size / cell_size) < count)
+	{
+		page_size *= 2;
+	}
+	page_size = gs_min(page_size, max_page_size);
+
+	uint32_t cells_per_row	= page_size / cell_size;
+	uint32_t cells_per_page = cells_per_row * cells_per_row;
+
+	atlas->page_size      = page_size;
+	atlas->padding	      = padding;
+	atlas->cells_per_row  = cells_per_row;
+	atlas->num_pages      = (count + cells_per_page - 1) / cells_per_page;
+	atlas->num_placements = count;
+
+	if (count == 0)
+	{
+		return true;
+	}
+
+	atlas->pages	  = gs_malloc(atlas->num_pages * sizeof(uint8_t *));
+	atlas->placements = gs_malloc(count * sizeof(bsp_lightmap_placement_t));
+	for (size_t i = 0; i < atlas->num_pages; i++)
+	{
+		atlas->pages[i] = gs_calloc(page_size * page_size * 3, sizeof(uint8_t));
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t cell = i % cells_per_page;
+
+		bsp_lightmap_placement_t placement = {
+			.page = i / cells_per_page,
+			.x    = (cell % cells_per_row) * cell_size + padding,
+			.y    = (cell / cells_per_row) * cell_size + padding,
+		};
+		atlas->placements[i] = placement;
+
+		// Copy lightmap with edges clamped into the padding
+		uint8_t *page = atlas->pages[placement.page];
+		for (uint32_t y = 0; y < cell_size; y++)
+		{
+			int32_t src_y = gs_clamp((int32_t)y - (int32_t)padding, 0, BSP_LIGHTMAP_SIZE - 1);
+			for (uint32_t x = 0; x < cell_size; x++)
+			{
+				int32_t src_x = gs_clamp((int32_t)x - (int32_t)padding, 0, BSP_LIGHTMAP_SIZE - 1);
+				size_t src    = (src_y * BSP_LIGHTMAP_SIZE + src_x) * 3;
+				size_t dst    = ((placement.y - padding + y) * page_size + placement.x - padding + x) * 3;
+				memcpy(page + dst, lightmaps[i].map + src, 3);
+			}
+		}
+	}
+
+	return true;
+}
+
+// Atlas page (texture) a lightmap is in, -1 if none
+int32_t bsp_lightmap_atlas_page(const bsp_lightmap_atlas_t *atlas, int32_t lm_index)
+{
+	if (lm_index < 0 || lm_index >= atlas->num_placements)
+	{
+		return -1;
+	}
+
+	return atlas->placements[lm_index].page;
+}
+
+// Lightmap space [0, 1] coordinates to atlas page space
+gs_vec2 bsp_lightmap_atlas_remap(const bsp_lightmap_atlas_t *atlas, int32_t lm_index, gs_vec2 lm_coord)
+{
+	if (lm_index < 0 || lm_index >= atlas->num_placements)
+	{
+		return lm_coord;
+	}
+
+	bsp_lightmap_placement_t placement = atlas->placements[lm_index];
+	return gs_v2(
+		(placement.x + lm_coord.x * BSP_LIGHTMAP_SIZE) / (float)atlas->page_size,
+		(placement.y + lm_coord.y * BSP_LIGHTMAP_SIZE) / (float)atlas->page_size);
+}
+
+// Pixels are only needed until uploaded
+void bsp_lightmap_atlas_free_pixels(bsp_lightmap_atlas_t *atlas)
+{
+	if (atlas->pages == NULL)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < atlas->num_pages; i++)
+	{
+		gs_free(atlas->pages[i]);
+	}
+	gs_free(atlas->pages);
+	atlas->pages = NULL;
+}
+
+void bsp_lightmap_atlas_free(bsp_lightmap_atlas_t *atlas)
+{
+	bsp_lightmap_atlas_free_pixels(atlas);
+	gs_free(atlas->placements);
+	atlas->placements     = NULL;
+	atlas->num_placements = 0;
+	atlas->num_pages      = 0;
+}
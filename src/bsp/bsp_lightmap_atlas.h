@@ -0,0 +1,26 @@
+/*================================================================
+	* bsp/bsp_lightmap_atlas.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Packs BSP lightmaps into atlas pages.
+	CPU only, doesn't touch graphics state.
+=================================================================*/
+
+#ifndef BSP_LIGHTMAP_ATLAS_H
+#define BSP_LIGHTMAP_ATLAS_H
+
+#include "bsp_types.h"
+
+#define BSP_LIGHTMAP_ATLAS_PADDING  2
+#define BSP_LIGHTMAP_ATLAS_MIN_SIZE 256
+#define BSP_LIGHTMAP_ATLAS_MAX_SIZE 2048
+
+bool32_t bsp_lightmap_atlas_build(bsp_lightmap_atlas_t *atlas, const bsp_lightmap_lump_t *lightmaps, uint32_t count, uint32_t padding, uint32_t max_page_size);
+int32_t bsp_lightmap_atlas_page(const bsp_lightmap_atlas_t *atlas, int32_t lm_index);
+gs_vec2 bsp_lightmap_atlas_remap(const bsp_lightmap_atlas_t *atlas, int32_t lm_index, gs_vec2 lm_coord);
+void bsp_lightmap_atlas_free_pixels(bsp_lightmap_atlas_t *atlas);
+void bsp_lightmap_atlas_free(bsp_lightmap_atlas_t *atlas);
+
+#endif // BSP_LIGHTMAP_ATLAS_H
@@ -11,17 +11,39 @@
 	NOTE: only supports version 46.
 =================================================================*/
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "bsp_loader.h"
+#include "../game/config.h"
 #include "../game/console.h"
 
 // shorthand util for failing during BSP load
-b32 _load_bsp_fail(gs_byte_buffer_t *buffer, char *msg)
+b32 _load_bsp_fail(gs_byte_buffer_t *buffer, bsp_map_t *map, char *msg)
 {
 	mg_println("load_bsp() failed: %s", msg);
-	gs_byte_buffer_free(buffer);
+	_load_bsp_free_buffer(buffer, map);
 	return false;
 }
 
+// The mapping stays with the map until bsp_map_free
+void _load_bsp_free_buffer(gs_byte_buffer_t *buffer, bsp_map_t *map)
+{
+	if (map->file_mapping == NULL)
+	{
+		gs_byte_buffer_free(buffer);
+	}
+	*buffer = (gs_byte_buffer_t){0};
+}
+
 // load BSP from file
 b32 load_bsp(char *filename, bsp_map_t *map)
 {
@@ -33,20 +55,41 @@ b32 load_bsp(char *filename, bsp_map_t *map)
 		return false;
 	}
 
-	gs_byte_buffer_t buffer = gs_byte_buffer_new();
-	gs_byte_buffer_read_from_file(&buffer, filename);
+	double start_time	= gs_platform_elapsed_time();
+	gs_byte_buffer_t buffer = {0};
+
+	// Read-only view of the mapping, falls back to reading the file
+	if (mg_cvar("cl_map_mmap")->value.i && _load_bsp_map_file(filename, map))
+	{
+		buffer.data	= map->file_mapping;
+		buffer.size	= map->file_mapping_size;
+		buffer.capacity = map->file_mapping_size;
+	}
+	else
+	{
+		buffer = gs_byte_buffer_new();
+		gs_byte_buffer_read_from_file(&buffer, filename);
+	}
 
 	// read header
-	if (!_load_bsp_header(&buffer, &map->header))
-		return _load_bsp_fail(&buffer, "failed to read header");
+	if (buffer.size < sizeof(bsp_header_t) || !_load_bsp_header(&buffer, &map->header))
+		return _load_bsp_fail(&buffer, map, "failed to read header");
 
 	// validate header
 	if (memcmp(map->header.magic, "IBSP", 4) != 0 || map->header.version != 46)
-		return _load_bsp_fail(&buffer, "invalid header");
+		return _load_bsp_fail(&buffer, map, "invalid header");
+
+	// validate lump ranges
+	for (size_t i = 0; i < BSP_LUMP_TYPE_COUNT; i++)
+	{
+		bsp_dir_entry_t entry = map->header.dir_entries[i];
+		if (entry.offset < 0 || entry.length < 0 || (size_t)entry.offset + (size_t)entry.length > buffer.size)
+			return _load_bsp_fail(&buffer, map, "lump out of file bounds");
+	}
 
 	// read entity lump
 	if (!_load_entity_lump(&buffer, map))
-		return _load_bsp_fail(&buffer, "failed to read entity lumps");
+		return _load_bsp_fail(&buffer, map, "failed to read entity lumps");
 
 	// generic lumps
 	uint32_t *counts[] = {
@@ -108,17 +151,17 @@ b32 load_bsp(char *filename, bsp_map_t *map)
 	{
 		if (!_load_lump(&buffer, map, counts[i - start], datas[i - start], i, sizes[i - start]))
 		{
-			gs_byte_buffer_free(&buffer);
+			_load_bsp_free_buffer(&buffer, map);
 			return false;
 		}
 	}
 
 	// read visdata lump
 	if (!_load_visdata_lump(&buffer, map))
-		return _load_bsp_fail(&buffer, "failed to read visdata lump");
+		return _load_bsp_fail(&buffer, map, "failed to read visdata lump");
 
 	map->valid = map->faces.count > 0;
-	gs_byte_buffer_free(&buffer);
+	_load_bsp_free_buffer(&buffer, map);
 
 	// Get map name from filepath
 	char *name = mg_get_filename_from_path(filename);
@@ -126,7 +169,12 @@ b32 load_bsp(char *filename, bsp_map_t *map)
 	map->name  = gs_malloc(sz);
 	memcpy(map->name, name, sz);
 
-	mg_println("load_bsp() done loading '%s'", map->name);
+	mg_println(
+		"load_bsp() done loading '%s' in %.2f ms, %s, peak RSS %zu KB",
+		map->name,
+		gs_platform_elapsed_time() - start_time,
+		map->file_mapping != NULL ? "memory mapped" : "read to memory",
+		_load_bsp_peak_rss());
 
 	return true;
 }
@@ -143,9 +191,17 @@ b32 _load_lump(gs_byte_buffer_t *buffer, bsp_map_t *map, uint32_t *count, void *
 	uint32_t size = map->header.dir_entries[type].length;
 
 	*count = size / lump_size;
-	*data  = gs_malloc(size);
 
+	// Lumps are 4 byte aligned in the file, check anyway
 	buffer->position = map->header.dir_entries[type].offset;
+	if (map->file_mapping != NULL && _load_bsp_lump_read_only(type) && buffer->position % sizeof(int32_t) == 0)
+	{
+		*data = buffer->data + buffer->position;
+		map->mapped_lumps |= 1 << type;
+		return true;
+	}
+
+	*data = gs_malloc(size);
 
 	if (size > 0)
 		gs_byte_buffer_read_bulk(buffer, data, size);
@@ -176,9 +232,159 @@ b32 _load_visdata_lump(gs_byte_buffer_t *buffer, bsp_map_t *map)
 	gs_byte_buffer_read(buffer, int32_t, &map->visdata.num_vecs);
 	gs_byte_buffer_read(buffer, int32_t, &map->visdata.size_vecs);
 
-	int32_t size	  = map->visdata.num_vecs * map->visdata.size_vecs;
+	int32_t size = map->visdata.num_vecs * map->visdata.size_vecs;
+	if (size < 0 || buffer->position + size > buffer->size)
+		return false;
+
+	// Bytes, no alignment needed
+	if (map->file_mapping != NULL && _load_bsp_lump_read_only(BSP_LUMP_TYPE_VISDATA))
+	{
+		map->visdata.vecs = (char *)buffer->data + buffer->position;
+		map->mapped_lumps |= 1 << BSP_LUMP_TYPE_VISDATA;
+		return true;
+	}
+
 	map->visdata.vecs = gs_malloc(size);
 	gs_byte_buffer_read_bulk(buffer, &map->visdata.vecs, size);
 
 	return true;
+}
+
+// Lumps never written after load, used from the mapping in place.
+// The rest are copied.
+b32 _load_bsp_lump_read_only(bsp_lump_types type)
+{
+	switch (type)
+	{
+	case BSP_LUMP_TYPE_PLANES:
+	case BSP_LUMP_TYPE_NODES:
+	case BSP_LUMP_TYPE_LEAVES:
+	case BSP_LUMP_TYPE_LEAF_FACES:
+	case BSP_LUMP_TYPE_LEAF_BRUSHES:
+	case BSP_LUMP_TYPE_BRUSHES:
+	case BSP_LUMP_TYPE_BRUSH_SIDES:
+	case BSP_LUMP_TYPE_VISDATA:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Maps the whole file read-only into map->file_mapping.
+// False if the platform or file doesn't allow it.
+b32 _load_bsp_map_file(char *filename, bsp_map_t *map)
+{
+	size_t size = 0;
+	void *view  = _load_bsp_map_view(filename, &size);
+	if (view == NULL)
+	{
+		return false;
+	}
+
+	map->file_mapping      = view;
+	map->file_mapping_size = size;
+	return true;
+}
+
+// Read-only view of a whole file, NULL if the platform or file doesn't allow it.
+// Also used for .bspc caches, release with _load_bsp_unmap_view.
+void *_load_bsp_map_view(char *filename, size_t *size)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return NULL;
+	}
+
+	LARGE_INTEGER file_size;
+	HANDLE mapping = NULL;
+	void *view     = NULL;
+	if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+	{
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	}
+	if (mapping != NULL)
+	{
+		// The view keeps the mapping alive
+		view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+
+	if (view == NULL)
+	{
+		mg_println("WARN: _load_bsp_map_view failed to map '%s', reading instead", filename);
+		return NULL;
+	}
+
+	*size = file_size.QuadPart;
+	return view;
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		return NULL;
+	}
+
+	struct stat st;
+	void *view = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		view = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+
+	if (view == MAP_FAILED)
+	{
+		mg_println("WARN: _load_bsp_map_view failed to map '%s', reading instead", filename);
+		return NULL;
+	}
+
+	*size = st.st_size;
+	return view;
+#endif
+}
+
+void _load_bsp_unmap_view(void *view, size_t size)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(view);
+#else
+	munmap(view, size);
+#endif
+}
+
+// Called by bsp_map_free after the lumps pointing into the mapping are no longer used
+void unmap_bsp(bsp_map_t *map)
+{
+	if (map->file_mapping == NULL)
+	{
+		return;
+	}
+
+	_load_bsp_unmap_view(map->file_mapping, map->file_mapping_size);
+
+	map->file_mapping      = NULL;
+	map->file_mapping_size = 0;
+	map->mapped_lumps      = 0;
+}
+
+// Peak resident set size of the process in KB, 0 if unknown
+size_t _load_bsp_peak_rss()
+{
+#ifdef _WIN32
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024; // bytes
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
 }
\ No newline at end of file
@@ -15,11 +15,18 @@
 #include "../util/string.h"
 #include "bsp_types.h"
 
-b32 _load_bsp_fail(gs_byte_buffer_t *buffer, char *msg);
+b32 _load_bsp_fail(gs_byte_buffer_t *buffer, bsp_map_t *map, char *msg);
+void _load_bsp_free_buffer(gs_byte_buffer_t *buffer, bsp_map_t *map);
 b32 load_bsp(char *filename, bsp_map_t *map);
+void unmap_bsp(bsp_map_t *map);
 b32 _load_bsp_header(gs_byte_buffer_t *buffer, bsp_header_t *header);
 b32 _load_lump(gs_byte_buffer_t *buffer, bsp_map_t *map, uint32_t *count, void **data, bsp_lump_types type, uint32_t lump_size);
 b32 _load_entity_lump(gs_byte_buffer_t *buffer, bsp_map_t *map);
 b32 _load_visdata_lump(gs_byte_buffer_t *buffer, bsp_map_t *map);
+b32 _load_bsp_lump_read_only(bsp_lump_types type);
+b32 _load_bsp_map_file(char *filename, bsp_map_t *map);
+void *_load_bsp_map_view(char *filename, size_t *size);
+void _load_bsp_unmap_view(void *view, size_t size);
+size_t _load_bsp_peak_rss();
 
 #endif // BSP_LOADER_H
\ No newline at end of file
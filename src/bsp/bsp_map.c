@@ -11,63 +11,117 @@
 =================================================================*/
 
 #include "bsp_map.h"
+#include "bsp_loader.h"
 #include "../game/config.h"
+#include "../game/job_manager.h"
 #include "../game/time_manager.h"
 #include "../graphics/renderer.h"
 #include "../graphics/texture_manager.h"
+#include "../graphics/ui_manager.h"
 #include "../util/camera.h"
 #include "../util/render.h"
 #include "../util/transform.h"
 
+// Loads everything at once. Map loading normally goes through
+// mg_map_loader, which runs the same steps over several frames.
 void bsp_map_init(bsp_map_t *map)
 {
-	map->previous_leaf = uint32_max;
+	bsp_map_init_data(map, MG_JOB_MANAGER_THREADS);
+	bsp_map_init_textures(map, true);
+	bsp_map_init_buffers(map);
+	bsp_map_init_graphics(map);
+}
 
-	// Init dynamic arrays
-	gs_dyn_array_reserve(map->render_faces, map->faces.count);
-	uint32_t patch_count = 0;
+// Runtime data from the file lumps, doesn't touch graphics state.
+// Safe to call off the main thread.
+void bsp_map_init_data(bsp_map_t *map, uint32_t num_threads)
+{
+	map->previous_leaf     = uint32_max;
+	map->pvs_cache.valid   = false;
+	map->pvs_cache.cluster = -1;
+	map->pvs_cache.leaves  = gs_dyn_array_new(int32_t);
+	map->pvs_cache.faces   = gs_dyn_array_new(int32_t);
+	map->pvs_cache.nodes   = gs_dyn_array_new(uint8_t);
+	bsp_vis_init(&map->vis, map);
+	bsp_trace_init(map, mg_cvar("cl_patch_collision_level")->value.i);
+	bsp_point_init(map);
+	_bsp_map_find_parents(map);
+	bsp_draw_list_init(&map->draw_list);
+
+	_bsp_build_lightmaps(map);
+	_bsp_load_lightvols(map);
+
+	// Loaded by bsp_cache_load if the map has a valid cache
+	if (!map->from_cache)
+	{
+		_bsp_load_entities(map);
+		_bsp_create_render_faces(map, num_threads);
+	}
+
+	// Face sets
+	mg_bitset_init(&map->visible_faces, map->faces.count);
+	mg_bitset_init(&map->surface_faces, map->faces.count);
+	mg_bitset_init(&map->patch_faces, map->faces.count);
 	for (size_t i = 0; i < map->faces.count; i++)
 	{
-		if (map->faces.data[i].type == BSP_FACE_TYPE_PATCH)
+		if (map->render_faces[i].type == BSP_FACE_TYPE_PATCH)
 		{
-			patch_count++;
+			mg_bitset_set(&map->patch_faces, i);
+		}
+		else if (map->render_faces[i].type != BSP_FACE_TYPE_BILLBOARD)
+		{
+			mg_bitset_set(&map->surface_faces, i);
 		}
 	}
-	gs_dyn_array_reserve(map->patches, patch_count);
-
-	// Load stuff
-	_bsp_load_entities(map);
-	_bsp_load_textures(map);
-	_bsp_load_lightmaps(map);
-	_bsp_load_lightvols(map);
 
-	uint32_t face_array_idx	 = 0;
-	uint32_t patch_array_idx = 0;
+	// Occlusion culling
+	bsp_occlusion_init(&map->occlusion, BSP_OCCLUSION_WIDTH, BSP_OCCLUSION_HEIGHT);
+	bsp_occlusion_find_occluders(&map->occlusion, map, BSP_OCCLUSION_MIN_AREA);
 
-	// Create renderable faces and patches
-	for (size_t i = 0; i < map->faces.count; i++)
+	// Static stats
+	for (size_t i = 0; i < gs_dyn_array_size(map->render_faces); i++)
 	{
-		bsp_face_renderable_t face = {
-			.type = map->faces.data[i].type,
-		};
-
-		if (face.type == BSP_FACE_TYPE_PATCH)
+		if (map->render_faces[i].type == BSP_FACE_TYPE_PATCH)
 		{
-			_bsp_create_patch(map, map->faces.data[i]);
-			// index to map->patches
-			face.index = patch_array_idx;
-			patch_array_idx++;
+			map->stats.total_patches++;
 		}
 		else
 		{
-			// index to map->faces
-			face.index = i;
-			face_array_idx++;
+			map->stats.total_faces++;
 		}
+	}
+}
 
-		gs_dyn_array_push(map->render_faces, face);
+// Textures, lightmaps and materials, main thread only.
+// If load is false, textures not already in the texture manager are missing.
+void bsp_map_init_textures(bsp_map_t *map, bool32_t load)
+{
+	map->gpu_resources = true;
+	_bsp_load_textures(map, load);
+	_bsp_load_lightmaps(map);
+	_bsp_load_materials(map);
+}
+
+// Vertex, layer and index arrays, needs materials from bsp_map_init_textures.
+// Safe to call off the main thread.
+void bsp_map_init_buffers(bsp_map_t *map)
+{
+	// Layers depend on the materials, so they're never cached
+	if (!map->from_cache)
+	{
+		_bsp_map_build_arrays(map);
 	}
+	_bsp_map_build_layers(map);
+	_bsp_map_build_cluster_draws(map);
+
+	// Static stats
+	map->stats.total_vertices = gs_dyn_array_size(map->bsp_graphics_vert_arr); // inaccurate, has patch control verts
+	map->stats.total_indices  = gs_dyn_array_size(map->bsp_graphics_index_arr);
+}
 
+// Buffers, uniforms and pipelines, main thread only
+void bsp_map_init_graphics(bsp_map_t *map)
+{
 	// Index & Vertex buffers
 	_bsp_map_create_buffers(map);
 
@@ -104,6 +158,14 @@ void bsp_map_init(bsp_map_t *map)
 			},
 			.stage = GS_GRAPHICS_SHADER_STAGE_FRAGMENT,
 		});
+	map->bsp_graphics_u_layers = gs_graphics_uniform_create(
+		&(gs_graphics_uniform_desc_t){
+			.name	= "u_layers",
+			.layout = &(gs_graphics_uniform_layout_desc_t){
+				.type = GS_GRAPHICS_UNIFORM_FLOAT,
+			},
+			.stage = GS_GRAPHICS_SHADER_STAGE_FRAGMENT,
+		});
 
 	// Pipeline vertex attributes
 	size_t total_stride			     = sizeof(float32_t) * 10 + sizeof(uint8_t) * 4;
@@ -115,6 +177,16 @@ void bsp_map_init(bsp_map_t *map)
 		(gs_graphics_vertex_attribute_desc_t){.format = GS_GRAPHICS_VERTEX_ATTRIBUTE_BYTE4, .name = "a_color", .stride = total_stride, .offset = sizeof(float32_t) * 10},
 	};
 
+	// Layered material mode adds texture layer from a second buffer
+	gs_graphics_vertex_attribute_desc_t layered_vattrs[] = {
+		(gs_graphics_vertex_attribute_desc_t){.format = GS_GRAPHICS_VERTEX_ATTRIBUTE_FLOAT3, .name = "a_pos", .stride = total_stride, .offset = 0},
+		(gs_graphics_vertex_attribute_desc_t){.format = GS_GRAPHICS_VERTEX_ATTRIBUTE_FLOAT2, .name = "a_tex_coord", .stride = total_stride, .offset = sizeof(float32_t) * 3},
+		(gs_graphics_vertex_attribute_desc_t){.format = GS_GRAPHICS_VERTEX_ATTRIBUTE_FLOAT2, .name = "a_lm_coord", .stride = total_stride, .offset = sizeof(float32_t) * 5},
+		(gs_graphics_vertex_attribute_desc_t){.format = GS_GRAPHICS_VERTEX_ATTRIBUTE_FLOAT3, .name = "a_normal", .stride = total_stride, .offset = sizeof(float32_t) * 7},
+		(gs_graphics_vertex_attribute_desc_t){.format = GS_GRAPHICS_VERTEX_ATTRIBUTE_BYTE4, .name = "a_color", .stride = total_stride, .offset = sizeof(float32_t) * 10},
+		(gs_graphics_vertex_attribute_desc_t){.format = GS_GRAPHICS_VERTEX_ATTRIBUTE_FLOAT, .name = "a_layer", .stride = sizeof(float32_t), .offset = 0, .buffer_idx = 1},
+	};
+
 	map->bsp_graphics_pipe = gs_graphics_pipeline_create(
 		&(gs_graphics_pipeline_desc_t){
 			.raster = {
@@ -137,6 +209,28 @@ void bsp_map_init(bsp_map_t *map)
 				.size  = sizeof(vattrs),
 			},
 		});
+	map->bsp_graphics_layered_pipe = gs_graphics_pipeline_create(
+		&(gs_graphics_pipeline_desc_t){
+			.raster = {
+				.shader			   = mg_renderer_get_shader("bsp_layered"),
+				.index_buffer_element_size = sizeof(uint32_t),
+				.primitive		   = GS_GRAPHICS_PRIMITIVE_TRIANGLES,
+				.face_culling		   = GS_GRAPHICS_FACE_CULLING_BACK,
+				.winding_order		   = GS_GRAPHICS_WINDING_ORDER_CW,
+			},
+			.blend = {
+				.func = GS_GRAPHICS_BLEND_EQUATION_ADD,
+				.src  = GS_GRAPHICS_BLEND_MODE_SRC_ALPHA,
+				.dst  = GS_GRAPHICS_BLEND_MODE_ONE_MINUS_SRC_ALPHA,
+			},
+			.depth = {
+				.func = GS_GRAPHICS_DEPTH_FUNC_LESS,
+			},
+			.layout = {
+				.attrs = layered_vattrs,
+				.size  = sizeof(layered_vattrs),
+			},
+		});
 	map->bsp_graphics_wire_pipe = gs_graphics_pipeline_create(
 		&(gs_graphics_pipeline_desc_t){
 			.raster = {
@@ -157,12 +251,52 @@ void bsp_map_init(bsp_map_t *map)
 				.size  = sizeof(vattrs),
 			},
 		});
+}
 
-	// Static stats
-	map->stats.total_vertices = gs_dyn_array_size(map->bsp_graphics_vert_arr); // inaccurate, has patch control verts
-	map->stats.total_indices  = gs_dyn_array_size(map->bsp_graphics_index_arr);
-	map->stats.total_faces	  = face_array_idx;
-	map->stats.total_patches  = patch_array_idx;
+// Renderable faces and tesselated patches
+void _bsp_create_render_faces(bsp_map_t *map, uint32_t num_threads)
+{
+	// Init dynamic arrays
+	gs_dyn_array_reserve(map->render_faces, map->faces.count);
+	uint32_t patch_count = 0;
+	for (size_t i = 0; i < map->faces.count; i++)
+	{
+		if (map->faces.data[i].type == BSP_FACE_TYPE_PATCH)
+		{
+			patch_count++;
+		}
+	}
+	gs_dyn_array_reserve(map->patches, patch_count);
+
+	uint32_t patch_array_idx = 0;
+
+	// Create renderable faces and patches
+	for (size_t i = 0; i < map->faces.count; i++)
+	{
+		bsp_face_renderable_t face = {
+			.type	  = map->faces.data[i].type,
+			.texture  = map->faces.data[i].texture,
+			.lm_index = bsp_lightmap_atlas_page(&map->lightmap_atlas, map->faces.data[i].lm_index),
+		};
+
+		if (face.type == BSP_FACE_TYPE_PATCH)
+		{
+			_bsp_create_patch(map, map->faces.data[i]);
+			// index to map->patches
+			face.index = patch_array_idx;
+			patch_array_idx++;
+		}
+		else
+		{
+			// index to map->faces
+			face.index = i;
+		}
+
+		gs_dyn_array_push(map->render_faces, face);
+	}
+
+	// Patches are independent, tesselate them in parallel
+	mg_job_manager_parallel_for(_bsp_tesselate_patches_job, map, patch_array_idx, BSP_PATCH_JOB_CHUNK, num_threads);
 }
 
 void _bsp_load_entities(bsp_map_t *map)
@@ -186,17 +320,26 @@ void _bsp_load_entities(bsp_map_t *map)
 	gs_free(ents);
 }
 
-void _bsp_load_textures(bsp_map_t *map)
+void _bsp_load_textures(bsp_map_t *map, bool32_t load)
 {
 	int32_t num_textures = map->header.dir_entries[BSP_LUMP_TYPE_TEXTURES].length / sizeof(bsp_texture_lump_t);
 
-	map->stats.total_textures = num_textures;
-	map->texture_assets.count = num_textures;
-	map->texture_assets.data  = gs_malloc(sizeof(gs_asset_texture_t *) * num_textures);
+	map->stats.total_textures   = num_textures;
+	map->texture_assets.count   = num_textures;
+	map->texture_assets.data    = gs_malloc(sizeof(gs_asset_texture_t *) * num_textures);
+	map->texture_assets.handles = gs_malloc(sizeof(uint32_t) * num_textures);
 
 	for (size_t i = 0; i < num_textures; i++)
 	{
-		map->texture_assets.data[i] = mg_texture_manager_get(map->textures.data[i].name);
+		if (load)
+		{
+			map->texture_assets.data[i] = mg_texture_manager_get(map->textures.data[i].name);
+		}
+		else
+		{
+			map->texture_assets.data[i] = mg_texture_manager_find(map->textures.data[i].name);
+		}
+		map->texture_assets.handles[i] = mg_texture_manager_find_handle(map->textures.data[i].name);
 		if (map->texture_assets.data[i] != NULL)
 		{
 			map->stats.loaded_textures++;
@@ -222,6 +365,12 @@ void _bsp_load_textures(bsp_map_t *map)
 	gs_free(pixels);
 }
 
+// Packs lightmaps to atlas pages, CPU only
+void _bsp_build_lightmaps(bsp_map_t *map)
+{
+	bsp_lightmap_atlas_build(&map->lightmap_atlas, map->lightmaps.data, map->lightmaps.count, BSP_LIGHTMAP_ATLAS_PADDING, BSP_LIGHTMAP_ATLAS_MAX_SIZE);
+}
+
 void _bsp_load_lightmaps(bsp_map_t *map)
 {
 	gs_color_t gray		= gs_color(100, 100, 100, 255);
@@ -237,29 +386,60 @@ void _bsp_load_lightmaps(bsp_map_t *map)
 			.num_mips   = 1,
 			.data	    = &gray});
 
-	map->lightmap_textures.data  = gs_malloc(map->lightmaps.count * sizeof(gs_handle(gs_graphics_texture_t)));
-	map->lightmap_textures.count = map->lightmaps.count;
+	// Atlas build failed
+	if (map->lightmap_atlas.num_pages == 0)
+	{
+		map->lightmap_textures.data  = NULL;
+		map->lightmap_textures.count = 0;
+		return;
+	}
+
+	// One texture per atlas page
+	map->lightmap_textures.data  = gs_malloc(map->lightmap_atlas.num_pages * sizeof(gs_handle(gs_graphics_texture_t)));
+	map->lightmap_textures.count = map->lightmap_atlas.num_pages;
 
-	for (size_t i = 0; i < map->lightmaps.count; i++)
+	for (size_t i = 0; i < map->lightmap_atlas.num_pages; i++)
 	{
 		map->lightmap_textures.data[i] = gs_graphics_texture_create(
 			&(gs_graphics_texture_desc_t){
 				.type	    = GS_GRAPHICS_TEXTURE_2D,
-				.width	    = 128,
-				.height	    = 128,
+				.width	    = map->lightmap_atlas.page_size,
+				.height	    = map->lightmap_atlas.page_size,
 				.format	    = GS_GRAPHICS_TEXTURE_FORMAT_RGB8,
 				.min_filter = GS_GRAPHICS_TEXTURE_FILTER_LINEAR,
 				.mag_filter = GS_GRAPHICS_TEXTURE_FILTER_LINEAR,
 				.mip_filter = GS_GRAPHICS_TEXTURE_FILTER_LINEAR,
 				.num_mips   = 1,
-				.data	    = map->lightmaps.data[i].map});
+				.data	    = map->lightmap_atlas.pages[i]});
 	}
+
+	bsp_lightmap_atlas_free_pixels(&map->lightmap_atlas);
 }
 
 void _bsp_load_lightvols(bsp_map_t *map)
 {
 }
 
+void _bsp_load_materials(bsp_map_t *map)
+{
+	map->material_arrays = mg_cvar("r_texture_arrays")->value.i;
+
+	bsp_material_table_build(&map->material_table, map->texture_assets.data, map->texture_assets.count, BSP_MATERIAL_MAX_ARRAY_HEIGHT);
+	if (map->material_arrays)
+	{
+		bsp_material_table_create_textures(&map->material_table, map);
+	}
+}
+
+// Recreates layered textures with the current texture filter
+void bsp_map_rebuild_materials(bsp_map_t *map)
+{
+	if (map->valid && map->gpu_resources && map->material_arrays)
+	{
+		bsp_material_table_create_textures(&map->material_table, map);
+	}
+}
+
 void _bsp_create_patch(bsp_map_t *map, bsp_face_lump_t face)
 {
 	bsp_patch_t patch = {
@@ -283,33 +463,34 @@ void _bsp_create_patch(bsp_map_t *map, bsp_face_lump_t face)
 			uint32_t patch_idx = y * num_patches_x + x;
 
 			bsp_quadratic_patch_t quadratic = {
-				.tesselation = 8,
+				.tesselation = BSP_PATCH_RENDER_TESSELATION,
 			};
-
-			// Get the 9 vertices used as control points for this quadratic patch.
-			for (size_t row = 0; row < 3; row++)
-			{
-				for (size_t col = 0; col < 3; col++)
-				{
-					uint32_t control_point_idx = row * 3 + col;
-					// I understood this index when I wrote it but didn't add comments...
-					// Let's just hope I never have to debug this.
-					//                    offset               ???                             ???
-					uint32_t vertex_idx			    = face.first_vertex + (2 * y * patch.width + 2 * x) + (row * patch.width + col);
-					quadratic.control_points[control_point_idx] = map->vertices.data[vertex_idx];
-				}
-			}
+			bsp_quadratic_patch_control_points(map->vertices.data, face, x, y, quadratic.control_points);
 
 			gs_dyn_array_set_data_i(&patch.quadratic_patches, &quadratic, sizeof(bsp_quadratic_patch_t), patch_idx);
-			bsp_quadratic_patch_tesselate(&patch.quadratic_patches[patch_idx]);
 		}
 	}
 
-	uint32_t temp = gs_dyn_array_size(patch.quadratic_patches);
+	// Tesselated later by _bsp_tesselate_patches_job
 	gs_dyn_array_push(map->patches, patch);
 }
 
-void _bsp_map_create_buffers(bsp_map_t *map)
+void _bsp_tesselate_patches_job(void *data, uint32_t start, uint32_t end, uint32_t thread)
+{
+	bsp_map_t *map = data;
+
+	for (uint32_t i = start; i < end; i++)
+	{
+		for (size_t j = 0; j < gs_dyn_array_size(map->patches[i].quadratic_patches); j++)
+		{
+			bsp_quadratic_patch_tesselate(&map->patches[i].quadratic_patches[j]);
+		}
+	}
+}
+
+// Merged vertex and index arrays of faces and patches, CPU only.
+// Doesn't need textures, bsp_cache_compile stores the result.
+void _bsp_map_build_arrays(bsp_map_t *map)
 {
 	map->bsp_graphics_index_arr = gs_dyn_array_new(uint32_t);
 	map->bsp_graphics_vert_arr  = gs_dyn_array_new(bsp_vert_lump_t);
@@ -318,6 +499,23 @@ void _bsp_map_create_buffers(bsp_map_t *map)
 	gs_dyn_array_reserve(map->bsp_graphics_vert_arr, map->vertices.count);
 	gs_dyn_array_push_data(&map->bsp_graphics_vert_arr, map->vertices.data, map->vertices.count * sizeof(bsp_vert_lump_t));
 	gs_dyn_array_head(map->bsp_graphics_vert_arr)->size = map->vertices.count;
+
+	// Lightmap coords to atlas space.
+	// Faces shouldn't share vertices, but make sure not to remap twice.
+	uint8_t *remapped = gs_calloc(map->vertices.count, sizeof(uint8_t));
+	for (size_t i = 0; i < map->faces.count; i++)
+	{
+		bsp_face_lump_t face = map->faces.data[i];
+		for (size_t j = face.first_vertex; j < face.first_vertex + face.num_vertices; j++)
+		{
+			if (remapped[j]) continue;
+			remapped[j] = true;
+
+			map->bsp_graphics_vert_arr[j].lm_coord = bsp_lightmap_atlas_remap(&map->lightmap_atlas, face.lm_index, map->bsp_graphics_vert_arr[j].lm_coord);
+		}
+	}
+	gs_free(remapped);
+
 	for (size_t i = 0; i < gs_dyn_array_size(map->render_faces); i++)
 	{
 		if (map->render_faces[i].type != BSP_FACE_TYPE_PATCH)
@@ -352,7 +550,9 @@ void _bsp_map_create_buffers(bsp_map_t *map)
 
 				for (size_t k = 0; k < gs_dyn_array_size(quadratic.vertices); k++)
 				{
-					gs_dyn_array_push(map->bsp_graphics_vert_arr, quadratic.vertices[k]);
+					bsp_vert_lump_t vert = quadratic.vertices[k];
+					vert.lm_coord	     = bsp_lightmap_atlas_remap(&map->lightmap_atlas, patch.lightmap_idx, vert.lm_coord);
+					gs_dyn_array_push(map->bsp_graphics_vert_arr, vert);
 				}
 
 				for (size_t k = 0; k < gs_dyn_array_size(quadratic.indices); k++)
@@ -364,13 +564,63 @@ void _bsp_map_create_buffers(bsp_map_t *map)
 			map->render_faces[i].num_ibo_indices = gs_dyn_array_size(map->bsp_graphics_index_arr) - map->render_faces[i].first_ibo_index;
 		}
 	}
+}
 
-	// Index buffer
+// Texture layer per vertex of the merged array, same order as _bsp_map_build_arrays
+void _bsp_map_build_layers(bsp_map_t *map)
+{
+	uint32_t count		    = gs_dyn_array_size(map->bsp_graphics_vert_arr);
+	map->bsp_graphics_layer_arr = gs_dyn_array_new(float);
+	gs_dyn_array_reserve(map->bsp_graphics_layer_arr, count);
+	gs_dyn_array_head(map->bsp_graphics_layer_arr)->size = count;
+	memset(map->bsp_graphics_layer_arr, 0, count * sizeof(float));
+
+	// First face using a vertex sets its layer
+	uint8_t *assigned = gs_calloc(map->vertices.count, sizeof(uint8_t));
+	for (size_t i = 0; i < map->faces.count; i++)
+	{
+		bsp_face_lump_t face = map->faces.data[i];
+		float layer	     = _bsp_get_texture_layer(map, face.texture);
+		for (size_t j = face.first_vertex; j < face.first_vertex + face.num_vertices; j++)
+		{
+			if (assigned[j]) continue;
+			assigned[j] = true;
+
+			map->bsp_graphics_layer_arr[j] = layer;
+		}
+	}
+	gs_free(assigned);
+
+	// Patch vertices follow the lump vertices in render face order
+	uint32_t offset = map->vertices.count;
+	for (size_t i = 0; i < gs_dyn_array_size(map->render_faces); i++)
+	{
+		if (map->render_faces[i].type == BSP_FACE_TYPE_PATCH)
+		{
+			bsp_patch_t patch = map->patches[map->render_faces[i].index];
+			float layer	  = _bsp_get_texture_layer(map, patch.texture_idx);
+
+			for (size_t j = 0; j < gs_dyn_array_size(patch.quadratic_patches); j++)
+			{
+				uint32_t num_vertices = gs_dyn_array_size(patch.quadratic_patches[j].vertices);
+				for (uint32_t k = 0; k < num_vertices && offset < count; k++)
+				{
+					map->bsp_graphics_layer_arr[offset++] = layer;
+				}
+			}
+		}
+	}
+}
+
+void _bsp_map_create_buffers(bsp_map_t *map)
+{
+	// Index buffer, rewritten from the draw list every frame.
+	// Visible indices are a subset of all indices, so this size is enough.
 	map->bsp_graphics_ibo = gs_graphics_index_buffer_create(
 		&(gs_graphics_index_buffer_desc_t){
 			.data  = map->bsp_graphics_index_arr,
 			.size  = sizeof(uint32_t) * gs_dyn_array_size(map->bsp_graphics_index_arr),
-			.usage = GS_GRAPHICS_BUFFER_USAGE_STATIC,
+			.usage = GS_GRAPHICS_BUFFER_USAGE_STREAM,
 		});
 
 	// Vertex buffer
@@ -380,6 +630,100 @@ void _bsp_map_create_buffers(bsp_map_t *map)
 			.size  = sizeof(bsp_vert_lump_t) * gs_dyn_array_size(map->bsp_graphics_vert_arr),
 			.usage = GS_GRAPHICS_BUFFER_USAGE_STATIC,
 		});
+
+	// Texture layer per vertex
+	map->bsp_graphics_layer_vbo = gs_graphics_vertex_buffer_create(
+		&(gs_graphics_vertex_buffer_desc_t){
+			.data  = map->bsp_graphics_layer_arr,
+			.size  = sizeof(float) * gs_dyn_array_size(map->bsp_graphics_layer_arr),
+			.usage = GS_GRAPHICS_BUFFER_USAGE_STATIC,
+		});
+
+	if (map->cluster_draw)
+	{
+		map->bsp_graphics_cluster_ibo = gs_graphics_index_buffer_create(
+			&(gs_graphics_index_buffer_desc_t){
+				.data  = map->cluster_draws.indices,
+				.size  = map->stats.cluster_index_bytes,
+				.usage = GS_GRAPHICS_BUFFER_USAGE_STATIC,
+			});
+	}
+}
+
+// Each cluster's faces in contiguous material ranges for a static
+// index buffer, lets visible clusters draw without uploads. CPU only.
+void _bsp_map_build_cluster_draws(bsp_map_t *map)
+{
+	map->cluster_draw = mg_cvar("r_cluster_draw")->value.i;
+	if (!map->cluster_draw)
+	{
+		return;
+	}
+
+	bsp_cluster_draws_build(
+		&map->cluster_draws,
+		map,
+		map->material_arrays ? map->material_table.texture_key : NULL);
+
+	size_t base_bytes		  = sizeof(uint32_t) * gs_dyn_array_size(map->bsp_graphics_index_arr);
+	map->stats.total_clusters	  = map->cluster_draws.num_clusters;
+	map->stats.cluster_ranges	  = gs_dyn_array_size(map->cluster_draws.ranges);
+	map->stats.cluster_index_bytes	  = sizeof(uint32_t) * gs_dyn_array_size(map->cluster_draws.indices);
+	map->stats.cluster_index_overhead = map->stats.cluster_index_bytes > base_bytes ? map->stats.cluster_index_bytes - base_bytes : 0;
+	map->stats.cluster_ranges_max	  = 0;
+	for (size_t i = 0; i < gs_dyn_array_size(map->cluster_draws.clusters); i++)
+	{
+		map->stats.cluster_ranges_max = gs_max(map->stats.cluster_ranges_max, map->cluster_draws.clusters[i].num_ranges);
+	}
+
+	mg_println(
+		"bsp_map: %u clusters, %u draw ranges (max %u per cluster), %zu index bytes (+%zu)",
+		map->stats.total_clusters,
+		map->stats.cluster_ranges,
+		map->stats.cluster_ranges_max,
+		map->stats.cluster_index_bytes,
+		map->stats.cluster_index_overhead);
+}
+
+float _bsp_get_texture_layer(bsp_map_t *map, int32_t texture)
+{
+	if (texture < 0 || texture >= map->material_table.num_textures)
+	{
+		return 0;
+	}
+
+	return map->material_table.texture_layer[texture];
+}
+
+void _bsp_map_find_parents(bsp_map_t *map)
+{
+	map->node_parents = gs_dyn_array_new(int32_t);
+	map->leaf_parents = gs_dyn_array_new(int32_t);
+
+	for (size_t i = 0; i < map->nodes.count; i++)
+	{
+		gs_dyn_array_push(map->node_parents, -1);
+	}
+	for (size_t i = 0; i < map->leaves.count; i++)
+	{
+		gs_dyn_array_push(map->leaf_parents, -1);
+	}
+
+	for (size_t i = 0; i < map->nodes.count; i++)
+	{
+		for (size_t j = 0; j < 2; j++)
+		{
+			int32_t child = map->nodes.data[i].children[j];
+			if (child >= 0)
+			{
+				map->node_parents[child] = i;
+			}
+			else
+			{
+				map->leaf_parents[~child] = i;
+			}
+		}
+	}
 }
 
 void bsp_map_update(bsp_map_t *map, gs_camera_t *cam, const gs_vec2 fb)
@@ -389,13 +733,56 @@ void bsp_map_update(bsp_map_t *map, gs_camera_t *cam, const gs_vec2 fb)
 	int32_t leaf = _bsp_find_camera_leaf(map, cam->transform.position);
 	if (leaf != map->previous_leaf)
 	{
-		// TODO: recalc PVS, move from _bsp_calculate_visible_faces
+		// PVS is per cluster, moving between leaves
+		// of the same cluster keeps the cached set.
+		_bsp_update_pvs_cache(map, map->leaves.data[leaf].cluster);
 	}
 
-	_bsp_calculate_visible_faces(map, leaf, cam, fb);
-	map->previous_leaf = leaf;
+	gs_mat4 proj	       = mg_camera_get_view_projection(cam, (s32)fb.x, (s32)fb.y);
+	mg_camera_frustum_t fr = mg_camera_get_frustum_planes(proj, false);
+
+	// Occluders from the PVS set, leaves and clusters are tested against them
+	map->occlusion.valid	      = false;
+	map->stats.occluder_triangles = 0;
+	if (g_renderer->r_occlusion->value.i)
+	{
+		bsp_occlusion_begin(&map->occlusion, proj);
+		map->stats.occluder_triangles = bsp_occlusion_draw_occluders(&map->occlusion, map);
+	}
+
+	// Cluster ranges don't need the per leaf walk,
+	// only run it for the debug overlay's face stats.
+	if (!map->cluster_draw || g_ui_manager->debug_open)
+	{
+		_bsp_calculate_visible_faces(map, leaf, &fr);
+	}
+	map->stats.current_leaf = leaf;
+	map->previous_leaf	= leaf;
+
+	if (map->cluster_draw)
+	{
+		// Static ranges, nothing to rebuild
+		map->stats.visible_clusters = bsp_cluster_draws_cull(
+			&map->cluster_draws,
+			map,
+			&fr,
+			map->leaves.data[leaf].cluster,
+			&map->stats.occluded_clusters);
+		map->stats.draw_calls = gs_dyn_array_size(map->cluster_draws.visible_ranges);
+	}
+	else
+	{
+		bsp_draw_list_build(
+			&map->draw_list,
+			map->render_faces,
+			&map->visible_faces,
+			map->bsp_graphics_index_arr,
+			map->material_arrays ? map->material_table.texture_key : NULL);
+		map->stats.draw_calls = gs_dyn_array_size(map->draw_list.ranges);
+	}
 
 	mg_time_manager_vis_end();
+	map->stats.vis_time = g_time_manager->vis;
 }
 
 void bsp_map_render_immediate(bsp_map_t *map, gs_immediate_draw_t *gsi, gs_camera_t *cam)
@@ -404,10 +791,8 @@ void bsp_map_render_immediate(bsp_map_t *map, gs_immediate_draw_t *gsi, gs_camer
 	gsi_depth_enabled(gsi, true);
 	// gsi_face_cull_enabled(gsi, true);
 
-	for (size_t i = 0; i < gs_dyn_array_size(map->render_faces); i++)
+	for (int32_t i = mg_bitset_next(&map->visible_faces, 0); i >= 0; i = mg_bitset_next(&map->visible_faces, i + 1))
 	{
-		if (!map->render_faces[i].visible) continue;
-
 		bsp_face_renderable_t bsp_face = map->render_faces[i];
 		int32_t index		       = bsp_face.index;
 
@@ -495,7 +880,8 @@ void bsp_map_render(bsp_map_t *map, gs_camera_t *cam, gs_handle(gs_graphics_rend
 {
 	mg_time_manager_bsp_start();
 
-	bool wireframe = mg_cvar("r_wireframe")->value.i;
+	bool wireframe = g_renderer->r_wireframe->value.i;
+	bool layered   = map->material_arrays && !wireframe;
 
 	// Clear desc
 	gs_graphics_clear_desc_t clear = (gs_graphics_clear_desc_t){
@@ -524,18 +910,19 @@ void bsp_map_render(bsp_map_t *map, gs_camera_t *cam, gs_handle(gs_graphics_rend
 	// Vertex buffer binds
 	gs_graphics_bind_vertex_buffer_desc_t vbos[] = {
 		{.buffer = map->bsp_graphics_vbo},
+		{.buffer = map->bsp_graphics_layer_vbo},
 	};
 
 	// Index buffer binds
 	gs_graphics_bind_index_buffer_desc_t ibos[] = {
-		{.buffer = map->bsp_graphics_ibo},
+		{.buffer = map->cluster_draw ? map->bsp_graphics_cluster_ibo : map->bsp_graphics_ibo},
 	};
 
 	// Construct binds
 	gs_graphics_bind_desc_t binds = {
 		.vertex_buffers = {
 			.desc = vbos,
-			.size = sizeof(vbos),
+			.size = layered ? sizeof(vbos) : sizeof(vbos[0]),
 		},
 		.index_buffers = {
 			.desc = ibos,
@@ -547,27 +934,52 @@ void bsp_map_render(bsp_map_t *map, gs_camera_t *cam, gs_handle(gs_graphics_rend
 		},
 	};
 
+	// Upload visible indices in draw list order
+	uint32_t num_indices = gs_dyn_array_size(map->draw_list.indices);
+	if (!map->cluster_draw && num_indices > 0)
+	{
+		gs_graphics_index_buffer_request_update(
+			cb,
+			map->bsp_graphics_ibo,
+			&(gs_graphics_index_buffer_desc_t){
+				.data	= map->draw_list.indices,
+				.size	= sizeof(uint32_t) * num_indices,
+				.usage	= GS_GRAPHICS_BUFFER_USAGE_STREAM,
+				.update = {
+					.type	= GS_GRAPHICS_BUFFER_UPDATE_SUBDATA,
+					.offset = 0,
+				},
+			});
+	}
+
 	// Render
 	gs_graphics_renderpass_begin(cb, rp);
 	gs_graphics_set_viewport(cb, 0, 0, (int32_t)fb.x, (int32_t)fb.y);
 	gs_graphics_clear(cb, &clear);
-	gs_graphics_pipeline_bind(cb, wireframe ? map->bsp_graphics_wire_pipe : map->bsp_graphics_pipe);
+	if (wireframe)
+	{
+		gs_graphics_pipeline_bind(cb, map->bsp_graphics_wire_pipe);
+	}
+	else
+	{
+		gs_graphics_pipeline_bind(cb, layered ? map->bsp_graphics_layered_pipe : map->bsp_graphics_pipe);
+	}
 	gs_graphics_apply_bindings(cb, &binds);
 
-	// Draw faces
+	// Draw one range per material
 	int32_t texture_index;
 	int32_t lm_index;
-	uint32_t vis_index;
-	bsp_face_renderable_t bsp_face;
-	for (size_t i = 0; i < gs_dyn_array_size(map->render_faces); i++)
+	int32_t array_index;
+	float layers;
+	bsp_draw_range_t range;
+	gs_dyn_array(bsp_draw_range_t) ranges = map->cluster_draw ? map->cluster_draws.visible_ranges : map->draw_list.ranges;
+	for (size_t i = 0; i < gs_dyn_array_size(ranges); i++)
 	{
-		if (!map->render_faces[i].visible) continue;
-
-		bsp_face      = map->render_faces[i];
-		texture_index = map->faces.data[bsp_face.index].texture;
-		lm_index      = map->faces.data[bsp_face.index].lm_index;
+		range	      = ranges[i];
+		texture_index = range.texture;
+		lm_index      = range.lm_index;
 
-		if (texture_index >= 0 && map->texture_assets.data[texture_index] == NULL || !gs_handle_is_valid(map->texture_assets.data[texture_index]->hndl))
+		if (texture_index >= 0 && (map->texture_assets.data[texture_index] == NULL || !gs_handle_is_valid(map->texture_assets.data[texture_index]->hndl)))
 		{
 			texture_index = -1;
 		}
@@ -576,75 +988,90 @@ void bsp_map_render(bsp_map_t *map, gs_camera_t *cam, gs_handle(gs_graphics_rend
 			lm_index = -1;
 		}
 
-		// Face specific uniforms
-		gs_graphics_bind_uniform_desc_t face_uniforms[] = {
+		// Range specific uniforms
+		gs_graphics_bind_uniform_desc_t range_uniforms[] = {
 			// TEXTURE OR COLOR
 			{0},
 			// LIGHTMAP
 			{0},
+			// LAYERS
+			{0},
 		};
 
-		uint8_t uniform_count = wireframe ? 1 : 2;
+		uint8_t uniform_count = wireframe ? 1 : (layered ? 3 : 2);
 
 		gs_vec4_t color = gs_v4(0, 0, 0, 1.0);
 
 		if (wireframe)
 		{
-			switch (map->faces.data[bsp_face.index].type)
-			{
-			case BSP_FACE_TYPE_POLYGON:
-				color.y = 1.0;
-				break;
-
-			case BSP_FACE_TYPE_MESH:
-				color.z = 1.0;
-				break;
-
-			case BSP_FACE_TYPE_PATCH:
-				color.x = 1.0;
-				break;
-
-			default:
-				color.x = 0.5;
-				color.y = 0.5;
-				color.z = 0.5;
-			}
+			// Color by range to show how faces were merged
+			color.x = ((i * 67) % 255) / 255.0f;
+			color.y = ((i * 131) % 255) / 255.0f;
+			color.z = ((i * 199) % 255) / 255.0f;
 
-			face_uniforms[0] = (gs_graphics_bind_uniform_desc_t){
+			range_uniforms[0] = (gs_graphics_bind_uniform_desc_t){
 				.uniform = map->bsp_graphics_u_color,
 				.data	 = &color,
 				.binding = 0, // FRAGMENT
 			};
 		}
+		else if (layered && texture_index >= 0 && map->material_table.texture_array[texture_index] >= 0)
+		{
+			array_index = map->material_table.texture_array[texture_index];
+			layers	    = gs_dyn_array_size(map->material_table.arrays[array_index].textures);
+
+			range_uniforms[0] = (gs_graphics_bind_uniform_desc_t){
+				.uniform = map->bsp_graphics_u_tex,
+				.data	 = &map->material_table.arrays[array_index].hndl,
+				.binding = 0, // FRAGMENT
+			};
+			range_uniforms[1] = (gs_graphics_bind_uniform_desc_t){
+				.uniform = map->bsp_graphics_u_lm,
+				.data	 = lm_index >= 0 ? &map->lightmap_textures.data[lm_index] : &map->missing_lm_texture,
+				.binding = 1, // FRAGMENT
+			};
+			range_uniforms[2] = (gs_graphics_bind_uniform_desc_t){
+				.uniform = map->bsp_graphics_u_layers,
+				.data	 = &layers,
+				.binding = 2, // FRAGMENT
+			};
+		}
 		else
 		{
-			face_uniforms[0] = (gs_graphics_bind_uniform_desc_t){
+			layers = 1;
+
+			range_uniforms[0] = (gs_graphics_bind_uniform_desc_t){
 				.uniform = map->bsp_graphics_u_tex,
 				.data	 = texture_index >= 0 ? &map->texture_assets.data[texture_index]->hndl : &map->missing_texture,
 				.binding = 0, // FRAGMENT
 			};
-			face_uniforms[1] = (gs_graphics_bind_uniform_desc_t){
+			range_uniforms[1] = (gs_graphics_bind_uniform_desc_t){
 				.uniform = map->bsp_graphics_u_lm,
 				.data	 = lm_index >= 0 ? &map->lightmap_textures.data[lm_index] : &map->missing_lm_texture,
 				.binding = 1, // FRAGMENT
 			};
+			range_uniforms[2] = (gs_graphics_bind_uniform_desc_t){
+				.uniform = map->bsp_graphics_u_layers,
+				.data	 = &layers,
+				.binding = 2, // FRAGMENT
+			};
 		}
 
 		// Bind uniforms
-		gs_graphics_bind_desc_t face_binds = {
+		gs_graphics_bind_desc_t range_binds = {
 			.uniforms = {
-				.desc = face_uniforms,
+				.desc = range_uniforms,
 				.size = sizeof(gs_graphics_bind_uniform_desc_t) * uniform_count,
 			},
 		};
-		gs_graphics_apply_bindings(cb, &face_binds);
+		gs_graphics_apply_bindings(cb, &range_binds);
 
-		// Draw face
+		// Draw range
 		gs_graphics_draw(
 			cb,
 			&(gs_graphics_draw_desc_t){
-				.start = (size_t)(intptr_t)(bsp_face.first_ibo_index * sizeof(uint32_t)),
-				.count = (size_t)bsp_face.num_ibo_indices,
+				.start = (size_t)(intptr_t)(range.first_index * sizeof(uint32_t)),
+				.count = (size_t)range.num_indices,
 			});
 	}
 
@@ -712,18 +1139,46 @@ void bsp_map_free(bsp_map_t *map)
 
 	/*==== Runtime data ====*/
 
-	if (map->valid)
+	// Handle 0 can be a live object, only destroy what was created
+	if (map->valid && map->gpu_resources)
 	{
 		gs_graphics_vertex_buffer_destroy(map->bsp_graphics_vbo);
+		gs_graphics_vertex_buffer_destroy(map->bsp_graphics_layer_vbo);
 		gs_graphics_index_buffer_destroy(map->bsp_graphics_ibo);
+		if (map->cluster_draw)
+		{
+			gs_graphics_index_buffer_destroy(map->bsp_graphics_cluster_ibo);
+		}
 		gs_graphics_pipeline_destroy(map->bsp_graphics_pipe);
+		gs_graphics_pipeline_destroy(map->bsp_graphics_layered_pipe);
 		gs_graphics_pipeline_destroy(map->bsp_graphics_wire_pipe);
 		gs_graphics_uniform_destroy(map->bsp_graphics_u_proj);
 		gs_graphics_uniform_destroy(map->bsp_graphics_u_tex);
 		gs_graphics_uniform_destroy(map->bsp_graphics_u_lm);
 		gs_graphics_uniform_destroy(map->bsp_graphics_u_color);
+		gs_graphics_uniform_destroy(map->bsp_graphics_u_layers);
+
+		for (size_t i = 0; i < map->lightmap_textures.count; i++)
+		{
+			gs_graphics_texture_destroy(map->lightmap_textures.data[i]);
+		}
+		gs_graphics_texture_destroy(map->missing_texture);
+		gs_graphics_texture_destroy(map->missing_lm_texture);
+	}
+
+	if (map->valid)
+	{
+		if (map->cluster_draw)
+		{
+			bsp_cluster_draws_free(&map->cluster_draws);
+		}
+		bsp_occlusion_free(&map->occlusion);
+		bsp_vis_free(&map->vis);
+		bsp_trace_free(map);
+		bsp_point_free(map);
 		gs_dyn_array_free(map->bsp_graphics_index_arr);
 		gs_dyn_array_free(map->bsp_graphics_vert_arr);
+		gs_dyn_array_free(map->bsp_graphics_layer_arr);
 
 		for (size_t i = 0; i < gs_dyn_array_size(map->entities); i++)
 		{
@@ -737,44 +1192,57 @@ void bsp_map_free(bsp_map_t *map)
 		}
 		gs_dyn_array_free(map->patches);
 		gs_dyn_array_free(map->render_faces);
-
-		map->patches	  = NULL;
-		map->render_faces = NULL;
+		gs_dyn_array_free(map->pvs_cache.leaves);
+		gs_dyn_array_free(map->pvs_cache.faces);
+		gs_dyn_array_free(map->pvs_cache.nodes);
+		gs_dyn_array_free(map->node_parents);
+		gs_dyn_array_free(map->leaf_parents);
+		bsp_draw_list_free(&map->draw_list);
+		mg_bitset_free(&map->visible_faces);
+		mg_bitset_free(&map->surface_faces);
+		mg_bitset_free(&map->patch_faces);
+
+		map->patches	      = NULL;
+		map->render_faces     = NULL;
+		map->pvs_cache.leaves = NULL;
+		map->pvs_cache.faces  = NULL;
+		map->pvs_cache.nodes  = NULL;
+		map->pvs_cache.valid  = false;
+		map->node_parents     = NULL;
+		map->leaf_parents     = NULL;
 
 		// data contents will be freed by texture manager
 		gs_free(map->texture_assets.data);
-		map->texture_assets.data = NULL;
+		gs_free(map->texture_assets.handles);
+		map->texture_assets.data    = NULL;
+		map->texture_assets.handles = NULL;
 
-		for (size_t i = 0; i < map->lightmap_textures.count; i++)
-		{
-			gs_graphics_texture_destroy(map->lightmap_textures.data[i]);
-		}
 		gs_free(map->lightmap_textures.data);
 		map->lightmap_textures.data = NULL;
-
-		gs_graphics_texture_destroy(map->missing_texture);
-		gs_graphics_texture_destroy(map->missing_lm_texture);
+		bsp_lightmap_atlas_free(&map->lightmap_atlas);
+		bsp_material_table_free(&map->material_table);
 	}
 
 	/*==== File data ====*/
 
 	gs_free(map->entity_lump.ents);
-	gs_free(map->textures.data);
-	gs_free(map->planes.data);
-	gs_free(map->nodes.data);
-	gs_free(map->leaves.data);
-	gs_free(map->leaf_faces.data);
-	gs_free(map->leaf_brushes.data);
-	gs_free(map->models.data);
-	gs_free(map->brushes.data);
-	gs_free(map->brush_sides.data);
-	gs_free(map->vertices.data);
-	gs_free(map->indices.data);
-	gs_free(map->effects.data);
-	gs_free(map->faces.data);
-	gs_free(map->lightmaps.data);
-	gs_free(map->lightvols.data);
-	gs_free(map->visdata.vecs);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_TEXTURES, map->textures.data);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_PLANES, map->planes.data);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_NODES, map->nodes.data);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_LEAVES, map->leaves.data);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_LEAF_FACES, map->leaf_faces.data);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_LEAF_BRUSHES, map->leaf_brushes.data);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_MODELS, map->models.data);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_BRUSHES, map->brushes.data);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_BRUSH_SIDES, map->brush_sides.data);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_VERTICES, map->vertices.data);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_INDICES, map->indices.data);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_EFFECTS, map->effects.data);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_FACES, map->faces.data);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_LIGHTMAPS, map->lightmaps.data);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_LIGHTVOLS, map->lightvols.data);
+	_bsp_map_free_lump(map, BSP_LUMP_TYPE_VISDATA, map->visdata.vecs);
+	unmap_bsp(map);
 	gs_free(map->name);
 
 	map->entity_lump.ents  = NULL;
@@ -799,6 +1267,15 @@ void bsp_map_free(bsp_map_t *map)
 	gs_free(map);
 }
 
+// Lumps pointing into the file mapping are freed by unmapping
+void _bsp_map_free_lump(bsp_map_t *map, bsp_lump_types type, void *data)
+{
+	if ((map->mapped_lumps & (1 << type)) == 0)
+	{
+		gs_free(data);
+	}
+}
+
 int32_t _bsp_find_camera_leaf(bsp_map_t *map, gs_vec3 view_position)
 {
 	int32_t leaf_index = 0;
@@ -821,116 +1298,191 @@ int32_t _bsp_find_camera_leaf(bsp_map_t *map, gs_vec3 view_position)
 	return ~leaf_index;
 }
 
-void _bsp_calculate_visible_faces(bsp_map_t *map, int32_t leaf, gs_camera_t *cam, const gs_vec2 fb)
+void _bsp_update_pvs_cache(bsp_map_t *map, int32_t view_cluster)
 {
-	uint32_t culled_leaves_pvs     = 0;
-	uint32_t culled_leaves_frustum = 0;
-	uint32_t visible_leaves	       = 0;
-	uint32_t visible_patches       = 0;
-	uint32_t visible_faces	       = 0;
-	uint32_t visible_vertices      = 0;
-	uint32_t visible_indices       = 0;
-	int32_t view_cluster	       = map->leaves.data[leaf].cluster;
+	bsp_pvs_cache_t *cache = &map->pvs_cache;
 
-	for (size_t i = 0; i < gs_dyn_array_size(map->render_faces); i++)
+	if (cache->valid && cache->cluster == view_cluster)
 	{
-		map->render_faces[i].visible = false;
+		return;
 	}
 
+	// Visible set is rebuilt after this, use it to dedup
+	mg_bitset_clear(&map->visible_faces);
+
+	gs_dyn_array_clear(cache->leaves);
+	gs_dyn_array_clear(cache->faces);
+	gs_dyn_array_clear(cache->nodes);
+	gs_dyn_array_reserve(cache->nodes, map->nodes.count);
+	gs_dyn_array_head(cache->nodes)->size = map->nodes.count;
+	memset(cache->nodes, 0, map->nodes.count * sizeof(uint8_t));
+
 	for (size_t i = 0; i < map->leaves.count; i++)
 	{
 		bsp_leaf_lump_t lump = map->leaves.data[i];
 
-		// TODO:
-		// Store PVS, don't run every frame if leaf doesn't change
-		if (!_bsp_cluster_visible(map, view_cluster, lump.cluster))
+		if (!bsp_cluster_can_see(&map->vis, view_cluster, lump.cluster))
 		{
-			culled_leaves_pvs++;
 			continue;
 		}
 
-		// Frustum culling using lump.mins and lump.maxs
-		gs_mat4 proj	       = mg_camera_get_view_projection(cam, (s32)fb.x, (s32)fb.y);
-		mg_camera_frustum_t fr = mg_camera_get_frustum_planes(proj, false);
+		gs_dyn_array_push(cache->leaves, (int32_t)i);
 
-		if (!mg_camera_aabb_in_frustum(
-			    fr,
-			    gs_v3(lump.mins[0], lump.mins[1], lump.mins[2]),
-			    gs_v3(lump.maxs[0], lump.maxs[1], lump.maxs[2])))
+		// Mark path to root so traversal can skip
+		// subtrees without any potentially visible leaves.
+		int32_t node = map->leaf_parents[i];
+		while (node >= 0 && !cache->nodes[node])
 		{
-			culled_leaves_frustum++;
-			continue;
+			cache->nodes[node] = true;
+			node		   = map->node_parents[node];
 		}
 
-		visible_leaves++;
-
-		// Add faces in this leaf to visible set
+		// Same face can be in multiple leaves
 		for (size_t j = 0; j < lump.num_leaf_faces; j++)
 		{
-			int32_t idx		   = map->leaf_faces.data[lump.first_leaf_face + j].face;
-			bsp_face_renderable_t face = map->render_faces[idx];
-
-			// Same face can be in multiple leaves
-			if (face.visible)
+			int32_t idx = map->leaf_faces.data[lump.first_leaf_face + j].face;
+			if (!mg_bitset_test_and_set(&map->visible_faces, idx))
 			{
-				continue;
+				gs_dyn_array_push(cache->faces, idx);
 			}
+		}
+	}
 
-			map->render_faces[idx].visible = true;
+	cache->cluster = view_cluster;
+	cache->valid   = true;
+}
 
-			// TODO billboards
-			if (face.type == BSP_FACE_TYPE_BILLBOARD)
-			{
-				continue;
-			}
+void _bsp_calculate_visible_faces(bsp_map_t *map, int32_t leaf, const mg_camera_frustum_t *fr)
+{
+	bsp_pvs_cache_t *cache = &map->pvs_cache;
 
-			if (face.type == BSP_FACE_TYPE_PATCH)
-			{
-				visible_patches++;
-				bsp_patch_t patch = map->patches[face.index];
-				for (size_t k = 0; k < gs_dyn_array_size(patch.quadratic_patches); k++)
-				{
-					visible_vertices += gs_dyn_array_size(patch.quadratic_patches[k].vertices);
-					visible_indices += gs_dyn_array_size(patch.quadratic_patches[k].indices);
-				}
-			}
-			else
-			{
-				visible_faces++;
-				visible_vertices += map->faces.data[face.index].num_vertices;
-				visible_vertices += map->faces.data[face.index].num_indices;
-			}
+	mg_bitset_clear(&map->visible_faces);
+
+	map->stats.visible_leaves	   = 0;
+	map->stats.culled_leaves_occlusion = 0;
+	map->stats.visible_vertices	   = 0;
+	map->stats.visible_indices	   = 0;
+	map->stats.visible_faces	   = 0;
+	map->stats.visible_patches	   = 0;
+	map->stats.node_tests		   = 0;
+	map->stats.leaf_tests		   = 0;
+
+	if (map->nodes.count > 0)
+	{
+		_bsp_cull_node(map, fr, map->leaves.data[leaf].cluster, 0, MG_CAMERA_FRUSTUM_MASK_ALL);
+	}
+
+	_bsp_count_visible_faces(map);
+
+	map->stats.culled_leaves_pvs	 = map->leaves.count - gs_dyn_array_size(cache->leaves);
+	map->stats.culled_leaves_frustum = gs_dyn_array_size(cache->leaves) - map->stats.visible_leaves - map->stats.culled_leaves_occlusion;
+}
+
+void _bsp_cull_node(bsp_map_t *map, const mg_camera_frustum_t *fr, int32_t view_cluster, int32_t node_index, uint8_t plane_mask)
+{
+	// Negative indices are leaves
+	if (node_index < 0)
+	{
+		_bsp_cull_leaf(map, fr, view_cluster, ~node_index, plane_mask);
+		return;
+	}
+
+	// No leaves passing PVS in this subtree
+	if (!map->pvs_cache.nodes[node_index])
+	{
+		return;
+	}
+
+	bsp_node_lump_t node = map->nodes.data[node_index];
+
+	// Planes cleared from the mask were passed by a parent
+	if (plane_mask != 0)
+	{
+		map->stats.node_tests++;
+		if (!mg_camera_aabb_in_frustum_masked(
+			    fr,
+			    gs_v3(node.mins[0], node.mins[1], node.mins[2]),
+			    gs_v3(node.maxs[0], node.maxs[1], node.maxs[2]),
+			    &plane_mask))
+		{
+			return;
 		}
 	}
 
-	map->stats.culled_leaves_pvs	 = culled_leaves_pvs;
-	map->stats.culled_leaves_frustum = culled_leaves_frustum;
-	map->stats.visible_leaves	 = visible_leaves;
-	map->stats.visible_vertices	 = visible_vertices;
-	map->stats.visible_indices	 = visible_indices;
-	map->stats.visible_faces	 = visible_faces;
-	map->stats.visible_patches	 = visible_patches;
-	map->stats.current_leaf		 = leaf;
+	_bsp_cull_node(map, fr, view_cluster, node.children[0], plane_mask);
+	_bsp_cull_node(map, fr, view_cluster, node.children[1], plane_mask);
 }
 
-bool32_t _bsp_cluster_visible(bsp_map_t *map, int32_t view_cluster, int32_t test_cluster)
+void _bsp_cull_leaf(bsp_map_t *map, const mg_camera_frustum_t *fr, int32_t view_cluster, int32_t leaf_index, uint8_t plane_mask)
 {
-	if (test_cluster < 0)
+	bsp_leaf_lump_t lump = map->leaves.data[leaf_index];
+
+	if (!bsp_cluster_can_see(&map->vis, view_cluster, lump.cluster))
 	{
-		// Outside the map or invalid
-		return false;
+		return;
 	}
 
-	if (map->visdata.num_vecs == 0 || view_cluster < 0)
+	if (plane_mask != 0)
 	{
-		return true;
+		map->stats.leaf_tests++;
+		if (!mg_camera_aabb_in_frustum_masked(
+			    fr,
+			    gs_v3(lump.mins[0], lump.mins[1], lump.mins[2]),
+			    gs_v3(lump.maxs[0], lump.maxs[1], lump.maxs[2]),
+			    &plane_mask))
+		{
+			return;
+		}
 	}
 
-	// int32_t idx = test_cluster * map->visdata.size_vecs + view_cluster / 8;
-	// return (map->visdata.vecs[idx] & (1 << (view_cluster % 8))) != 0;
+	// Behind occluders drawn this frame
+	gs_vec3 mins = gs_v3(lump.mins[0], lump.mins[1], lump.mins[2]);
+	gs_vec3 maxs = gs_v3(lump.maxs[0], lump.maxs[1], lump.maxs[2]);
+	if (lump.num_leaf_faces > 0 && !bsp_occlusion_aabb_visible(&map->occlusion, mins, maxs))
+	{
+		map->stats.culled_leaves_occlusion++;
+		return;
+	}
+
+	map->stats.visible_leaves++;
+
+	// Add faces in this leaf to visible set
+	for (size_t j = 0; j < lump.num_leaf_faces; j++)
+	{
+		mg_bitset_set(&map->visible_faces, map->leaf_faces.data[lump.first_leaf_face + j].face);
+	}
+}
 
-	int32_t idx = test_cluster * map->visdata.size_vecs + (view_cluster >> 3);
-	return (map->visdata.vecs[idx] & (1 << (view_cluster & 7))) != 0;
+void _bsp_count_visible_faces(bsp_map_t *map)
+{
+	map->stats.visible_faces   = mg_bitset_count_and(&map->visible_faces, &map->surface_faces);
+	map->stats.visible_patches = mg_bitset_count_and(&map->visible_faces, &map->patch_faces);
+
+	for (int32_t i = mg_bitset_next(&map->visible_faces, 0); i >= 0; i = mg_bitset_next(&map->visible_faces, i + 1))
+	{
+		bsp_face_renderable_t face = map->render_faces[i];
+
+		// TODO billboards
+		if (face.type == BSP_FACE_TYPE_BILLBOARD)
+		{
+			continue;
+		}
+
+		if (face.type == BSP_FACE_TYPE_PATCH)
+		{
+			bsp_patch_t patch = map->patches[face.index];
+			for (size_t k = 0; k < gs_dyn_array_size(patch.quadratic_patches); k++)
+			{
+				map->stats.visible_vertices += gs_dyn_array_size(patch.quadratic_patches[k].vertices);
+				map->stats.visible_indices += gs_dyn_array_size(patch.quadratic_patches[k].indices);
+			}
+		}
+		else
+		{
+			map->stats.visible_vertices += map->faces.data[face.index].num_vertices;
+			map->stats.visible_indices += map->faces.data[face.index].num_indices;
+		}
+	}
 }
 
 bsp_lightvol_lump_t bsp_get_lightvol(bsp_map_t *map, gs_vec3 position, gs_vec3 *center)
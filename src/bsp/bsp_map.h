@@ -14,27 +14,54 @@
 #include <gs/util/gs_idraw.h>
 
 #include "../graphics/types.h"
+#include "../util/camera.h"
 #include "../util/math.h"
 #include "../util/string.h"
+#include "bsp_cluster_draw.h"
+#include "bsp_draw_list.h"
 #include "bsp_entity.h"
+#include "bsp_lightmap_atlas.h"
+#include "bsp_material.h"
+#include "bsp_occlusion.h"
 #include "bsp_patch.h"
+#include "bsp_point.h"
+#include "bsp_trace.h"
 #include "bsp_types.h"
+#include "bsp_vis.h"
 
 void bsp_map_init(bsp_map_t *map);
+void bsp_map_init_data(bsp_map_t *map, uint32_t num_threads);
+void bsp_map_init_textures(bsp_map_t *map, bool32_t load);
+void bsp_map_init_buffers(bsp_map_t *map);
+void bsp_map_init_graphics(bsp_map_t *map);
+void bsp_map_rebuild_materials(bsp_map_t *map);
+void _bsp_create_render_faces(bsp_map_t *map, uint32_t num_threads);
 void _bsp_load_entities(bsp_map_t *map);
-void _bsp_load_textures(bsp_map_t *map);
+void _bsp_load_textures(bsp_map_t *map, bool32_t load);
+void _bsp_build_lightmaps(bsp_map_t *map);
 void _bsp_load_lightmaps(bsp_map_t *map);
 void _bsp_load_lightvols(bsp_map_t *map);
+void _bsp_load_materials(bsp_map_t *map);
 void _bsp_create_patch(bsp_map_t *map, bsp_face_lump_t face);
+void _bsp_tesselate_patches_job(void *data, uint32_t start, uint32_t end, uint32_t thread);
+void _bsp_map_build_arrays(bsp_map_t *map);
+void _bsp_map_build_layers(bsp_map_t *map);
+void _bsp_map_build_cluster_draws(bsp_map_t *map);
 void _bsp_map_create_buffers(bsp_map_t *map);
+float _bsp_get_texture_layer(bsp_map_t *map, int32_t texture);
+void _bsp_map_find_parents(bsp_map_t *map);
 void bsp_map_update(bsp_map_t *map, gs_camera_t *cam, const gs_vec2 fb);
 void bsp_map_render_immediate(bsp_map_t *map, gs_immediate_draw_t *gsi, gs_camera_t *cam);
 void bsp_map_render(bsp_map_t *map, gs_camera_t *cam, gs_handle(gs_graphics_renderpass_t) rp, gs_command_buffer_t *cb, const gs_vec2 fb);
 void bsp_map_find_spawn_point(bsp_map_t *map, gs_vec3 *position, float32_t *yaw);
 void bsp_map_free(bsp_map_t *map);
+void _bsp_map_free_lump(bsp_map_t *map, bsp_lump_types type, void *data);
 int32_t _bsp_find_camera_leaf(bsp_map_t *map, gs_vec3 view_position);
-void _bsp_calculate_visible_faces(bsp_map_t *map, int32_t leaf, gs_camera_t *cam, const gs_vec2 fb);
-bool32_t _bsp_cluster_visible(bsp_map_t *map, int32_t view_cluster, int32_t test_cluster);
+void _bsp_update_pvs_cache(bsp_map_t *map, int32_t view_cluster);
+void _bsp_calculate_visible_faces(bsp_map_t *map, int32_t leaf, const mg_camera_frustum_t *fr);
+void _bsp_cull_node(bsp_map_t *map, const mg_camera_frustum_t *fr, int32_t view_cluster, int32_t node_index, uint8_t plane_mask);
+void _bsp_cull_leaf(bsp_map_t *map, const mg_camera_frustum_t *fr, int32_t view_cluster, int32_t leaf_index, uint8_t plane_mask);
+void _bsp_count_visible_faces(bsp_map_t *map);
 bsp_lightvol_lump_t bsp_get_lightvol(bsp_map_t *map, gs_vec3 position, gs_vec3 *center);
 mg_renderer_light_t bsp_sample_lightvol(bsp_map_t *map, gs_vec3 position);
 
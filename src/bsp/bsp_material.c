@@ -0,0 +1,198 @@
+/*================================================================
+	* bsp/bsp_material.c
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Groups same size BSP textures into layered textures
+	so faces with different textures can share a draw.
+=================================================================*/
+
+#include "bsp_material.h"
+#include "../game/console.h"
+#include "../graphics/texture_manager.h"
+
+// CPU only grouping, doesn't touch graphics state.
+// Textures of the same size are stacked into arrays of at most
+// max_height / height layers, sizes with one texture are left as singletons.
+void bsp_material_table_build(bsp_material_table_t *table, gs_asset_texture_t **textures, uint32_t count, uint32_t max_height)
+{
+	*table = (bsp_material_table_t){
+		.num_textures  = count,
+		.texture_array = gs_malloc(count * sizeof(int32_t)),
+		.texture_layer = gs_malloc(count * sizeof(int32_t)),
+		.texture_key   = gs_malloc(count * sizeof(int32_t)),
+		.arrays	       = gs_dyn_array_new(bsp_material_array_t),
+	};
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		table->texture_array[i] = -1;
+		table->texture_layer[i] = 0;
+		table->texture_key[i]	= i;
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (textures[i] == NULL || textures[i]->desc.width == 0 || textures[i]->desc.height == 0)
+		{
+			table->num_missing++;
+			continue;
+		}
+
+		// Same asset can be referenced by multiple texture lumps
+		bool32_t duplicate = false;
+		for (uint32_t j = 0; j < i; j++)
+		{
+			if (textures[j] == textures[i])
+			{
+				table->texture_array[i] = table->texture_array[j];
+				table->texture_layer[i] = table->texture_layer[j];
+				table->texture_key[i]	= table->texture_key[j];
+				duplicate		= true;
+				break;
+			}
+		}
+		if (duplicate) continue;
+
+		uint32_t width	    = textures[i]->desc.width;
+		uint32_t height	    = textures[i]->desc.height;
+		uint32_t max_layers = gs_max(max_height / height, 1);
+
+		// Find an array of the same size with room left
+		int32_t array_idx = -1;
+		for (size_t j = 0; j < gs_dyn_array_size(table->arrays); j++)
+		{
+			bsp_material_array_t *array = &table->arrays[j];
+			if (array->width == width && array->height == height && gs_dyn_array_size(array->textures) < max_layers)
+			{
+				array_idx = j;
+				break;
+			}
+		}
+
+		if (array_idx < 0)
+		{
+			bsp_material_array_t array = {
+				.width	  = width,
+				.height	  = height,
+				.textures = gs_dyn_array_new(int32_t),
+				.hndl	  = gs_handle_invalid(gs_graphics_texture_t),
+			};
+			gs_dyn_array_push(table->arrays, array);
+			array_idx = gs_dyn_array_size(table->arrays) - 1;
+		}
+
+		bsp_material_array_t *array = &table->arrays[array_idx];
+		table->texture_array[i]	    = array_idx;
+		table->texture_layer[i]	    = gs_dyn_array_size(array->textures);
+		table->texture_key[i]	    = gs_dyn_array_size(array->textures) == 0 ? i : array->textures[0];
+		gs_dyn_array_push(array->textures, (int32_t)i);
+	}
+
+	// Arrays of one are just the texture itself
+	for (uint32_t i = 0; i < count; i++)
+	{
+		int32_t array_idx = table->texture_array[i];
+		if (array_idx >= 0 && gs_dyn_array_size(table->arrays[array_idx].textures) == 1)
+		{
+			table->texture_array[i] = -1;
+			table->texture_key[i]	= i;
+			if (table->arrays[array_idx].textures[0] == i)
+			{
+				table->num_singletons++;
+			}
+		}
+	}
+}
+
+// Upload each multi layer array as one texture with layers stacked
+// vertically, from the pixels the texture manager kept when decoding.
+// Uses the current texture filter, call again to rebuild after it changes.
+// Layers have no gutter, bsp_layered_fs keeps filter taps and mips inside them.
+void bsp_material_table_create_textures(bsp_material_table_t *table, bsp_map_t *map)
+{
+	for (size_t i = 0; i < gs_dyn_array_size(table->arrays); i++)
+	{
+		bsp_material_array_t *array = &table->arrays[i];
+		uint32_t num_layers	    = gs_dyn_array_size(array->textures);
+		if (num_layers < 2)
+		{
+			continue;
+		}
+
+		if (gs_handle_is_valid(array->hndl))
+		{
+			gs_graphics_texture_destroy(array->hndl);
+		}
+
+		size_t layer_size = array->width * array->height * 4;
+		uint8_t *pixels	  = gs_calloc(layer_size * num_layers, sizeof(uint8_t));
+
+		for (uint32_t j = 0; j < num_layers; j++)
+		{
+			gs_asset_texture_t *asset = map->texture_assets.data[array->textures[j]];
+			const void *data	  = asset != NULL ? mg_texture_manager_get_pixels(map->texture_assets.handles[array->textures[j]]) : NULL;
+			if (data != NULL && asset->desc.width == array->width && asset->desc.height == array->height)
+			{
+				memcpy(pixels + layer_size * j, data, layer_size);
+			}
+		}
+
+		array->hndl = gs_graphics_texture_create(
+			&(gs_graphics_texture_desc_t){
+				.type	    = GS_GRAPHICS_TEXTURE_2D,
+				.width	    = array->width,
+				.height	    = array->height * num_layers,
+				.format	    = GS_GRAPHICS_TEXTURE_FORMAT_RGBA8,
+				.wrap_s	    = GS_GRAPHICS_TEXTURE_WRAP_REPEAT,
+				.wrap_t	    = GS_GRAPHICS_TEXTURE_WRAP_REPEAT,
+				.min_filter = g_texture_manager->tex_filter,
+				.mag_filter = g_texture_manager->tex_filter,
+				.mip_filter = g_texture_manager->mip_filter,
+				.num_mips   = g_texture_manager->num_mips,
+				.data	    = pixels});
+
+		gs_free(pixels);
+	}
+}
+
+void bsp_material_table_print(const bsp_material_table_t *table)
+{
+	uint32_t num_arrays  = 0;
+	uint32_t num_layered = 0;
+
+	mg_println("bsp materials: %u textures", table->num_textures);
+	for (size_t i = 0; i < gs_dyn_array_size(table->arrays); i++)
+	{
+		uint32_t num_layers = gs_dyn_array_size(table->arrays[i].textures);
+		if (num_layers < 2) continue;
+
+		mg_println("  array %zu: %ux%u, %u layers", i, table->arrays[i].width, table->arrays[i].height, num_layers);
+		num_arrays++;
+		num_layered += num_layers;
+	}
+	mg_println("  arrays: %u, layers: %u, singletons: %u, missing: %u", num_arrays, num_layered, table->num_singletons, table->num_missing);
+}
+
+void bsp_material_table_free(bsp_material_table_t *table)
+{
+	for (size_t i = 0; i < gs_dyn_array_size(table->arrays); i++)
+	{
+		if (gs_handle_is_valid(table->arrays[i].hndl))
+		{
+			gs_graphics_texture_destroy(table->arrays[i].hndl);
+		}
+		gs_dyn_array_free(table->arrays[i].textures);
+	}
+	gs_dyn_array_free(table->arrays);
+
+	gs_free(table->texture_array);
+	gs_free(table->texture_layer);
+	gs_free(table->texture_key);
+
+	table->arrays	     = NULL;
+	table->texture_array = NULL;
+	table->texture_layer = NULL;
+	table->texture_key   = NULL;
+}
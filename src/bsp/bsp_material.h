@@ -0,0 +1,25 @@
+/*================================================================
+	* bsp/bsp_material.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Groups same size BSP textures into layered textures
+	so faces with different textures can share a draw.
+=================================================================*/
+
+#ifndef BSP_MATERIAL_H
+#define BSP_MATERIAL_H
+
+#include "bsp_types.h"
+
+// Max height of a layered texture,
+// limits how many layers fit in one array.
+#define BSP_MATERIAL_MAX_ARRAY_HEIGHT 4096
+
+void bsp_material_table_build(bsp_material_table_t *table, gs_asset_texture_t **textures, uint32_t count, uint32_t max_height);
+void bsp_material_table_create_textures(bsp_material_table_t *table, bsp_map_t *map);
+void bsp_material_table_print(const bsp_material_table_t *table);
+void bsp_material_table_free(bsp_material_table_t *table);
+
+#endif // BSP_MATERIAL_H
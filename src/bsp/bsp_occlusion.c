@@ -0,0 +1,367 @@
+/*================================================================
+	* bsp/bsp_occlusion.c
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	CPU occlusion culling for BSP leaves.
+	Large faces are rasterized into a small depth buffer,
+	leaf bounds are tested against it.
+=================================================================*/
+
+#include <float.h>
+
+#include "bsp_occlusion.h"
+
+static inline gs_vec4 _bsp_occlusion_to_clip(const gs_mat4 *m, const gs_vec3 p)
+{
+	const float *e = m->elements;
+	return gs_v4(
+		e[0] * p.x + e[4] * p.y + e[8] * p.z + e[12],
+		e[1] * p.x + e[5] * p.y + e[9] * p.z + e[13],
+		e[2] * p.x + e[6] * p.y + e[10] * p.z + e[14],
+		e[3] * p.x + e[7] * p.y + e[11] * p.z + e[15]);
+}
+
+void bsp_occlusion_init(bsp_occlusion_t *occ, uint32_t width, uint32_t height)
+{
+	// SIMD paths work on 4 pixels of a row at a time
+	width = (width + 3) & ~3;
+
+	*occ = (bsp_occlusion_t){
+		.width	= width,
+		.height = height,
+		.depth	= gs_malloc(width * height * sizeof(float)),
+	};
+}
+
+// Polygon faces with solid, opaque textures and enough area.
+void bsp_occlusion_find_occluders(bsp_occlusion_t *occ, bsp_map_t *map, float min_area)
+{
+	uint32_t num_faces = gs_dyn_array_size(map->render_faces);
+	occ->occluders	   = gs_calloc(gs_max(num_faces, 1), sizeof(uint8_t));
+	occ->num_occluders = 0;
+
+	for (size_t i = 0; i < num_faces; i++)
+	{
+		if (map->render_faces[i].type != BSP_FACE_TYPE_POLYGON) continue;
+
+		bsp_face_lump_t face = map->faces.data[map->render_faces[i].index];
+		if (face.texture < 0 || face.texture >= map->textures.count) continue;
+
+		bsp_texture_lump_t texture = map->textures.data[face.texture];
+		if (!(texture.contents & BSP_CONTENT_CONTENTS_SOLID)
+		    || (texture.contents & BSP_CONTENT_CONTENTS_TRANSLUCENT)
+		    || (texture.flags & BSP_SURFACE_NODRAW))
+		{
+			continue;
+		}
+
+		float area = 0;
+		for (size_t j = 0; j + 2 < face.num_indices; j += 3)
+		{
+			gs_vec3 a = map->vertices.data[face.first_vertex + map->indices.data[face.first_index + j + 0].offset].position;
+			gs_vec3 b = map->vertices.data[face.first_vertex + map->indices.data[face.first_index + j + 1].offset].position;
+			gs_vec3 c = map->vertices.data[face.first_vertex + map->indices.data[face.first_index + j + 2].offset].position;
+			area += gs_vec3_len(gs_vec3_cross(gs_vec3_sub(b, a), gs_vec3_sub(c, a))) * 0.5f;
+		}
+
+		if (area >= min_area)
+		{
+			occ->occluders[i] = true;
+			occ->num_occluders++;
+		}
+	}
+}
+
+void bsp_occlusion_begin(bsp_occlusion_t *occ, gs_mat4 view_projection)
+{
+	occ->view_projection = view_projection;
+	occ->valid	     = true;
+
+	for (size_t i = 0; i < occ->width * occ->height; i++)
+	{
+		occ->depth[i] = FLT_MAX;
+	}
+}
+
+// Clips against the near plane, splitting into up to two triangles.
+void bsp_occlusion_draw_triangle(bsp_occlusion_t *occ, gs_vec3 a, gs_vec3 b, gs_vec3 c)
+{
+	gs_vec4 in[3] = {
+		_bsp_occlusion_to_clip(&occ->view_projection, a),
+		_bsp_occlusion_to_clip(&occ->view_projection, b),
+		_bsp_occlusion_to_clip(&occ->view_projection, c),
+	};
+	gs_vec4 out[4];
+	uint32_t count = 0;
+
+	for (size_t i = 0; i < 3; i++)
+	{
+		gs_vec4 p = in[i];
+		gs_vec4 q = in[(i + 1) % 3];
+		float dp  = p.z + p.w;
+		float dq  = q.z + q.w;
+
+		if (dp >= 0)
+		{
+			out[count++] = p;
+		}
+		if ((dp >= 0) != (dq >= 0))
+		{
+			float t	     = dp / (dp - dq);
+			out[count++] = gs_v4(
+				p.x + (q.x - p.x) * t,
+				p.y + (q.y - p.y) * t,
+				p.z + (q.z - p.z) * t,
+				p.w + (q.w - p.w) * t);
+		}
+	}
+
+	if (count < 3)
+	{
+		return;
+	}
+
+	// To pixels, y up
+	float screen[4][3];
+	for (size_t i = 0; i < count; i++)
+	{
+		if (out[i].w <= FLT_EPSILON)
+		{
+			return;
+		}
+
+		float inv_w  = 1.0f / out[i].w;
+		screen[i][0] = (out[i].x * inv_w * 0.5f + 0.5f) * occ->width;
+		screen[i][1] = (out[i].y * inv_w * 0.5f + 0.5f) * occ->height;
+		screen[i][2] = out[i].z * inv_w;
+	}
+
+	_bsp_occlusion_raster(occ, screen[0], screen[1], screen[2]);
+	if (count == 4)
+	{
+		_bsp_occlusion_raster(occ, screen[0], screen[2], screen[3]);
+	}
+}
+
+// Occluder faces in the current PVS set, returns triangles drawn.
+uint32_t bsp_occlusion_draw_occluders(bsp_occlusion_t *occ, bsp_map_t *map)
+{
+	uint32_t triangles = 0;
+
+	for (size_t i = 0; i < gs_dyn_array_size(map->pvs_cache.faces); i++)
+	{
+		int32_t idx = map->pvs_cache.faces[i];
+		if (!occ->occluders[idx]) continue;
+
+		bsp_face_lump_t face = map->faces.data[map->render_faces[idx].index];
+		for (size_t j = 0; j + 2 < face.num_indices; j += 3)
+		{
+			bsp_occlusion_draw_triangle(
+				occ,
+				map->vertices.data[face.first_vertex + map->indices.data[face.first_index + j + 0].offset].position,
+				map->vertices.data[face.first_vertex + map->indices.data[face.first_index + j + 1].offset].position,
+				map->vertices.data[face.first_vertex + map->indices.data[face.first_index + j + 2].offset].position);
+			triangles++;
+		}
+	}
+
+	return triangles;
+}
+
+// Conservative where it can't tell: bounds crossing the near plane
+// or outside the buffer are visible.
+bool32_t bsp_occlusion_aabb_visible(const bsp_occlusion_t *occ, gs_vec3 mins, gs_vec3 maxs)
+{
+	if (!occ->valid)
+	{
+		return true;
+	}
+
+	float min_x = FLT_MAX;
+	float min_y = FLT_MAX;
+	float min_z = FLT_MAX;
+	float max_x = -FLT_MAX;
+	float max_y = -FLT_MAX;
+
+	for (size_t i = 0; i < 8; i++)
+	{
+		gs_vec3 corner = gs_v3(
+			i & 1 ? maxs.x : mins.x,
+			i & 2 ? maxs.y : mins.y,
+			i & 4 ? maxs.z : mins.z);
+		gs_vec4 clip = _bsp_occlusion_to_clip(&occ->view_projection, corner);
+
+		if (clip.w <= FLT_EPSILON || clip.z + clip.w < 0)
+		{
+			return true;
+		}
+
+		float inv_w = 1.0f / clip.w;
+		float x	    = (clip.x * inv_w * 0.5f + 0.5f) * occ->width;
+		float y	    = (clip.y * inv_w * 0.5f + 0.5f) * occ->height;
+		min_x	    = gs_min(min_x, x);
+		min_y	    = gs_min(min_y, y);
+		max_x	    = gs_max(max_x, x);
+		max_y	    = gs_max(max_y, y);
+		min_z	    = gs_min(min_z, clip.z * inv_w);
+	}
+
+	int32_t x0 = gs_max((int32_t)floorf(min_x), 0);
+	int32_t y0 = gs_max((int32_t)floorf(min_y), 0);
+	int32_t x1 = gs_min((int32_t)floorf(max_x), (int32_t)occ->width - 1);
+	int32_t y1 = gs_min((int32_t)floorf(max_y), (int32_t)occ->height - 1);
+	if (x0 > x1 || y0 > y1)
+	{
+		return true;
+	}
+
+	// Visible if any pixel has nothing nearer than the bounds
+	float z = min_z - BSP_OCCLUSION_DEPTH_BIAS;
+
+#if MG_CAMERA_SIMD_WIDTH >= 4
+	__m128 lane  = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	__m128 first = _mm_set1_ps((float)x0);
+	__m128 last  = _mm_set1_ps((float)x1);
+	__m128 depth = _mm_set1_ps(z);
+
+	for (int32_t y = y0; y <= y1; y++)
+	{
+		const float *row = occ->depth + y * occ->width;
+		for (int32_t x = x0 & ~3; x <= x1; x += 4)
+		{
+			__m128 px     = _mm_add_ps(_mm_set1_ps((float)x), lane);
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(px, first), _mm_cmple_ps(px, last));
+			__m128 open   = _mm_cmpge_ps(_mm_loadu_ps(row + x), depth);
+			if (_mm_movemask_ps(_mm_and_ps(inside, open)))
+			{
+				return true;
+			}
+		}
+	}
+#else
+	for (int32_t y = y0; y <= y1; y++)
+	{
+		const float *row = occ->depth + y * occ->width;
+		for (int32_t x = x0; x <= x1; x++)
+		{
+			if (row[x] >= z)
+			{
+				return true;
+			}
+		}
+	}
+#endif
+
+	return false;
+}
+
+void bsp_occlusion_free(bsp_occlusion_t *occ)
+{
+	gs_free(occ->depth);
+	gs_free(occ->occluders);
+	occ->depth	   = NULL;
+	occ->occluders	   = NULL;
+	occ->num_occluders = 0;
+	occ->valid	   = false;
+}
+
+// Screen space triangle, vertices are x, y in pixels and NDC depth.
+// Writes nearest depth to pixels whose centers are covered.
+void _bsp_occlusion_raster(bsp_occlusion_t *occ, const float *v0, const float *v1, const float *v2)
+{
+	float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+	if (fabsf(area) < FLT_EPSILON)
+	{
+		return;
+	}
+
+	// Occluders are two sided, make winding counter clockwise
+	if (area < 0)
+	{
+		const float *tmp = v1;
+		v1		 = v2;
+		v2		 = tmp;
+		area		 = -area;
+	}
+
+	int32_t x0 = gs_max((int32_t)floorf(gs_min(v0[0], gs_min(v1[0], v2[0]))), 0);
+	int32_t y0 = gs_max((int32_t)floorf(gs_min(v0[1], gs_min(v1[1], v2[1]))), 0);
+	int32_t x1 = gs_min((int32_t)ceilf(gs_max(v0[0], gs_max(v1[0], v2[0]))), (int32_t)occ->width - 1);
+	int32_t y1 = gs_min((int32_t)ceilf(gs_max(v0[1], gs_max(v1[1], v2[1]))), (int32_t)occ->height - 1);
+	if (x0 > x1 || y0 > y1)
+	{
+		return;
+	}
+
+	// Edge functions as a * x + b * y + c, inside when all >= 0.
+	// Edge opposite of each vertex, so they double as barycentrics.
+	float a0 = v1[1] - v2[1];
+	float b0 = v2[0] - v1[0];
+	float c0 = -(a0 * v1[0] + b0 * v1[1]);
+	float a1 = v2[1] - v0[1];
+	float b1 = v0[0] - v2[0];
+	float c1 = -(a1 * v2[0] + b1 * v2[1]);
+	float a2 = v0[1] - v1[1];
+	float b2 = v1[0] - v0[0];
+	float c2 = -(a2 * v0[0] + b2 * v0[1]);
+
+	// Depth is linear in screen space
+	float inv_area = 1.0f / area;
+	float za       = (a0 * v0[2] + a1 * v1[2] + a2 * v2[2]) * inv_area;
+	float zb       = (b0 * v0[2] + b1 * v1[2] + b2 * v2[2]) * inv_area;
+	float zc       = (c0 * v0[2] + c1 * v1[2] + c2 * v2[2]) * inv_area;
+
+#if MG_CAMERA_SIMD_WIDTH >= 4
+	__m128 lane = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	__m128 zero = _mm_setzero_ps();
+	__m128 ea0  = _mm_set1_ps(a0);
+	__m128 ea1  = _mm_set1_ps(a1);
+	__m128 ea2  = _mm_set1_ps(a2);
+	__m128 eza  = _mm_set1_ps(za);
+
+	for (int32_t y = y0; y <= y1; y++)
+	{
+		float py   = y + 0.5f;
+		float *row = occ->depth + y * occ->width;
+		__m128 eb0 = _mm_set1_ps(b0 * py + c0);
+		__m128 eb1 = _mm_set1_ps(b1 * py + c1);
+		__m128 eb2 = _mm_set1_ps(b2 * py + c2);
+		__m128 ezb = _mm_set1_ps(zb * py + zc);
+
+		// Row is padded to a multiple of 4
+		for (int32_t x = x0 & ~3; x <= x1; x += 4)
+		{
+			__m128 px     = _mm_add_ps(_mm_set1_ps((float)x), lane);
+			__m128 e0     = _mm_add_ps(_mm_mul_ps(ea0, px), eb0);
+			__m128 e1     = _mm_add_ps(_mm_mul_ps(ea1, px), eb1);
+			__m128 e2     = _mm_add_ps(_mm_mul_ps(ea2, px), eb2);
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+			if (!_mm_movemask_ps(inside)) continue;
+
+			__m128 z       = _mm_add_ps(_mm_mul_ps(eza, px), ezb);
+			__m128 old     = _mm_loadu_ps(row + x);
+			__m128 nearest = _mm_min_ps(old, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+		}
+	}
+#else
+	for (int32_t y = y0; y <= y1; y++)
+	{
+		float py   = y + 0.5f;
+		float *row = occ->depth + y * occ->width;
+		for (int32_t x = x0; x <= x1; x++)
+		{
+			float px = x + 0.5f;
+			if (a0 * px + b0 * py + c0 < 0 || a1 * px + b1 * py + c1 < 0 || a2 * px + b2 * py + c2 < 0)
+			{
+				continue;
+			}
+
+			float z = za * px + zb * py + zc;
+			row[x]	= gs_min(row[x], z);
+		}
+	}
+#endif
+}
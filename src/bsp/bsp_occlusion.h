@@ -0,0 +1,37 @@
+/*================================================================
+	* bsp/bsp_occlusion.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	CPU occlusion culling for BSP leaves.
+	Large faces are rasterized into a small depth buffer,
+	leaf bounds are tested against it.
+=================================================================*/
+
+#ifndef BSP_OCCLUSION_H
+#define BSP_OCCLUSION_H
+
+#include "../util/camera.h"
+#include "bsp_types.h"
+
+// Depth buffer resolution, width is rounded up to SIMD width
+#define BSP_OCCLUSION_WIDTH  256
+#define BSP_OCCLUSION_HEIGHT 128
+
+// Faces smaller than this (units squared) aren't drawn as occluders
+#define BSP_OCCLUSION_MIN_AREA 4096.0f
+
+// Leaves must be behind occluders by this much NDC depth
+#define BSP_OCCLUSION_DEPTH_BIAS 0.00001f
+
+void bsp_occlusion_init(bsp_occlusion_t *occ, uint32_t width, uint32_t height);
+void bsp_occlusion_find_occluders(bsp_occlusion_t *occ, bsp_map_t *map, float min_area);
+void bsp_occlusion_begin(bsp_occlusion_t *occ, gs_mat4 view_projection);
+void bsp_occlusion_draw_triangle(bsp_occlusion_t *occ, gs_vec3 a, gs_vec3 b, gs_vec3 c);
+uint32_t bsp_occlusion_draw_occluders(bsp_occlusion_t *occ, bsp_map_t *map);
+bool32_t bsp_occlusion_aabb_visible(const bsp_occlusion_t *occ, gs_vec3 mins, gs_vec3 maxs);
+void bsp_occlusion_free(bsp_occlusion_t *occ);
+void _bsp_occlusion_raster(bsp_occlusion_t *occ, const float *v0, const float *v1, const float *v2);
+
+#endif // BSP_OCCLUSION_H
@@ -79,6 +79,25 @@ void bsp_quadratic_patch_tesselate(bsp_quadratic_patch_t *patch)
 	}
 }
 
+// Get the 9 vertices used as control points for quadratic patch x, y of a patch face
+void bsp_quadratic_patch_control_points(const bsp_vert_lump_t *vertices, bsp_face_lump_t face, uint32_t x, uint32_t y, bsp_vert_lump_t *control_points)
+{
+	int32_t width = face.size[0];
+
+	for (size_t row = 0; row < 3; row++)
+	{
+		for (size_t col = 0; col < 3; col++)
+		{
+			uint32_t control_point_idx = row * 3 + col;
+			// I understood this index when I wrote it but didn't add comments...
+			// Let's just hope I never have to debug this.
+			//                                  offset              ???                       ???
+			uint32_t vertex_idx		  = face.first_vertex + (2 * y * width + 2 * x) + (row * width + col);
+			control_points[control_point_idx] = vertices[vertex_idx];
+		}
+	}
+}
+
 void bsp_quadratic_patch_free(bsp_quadratic_patch_t *patch)
 {
 	gs_dyn_array_free(patch->vertices);
@@ -12,6 +12,11 @@
 
 #include "bsp_types.h"
 
+#define BSP_PATCH_RENDER_TESSELATION	   8
+#define BSP_PATCH_COLLISION_MAX_TESSELATION 8
+#define BSP_PATCH_COLLISION_THICKNESS	   2.0f // facet depth behind the surface
+#define BSP_PATCH_JOB_CHUNK		   4	// patches taken by a thread at a time
+
 // Helpers for vertex lump math
 static inline bsp_vert_lump_t bsp_vert_lump_mul(bsp_vert_lump_t lump, float32_t mul)
 {
@@ -36,6 +41,7 @@ static inline bsp_vert_lump_t bsp_vert_lump_add(bsp_vert_lump_t a, bsp_vert_lump
 }
 
 void bsp_quadratic_patch_tesselate(bsp_quadratic_patch_t *patch);
+void bsp_quadratic_patch_control_points(const bsp_vert_lump_t *vertices, bsp_face_lump_t face, uint32_t x, uint32_t y, bsp_vert_lump_t *control_points);
 void bsp_quadratic_patch_free(bsp_quadratic_patch_t *patch);
 void bsp_patch_free(bsp_patch_t *patch);
 
@@ -0,0 +1,218 @@
+/*================================================================
+	* bsp/bsp_point.c
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Leaf and contents lookups for points, starting from
+	the leaf the point was in last time.
+=================================================================*/
+
+#include "bsp_point.h"
+#include "../game/console.h"
+#include "../game/job_manager.h"
+#include "../util/math.h"
+#include "bsp_trace.h"
+
+typedef struct bsp_point_batch_t
+{
+	bsp_map_t *map;
+	const gs_vec3 *points;
+	int32_t *leaves;
+} bsp_point_batch_t;
+
+void bsp_point_init(bsp_map_t *map)
+{
+	bsp_point_leaves_t *pl = &map->point_leaves;
+	pl->leaves	       = gs_calloc(gs_max(map->leaves.count, 1), sizeof(bsp_point_leaf_t));
+	pl->planes	       = gs_dyn_array_new(int32_t);
+
+	if (map->nodes.count > 0)
+	{
+		int32_t path[BSP_TRACE_STACK_SIZE];
+		_bsp_point_build(map, 0, path, 0);
+	}
+}
+
+void bsp_point_free(bsp_map_t *map)
+{
+	gs_free(map->point_leaves.leaves);
+	gs_dyn_array_free(map->point_leaves.planes);
+	map->point_leaves = (bsp_point_leaves_t){0};
+}
+
+// Leaf containing point. If cache is not NULL,
+// it's checked first and set to the result.
+// Any leaf index works as a cache, 0 included.
+int32_t bsp_point_leaf(bsp_map_t *map, gs_vec3 point, int32_t *cache)
+{
+	if (cache != NULL && *cache >= 0 && *cache < map->leaves.count && _bsp_point_in_leaf(map, *cache, point))
+	{
+		return *cache;
+	}
+
+	int32_t leaf = _bsp_point_descend(map, point);
+	if (cache != NULL)
+	{
+		*cache = leaf;
+	}
+
+	return leaf;
+}
+
+// Contents of brushes containing point, patches are not included
+int32_t bsp_point_contents(bsp_map_t *map, gs_vec3 point, int32_t *cache)
+{
+	return _bsp_point_leaf_contents(map, bsp_point_leaf(map, point, cache), point);
+}
+
+// Looks up count points split over up to num_threads threads.
+// leaves[i] is the cache for points[i] and is set to its leaf.
+void bsp_point_leaf_batch(bsp_map_t *map, const gs_vec3 *points, int32_t *leaves, uint32_t count, uint32_t num_threads)
+{
+	bsp_point_batch_t batch = {
+		.map	= map,
+		.points = points,
+		.leaves = leaves,
+	};
+	mg_job_manager_parallel_for(_bsp_point_leaf_batch_job, &batch, count, BSP_POINT_BATCH_CHUNK, num_threads);
+}
+
+void _bsp_point_leaf_batch_job(void *data, uint32_t start, uint32_t end, uint32_t thread)
+{
+	bsp_point_batch_t *batch = data;
+
+	for (uint32_t i = start; i < end; i++)
+	{
+		bsp_point_leaf(batch->map, batch->points[i], &batch->leaves[i]);
+	}
+}
+
+// Depth first over the tree, path holds the planes from the root.
+// Planes the leaf bounds are fully on the leaf side of are left out,
+// axial leaves usually end up with none.
+void _bsp_point_build(bsp_map_t *map, int32_t index, int32_t *path, uint32_t depth)
+{
+	if (index >= 0)
+	{
+		if (depth >= BSP_TRACE_STACK_SIZE)
+		{
+			mg_println("WARN: _bsp_point_build tree deeper than %d", BSP_TRACE_STACK_SIZE);
+			return;
+		}
+
+		bsp_node_lump_t *node = &map->nodes.data[index];
+		path[depth]	      = node->plane;
+		_bsp_point_build(map, node->children[0], path, depth + 1);
+		path[depth] = ~node->plane;
+		_bsp_point_build(map, node->children[1], path, depth + 1);
+		return;
+	}
+
+	bsp_leaf_lump_t *leaf  = &map->leaves.data[~index];
+	bsp_point_leaf_t *dest = &map->point_leaves.leaves[~index];
+	dest->first_plane      = gs_dyn_array_size(map->point_leaves.planes);
+	dest->num_planes       = 0;
+
+	for (uint32_t i = 0; i < depth; i++)
+	{
+		bool32_t front	       = path[i] >= 0;
+		bsp_plane_lump_t plane = map->planes.data[front ? path[i] : ~path[i]];
+
+		// Distance range over the bounds, from the corners nearest and farthest along the normal
+		float32_t min = -plane.dist;
+		float32_t max = -plane.dist;
+		for (size_t j = 0; j < 3; j++)
+		{
+			float32_t a = plane.normal.xyz[j] * leaf->mins[j];
+			float32_t b = plane.normal.xyz[j] * leaf->maxs[j];
+			min += gs_min(a, b);
+			max += gs_max(a, b);
+		}
+
+		// Same test as point_in_front_of_plane
+		if ((front && min >= 0.0f) || (!front && max < 0.0f))
+		{
+			continue;
+		}
+
+		gs_dyn_array_push(map->point_leaves.planes, path[i]);
+		dest->num_planes++;
+	}
+}
+
+bool32_t _bsp_point_in_leaf(bsp_map_t *map, int32_t leaf, gs_vec3 point)
+{
+	bsp_leaf_lump_t *lump = &map->leaves.data[leaf];
+	for (size_t i = 0; i < 3; i++)
+	{
+		if (point.xyz[i] < lump->mins[i] || point.xyz[i] > lump->maxs[i])
+		{
+			return false;
+		}
+	}
+
+	// Not built yet
+	if (map->point_leaves.leaves == NULL)
+	{
+		return false;
+	}
+
+	const bsp_point_leaf_t *pl = &map->point_leaves.leaves[leaf];
+	for (uint32_t i = 0; i < pl->num_planes; i++)
+	{
+		int32_t index	       = map->point_leaves.planes[pl->first_plane + i];
+		bool32_t front	       = index >= 0;
+		bsp_plane_lump_t plane = map->planes.data[front ? index : ~index];
+		if (point_in_front_of_plane(plane.normal, plane.dist, point) != front)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Walks from the root, same as _bsp_find_camera_leaf
+int32_t _bsp_point_descend(bsp_map_t *map, gs_vec3 point)
+{
+	int32_t index = 0;
+	while (index >= 0)
+	{
+		bsp_node_lump_t *node  = &map->nodes.data[index];
+		bsp_plane_lump_t plane = map->planes.data[node->plane];
+		index		       = node->children[point_in_front_of_plane(plane.normal, plane.dist, point) ? 0 : 1];
+	}
+
+	return ~index;
+}
+
+int32_t _bsp_point_leaf_contents(bsp_map_t *map, int32_t leaf, gs_vec3 point)
+{
+	bsp_leaf_lump_t *lump		  = &map->leaves.data[leaf];
+	const bsp_trace_brushes_t *packed = &map->trace_brushes;
+	int32_t contents		  = 0;
+
+	for (int32_t i = 0; i < lump->num_leaf_brushes; i++)
+	{
+		const bsp_trace_brush_t *brush = &packed->brushes[map->leaf_brushes.data[lump->first_leaf_brush + i].brush];
+		if (brush->num_planes == 0 || (brush->contents & ~contents) == 0)
+		{
+			continue;
+		}
+
+		bool32_t inside = true;
+		for (uint32_t j = 0; j < brush->num_planes && inside; j++)
+		{
+			const bsp_trace_plane_t *plane = &packed->planes[brush->first_plane + j];
+			inside			       = plane->normal[0] * point.x + plane->normal[1] * point.y + plane->normal[2] * point.z - plane->dist <= 0;
+		}
+
+		if (inside)
+		{
+			contents |= brush->contents;
+		}
+	}
+
+	return contents;
+}
@@ -0,0 +1,31 @@
+/*================================================================
+	* bsp/bsp_point.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Leaf and contents lookups for points, starting from
+	the leaf the point was in last time.
+=================================================================*/
+
+#ifndef BSP_POINT_H
+#define BSP_POINT_H
+
+#include <gs/gs.h>
+
+#include "bsp_types.h"
+
+#define BSP_POINT_BATCH_CHUNK 256 // points taken by a thread at a time
+
+void bsp_point_init(bsp_map_t *map);
+void bsp_point_free(bsp_map_t *map);
+int32_t bsp_point_leaf(bsp_map_t *map, gs_vec3 point, int32_t *cache);
+int32_t bsp_point_contents(bsp_map_t *map, gs_vec3 point, int32_t *cache);
+void bsp_point_leaf_batch(bsp_map_t *map, const gs_vec3 *points, int32_t *leaves, uint32_t count, uint32_t num_threads);
+void _bsp_point_leaf_batch_job(void *data, uint32_t start, uint32_t end, uint32_t thread);
+void _bsp_point_build(bsp_map_t *map, int32_t index, int32_t *path, uint32_t depth);
+bool32_t _bsp_point_in_leaf(bsp_map_t *map, int32_t leaf, gs_vec3 point);
+int32_t _bsp_point_descend(bsp_map_t *map, gs_vec3 point);
+int32_t _bsp_point_leaf_contents(bsp_map_t *map, int32_t leaf, gs_vec3 point);
+
+#endif // BSP_POINT_H
@@ -9,7 +9,12 @@
 	http://www.devmaster.net/articles/quake3collision/
 =================================================================*/
 
+#include <float.h>
+
 #include "bsp_trace.h"
+#include "bsp_patch.h"
+#include "../game/console.h"
+#include "../game/job_manager.h"
 
 void bsp_trace_ray(bsp_trace_t *trace, gs_vec3 start, gs_vec3 end, int32_t content_mask)
 {
@@ -46,16 +51,110 @@ void bsp_trace_box(bsp_trace_t *trace, gs_vec3 start, gs_vec3 end, gs_vec3 mins,
 	_bsp_trace(trace, start, end, content_mask);
 }
 
+typedef struct bsp_trace_batch_t
+{
+	bsp_map_t *map;
+	const bsp_trace_request_t *requests;
+	bsp_trace_t *results;
+} bsp_trace_batch_t;
+
+// Runs count traces split over up to num_threads threads.
+// results[i] is written for requests[i], the map is only read.
+void bsp_trace_batch(bsp_map_t *map, const bsp_trace_request_t *requests, bsp_trace_t *results, uint32_t count, uint32_t num_threads)
+{
+	bsp_trace_batch_t batch = {
+		.map	  = map,
+		.requests = requests,
+		.results  = results,
+	};
+	mg_job_manager_parallel_for(_bsp_trace_batch_job, &batch, count, BSP_TRACE_BATCH_CHUNK, num_threads);
+}
+
+void _bsp_trace_batch_job(void *data, uint32_t start, uint32_t end, uint32_t thread)
+{
+	bsp_trace_batch_t *batch = data;
+
+	for (uint32_t i = start; i < end; i++)
+	{
+		const bsp_trace_request_t *req = &batch->requests[i];
+		bsp_trace_t *trace	       = &batch->results[i];
+		trace->map		       = batch->map;
+		trace->thread		       = thread;
+
+		switch (req->type)
+		{
+		case RAY:
+			bsp_trace_ray(trace, req->start, req->end, req->content_mask);
+			break;
+		case SPHERE:
+			bsp_trace_sphere(trace, req->start, req->end, req->radius, req->content_mask);
+			break;
+		case BOX:
+			bsp_trace_box(trace, req->start, req->end, req->mins, req->maxs, req->content_mask);
+			break;
+		}
+	}
+}
+
 void _bsp_trace(bsp_trace_t *trace, gs_vec3 start, gs_vec3 end, int32_t content_mask)
 {
 	gs_assert(trace->map != NULL);
 
-	trace->start_solid = false;
-	trace->all_solid   = false;
-	trace->fraction	   = 1.0f;
+	trace->start_solid     = false;
+	trace->all_solid       = false;
+	trace->fraction	       = 1.0f;
+	trace->nodes_visited   = 0;
+	trace->brushes_tested  = 0;
+	trace->brushes_skipped = 0;
+	trace->brushes_culled  = 0;
+
+	// Bounds of everything the trace touches
+	for (size_t i = 0; i < 3; i++)
+	{
+		float32_t lo = fminf(start.xyz[i], end.xyz[i]);
+		float32_t hi = fmaxf(start.xyz[i], end.xyz[i]);
+		if (trace->type == BOX)
+		{
+			lo += trace->mins.xyz[i];
+			hi += trace->maxs.xyz[i];
+		}
+		else if (trace->type == SPHERE)
+		{
+			lo -= trace->radius;
+			hi += trace->radius;
+		}
+		trace->sweep_mins.xyz[i] = lo - BSP_TRACE_BRUSH_MARGIN;
+		trace->sweep_maxs.xyz[i] = hi + BSP_TRACE_BRUSH_MARGIN;
+	}
+
+	// Box corner to offset brush planes by, per normal signbits
+	for (size_t i = 0; i < 8; i++)
+	{
+		if (trace->type == BOX)
+		{
+			trace->offsets[i] = gs_v3(
+				(i & 1) ? trace->maxs.x : trace->mins.x,
+				(i & 2) ? trace->maxs.y : trace->mins.y,
+				(i & 4) ? trace->maxs.z : trace->mins.z);
+		}
+		else
+		{
+			trace->offsets[i] = gs_v3(0, 0, 0);
+		}
+	}
+
+	// New stamp for brushes clipped by this trace
+	bsp_trace_scratch_t *scratch = &trace->map->trace_scratch[trace->thread];
+	scratch->checkcount++;
+	if (scratch->checkcount == 0)
+	{
+		memset(scratch->brush_checks, 0, trace->map->brushes.count * sizeof(uint32_t));
+		memset(scratch->patch_checks, 0, trace->map->trace_brushes.num_patches * sizeof(uint32_t));
+		scratch->checkcount = 1;
+	}
 
 	// Walk through the BSP tree
-	_bsp_trace_check_node(trace, 0, 0.0f, 1.0f, start, end, content_mask);
+	_bsp_trace_check_nodes(trace, start, end, content_mask);
 
 	if (trace->fraction == 1.0f)
 	{
@@ -70,68 +169,102 @@ void _bsp_trace(bsp_trace_t *trace, gs_vec3 start, gs_vec3 end, int32_t content_
 	}
 }
 
-void _bsp_trace_check_node(bsp_trace_t *trace, int32_t node_index, float32_t start_fraction, float32_t end_fraction, gs_vec3 start, gs_vec3 end, int32_t content_mask)
+// Walks the nodes the trace passes through with an explicit stack,
+// nearest side first like the recursive version did.
+void _bsp_trace_check_nodes(bsp_trace_t *trace, gs_vec3 start, gs_vec3 end, int32_t content_mask)
 {
-	if (node_index < 0)
+	bsp_trace_stack_entry_t stack[BSP_TRACE_STACK_SIZE];
+	uint32_t stack_size = 0;
+
+	stack[stack_size++] = (bsp_trace_stack_entry_t){
+		.node		= 0,
+		.start_fraction = 0.0f,
+		.end_fraction	= 1.0f,
+		.start		= start,
+		.end		= end,
+	};
+
+	while (stack_size > 0)
 	{
-		// This is a leaf
-		bsp_leaf_lump_t leaf = trace->map->leaves.data[-(node_index + 1)];
-		int32_t brush_index;
-		bsp_brush_lump_t brush;
-		for (size_t i = 0; i < leaf.num_leaf_brushes; i++)
+		bsp_trace_stack_entry_t entry = stack[--stack_size];
+
+		// Already hit something before this segment
+		if (trace->fraction <= entry.start_fraction)
 		{
-			brush_index = trace->map->leaf_brushes.data[leaf.first_leaf_brush + i].brush;
-			brush	    = trace->map->brushes.data[brush_index];
-			if (brush.num_brush_sides > 0 && (trace->map->textures.data[brush.texture].contents & content_mask) != 0)
-			{
-				_bsp_trace_check_brush(trace, brush, start, end);
-			}
+			continue;
 		}
 
-		// Don't have to do anything else for leaves
-		return;
-	}
+		if (entry.node < 0)
+		{
+			// Brushes are clipped against the whole trace,
+			// not the segment in this leaf.
+			_bsp_trace_check_leaf(trace, -(entry.node + 1), start, end, content_mask);
+			continue;
+		}
 
-	// This is a node
-	bsp_node_lump_t node   = trace->map->nodes.data[node_index];
-	bsp_plane_lump_t plane = trace->map->planes.data[node.plane];
+		trace->nodes_visited++;
 
-	float32_t offset	 = 0;
-	float32_t start_distance = gs_vec3_dot(start, plane.normal) - plane.dist;
-	float32_t end_distance	 = gs_vec3_dot(end, plane.normal) - plane.dist;
+		bsp_node_lump_t node   = trace->map->nodes.data[entry.node];
+		bsp_plane_lump_t plane = trace->map->planes.data[node.plane];
 
-	if (trace->type == SPHERE)
-	{
-		offset = trace->radius;
-	}
-	else if (trace->type == BOX)
-	{
-		// Dot product but we want the absolute values
-		offset = fabsf(trace->extents.x * plane.normal.x) +
-			 fabsf(trace->extents.y * plane.normal.y) +
-			 fabsf(trace->extents.z * plane.normal.z);
-	}
+		uint8_t type = trace->map->trace_brushes.plane_types[node.plane];
+		float32_t offset;
+		float32_t start_distance;
+		float32_t end_distance;
+
+		if (type < BSP_TRACE_PLANE_NON_AXIAL)
+		{
+			// Only one component of the normal is set
+			start_distance = entry.start.xyz[type] * plane.normal.xyz[type] - plane.dist;
+			end_distance   = entry.end.xyz[type] * plane.normal.xyz[type] - plane.dist;
+			offset	       = trace->type == BOX ? trace->extents.xyz[type] : 0;
+		}
+		else
+		{
+			start_distance = gs_vec3_dot(entry.start, plane.normal) - plane.dist;
+			end_distance   = gs_vec3_dot(entry.end, plane.normal) - plane.dist;
+			offset	       = 0;
+			if (trace->type == BOX)
+			{
+				// Dot product but we want the absolute values
+				offset = fabsf(trace->extents.x * plane.normal.x) +
+					 fabsf(trace->extents.y * plane.normal.y) +
+					 fabsf(trace->extents.z * plane.normal.z);
+			}
+		}
+
+		if (trace->type == SPHERE)
+		{
+			offset = trace->radius;
+		}
+
+		if (start_distance >= offset && end_distance >= offset)
+		{
+			// Both points are in front of the plane,
+			// check the front child.
+			entry.node	    = node.children[0];
+			stack[stack_size++] = entry;
+			continue;
+		}
+		if (start_distance < -offset && end_distance < -offset)
+		{
+			// Both points are behind the plane,
+			// check back child.
+			entry.node	    = node.children[1];
+			stack[stack_size++] = entry;
+			continue;
+		}
 
-	if (start_distance >= offset && end_distance >= offset)
-	{
-		// Both points are in front of the plane,
-		// check the front child.
-		_bsp_trace_check_node(trace, node.children[0], start_fraction, end_fraction, start, end, content_mask);
-	}
-	else if (start_distance < -offset && end_distance < -offset)
-	{
-		// Both points are behind the plane,
-		// check back child.
-		_bsp_trace_check_node(trace, node.children[1], start_fraction, end_fraction, start, end, content_mask);
-	}
-	else
-	{
 		// The line crosses through the splitting plane.
+		if (stack_size + 2 > BSP_TRACE_STACK_SIZE)
+		{
+			mg_println("WARN: _bsp_trace_check_nodes stack overflow at node %d", entry.node);
+			continue;
+		}
+
 		int32_t side;
 		float32_t fraction1;
 		float32_t fraction2;
-		float32_t middle_fraction;
-		gs_vec3 middle;
 
 		// STEP 1: Split the segment into two.
 		if (start_distance < end_distance)
@@ -159,23 +292,532 @@ void _bsp_trace_check_node(bsp_trace_t *trace, int32_t node_index, float32_t sta
 		fraction1 = fminf(1.0f, fmaxf(0.0f, fraction1));
 		fraction2 = fminf(1.0f, fmaxf(0.0f, fraction2));
 
-		// STEP 3: Calculate the middle point for the first side
-		middle_fraction = start_fraction + (end_fraction - start_fraction) * fraction1;
-		middle		= gs_vec3_add(start, gs_vec3_scale(gs_vec3_sub(end, start), fraction1));
+		gs_vec3 delta	      = gs_vec3_sub(entry.end, entry.start);
+		float32_t frac_length = entry.end_fraction - entry.start_fraction;
+
+		// STEP 3: Push the second side, popped after the first
+		stack[stack_size++] = (bsp_trace_stack_entry_t){
+			.node		= node.children[1 - side],
+			.start_fraction = entry.start_fraction + frac_length * fraction2,
+			.end_fraction	= entry.end_fraction,
+			.start		= gs_vec3_add(entry.start, gs_vec3_scale(delta, fraction2)),
+			.end		= entry.end,
+		};
+
+		// STEP 4: Push the first side
+		stack[stack_size++] = (bsp_trace_stack_entry_t){
+			.node		= node.children[side],
+			.start_fraction = entry.start_fraction,
+			.end_fraction	= entry.start_fraction + frac_length * fraction1,
+			.start		= entry.start,
+			.end		= gs_vec3_add(entry.start, gs_vec3_scale(delta, fraction1)),
+		};
+	}
+}
+
+void _bsp_trace_check_leaf(bsp_trace_t *trace, int32_t leaf_index, gs_vec3 start, gs_vec3 end, int32_t content_mask)
+{
+	bsp_trace_scratch_t *scratch = &trace->map->trace_scratch[trace->thread];
+	bsp_leaf_lump_t leaf	     = trace->map->leaves.data[leaf_index];
+	int32_t brush_index;
+	bsp_brush_lump_t brush;
+
+	for (size_t i = 0; i < leaf.num_leaf_brushes; i++)
+	{
+		brush_index = trace->map->leaf_brushes.data[leaf.first_leaf_brush + i].brush;
+
+		// Brushes are in multiple leaves, clip each only once
+		if (scratch->brush_checks[brush_index] == scratch->checkcount)
+		{
+			trace->brushes_skipped++;
+			continue;
+		}
+		scratch->brush_checks[brush_index] = scratch->checkcount;
+
+		if (trace->reference)
+		{
+			brush = trace->map->brushes.data[brush_index];
+			if (brush.num_brush_sides > 0 && (trace->map->textures.data[brush.texture].contents & content_mask) != 0)
+			{
+				trace->brushes_tested++;
+				_bsp_trace_check_brush_lumps(trace, brush, start, end);
+			}
+			continue;
+		}
+
+		const bsp_trace_brush_t *packed = &trace->map->trace_brushes.brushes[brush_index];
+		if (packed->num_planes > 0 && (packed->contents & content_mask) != 0)
+		{
+			if (!_bsp_trace_bounds_touch_sweep(trace, packed->mins, packed->maxs))
+			{
+				trace->brushes_culled++;
+				continue;
+			}
+
+			trace->brushes_tested++;
+			_bsp_trace_check_brush(trace, packed, start, end);
+		}
+	}
+
+	if (trace->skip_patches)
+	{
+		return;
+	}
+
+	const bsp_trace_brushes_t *packed = &trace->map->trace_brushes;
+	for (uint32_t i = packed->leaf_first_patch[leaf_index]; i < packed->leaf_first_patch[leaf_index + 1]; i++)
+	{
+		uint32_t patch_index = packed->leaf_patches[i];
+		if (scratch->patch_checks[patch_index] == scratch->checkcount)
+		{
+			continue;
+		}
+		scratch->patch_checks[patch_index] = scratch->checkcount;
+
+		const bsp_trace_patch_t *patch = &packed->patches[patch_index];
+		if ((patch->contents & content_mask) == 0)
+		{
+			continue;
+		}
+		if (!_bsp_trace_bounds_touch_sweep(trace, patch->mins, patch->maxs))
+		{
+			trace->brushes_culled += patch->num_brushes;
+			continue;
+		}
+
+		for (uint32_t j = 0; j < patch->num_brushes; j++)
+		{
+			const bsp_trace_brush_t *facet = &packed->brushes[patch->first_brush + j];
+			if (!_bsp_trace_bounds_touch_sweep(trace, facet->mins, facet->maxs))
+			{
+				trace->brushes_culled++;
+				continue;
+			}
+
+			trace->brushes_tested++;
+			_bsp_trace_check_brush(trace, facet, start, end);
+		}
+	}
+}
+
+void bsp_trace_init(bsp_map_t *map, int32_t patch_tesselation)
+{
+	patch_tesselation	    = gs_clamp(patch_tesselation, 0, BSP_PATCH_COLLISION_MAX_TESSELATION);
+	bsp_trace_brushes_t *packed = &map->trace_brushes;
+	*packed			    = (bsp_trace_brushes_t){0};
+
+	// Upper bounds, patches can have degenerate triangles
+	uint32_t max_brushes = map->brushes.count;
+	uint32_t max_planes  = 0;
+	uint32_t max_patches = 0;
+	for (size_t i = 0; i < map->brushes.count; i++)
+	{
+		max_planes += gs_max(map->brushes.data[i].num_brush_sides, 0);
+	}
+	for (size_t i = 0; i < map->faces.count; i++)
+	{
+		bsp_face_lump_t face = map->faces.data[i];
+		if (patch_tesselation > 0 && face.type == BSP_FACE_TYPE_PATCH)
+		{
+			uint32_t facets = ((face.size[0] - 1) >> 1) * ((face.size[1] - 1) >> 1) * patch_tesselation * patch_tesselation * 2;
+			max_brushes += facets;
+			max_planes += facets * BSP_TRACE_FACET_PLANES;
+			max_patches++;
+		}
+	}
+
+	packed->brushes	      = gs_malloc(gs_max(max_brushes, 1) * sizeof(bsp_trace_brush_t));
+	packed->planes	      = gs_malloc(gs_max(max_planes, 1) * sizeof(bsp_trace_plane_t));
+	packed->signbits      = gs_malloc(gs_max(max_planes, 1) * sizeof(uint8_t));
+	packed->types	      = gs_malloc(gs_max(max_planes, 1) * sizeof(uint8_t));
+	packed->surface_flags = gs_malloc(gs_max(max_planes, 1) * sizeof(int32_t));
+	packed->plane_types   = gs_malloc(gs_max(map->planes.count, 1) * sizeof(uint8_t));
+	packed->patches	      = gs_malloc(gs_max(max_patches, 1) * sizeof(bsp_trace_patch_t));
 
-		// STEP 4: Check the first side
-		_bsp_trace_check_node(trace, node.children[side], start_fraction, middle_fraction, start, middle, content_mask);
+	for (size_t i = 0; i < map->planes.count; i++)
+	{
+		packed->plane_types[i] = _bsp_trace_plane_type(map->planes.data[i].normal);
+	}
+
+	// Pack brush sides
+	for (size_t i = 0; i < map->brushes.count; i++)
+	{
+		bsp_brush_lump_t brush	= map->brushes.data[i];
+		bsp_trace_brush_t *dest = &packed->brushes[packed->num_brushes++];
+		*dest			= (bsp_trace_brush_t){
+			.first_plane = packed->num_planes,
+			.contents    = map->textures.data[brush.texture].contents,
+			.mins	     = {-FLT_MAX, -FLT_MAX, -FLT_MAX},
+			.maxs	     = {FLT_MAX, FLT_MAX, FLT_MAX},
+		};
+
+		for (size_t j = 0; j < gs_max(brush.num_brush_sides, 0); j++)
+		{
+			bsp_brush_side_lump_t side = map->brush_sides.data[brush.first_brush_side + j];
+			bsp_plane_lump_t plane	   = map->planes.data[side.plane];
+			_bsp_trace_add_plane(packed, dest, plane.normal, plane.dist, map->textures.data[side.texture].flags);
+		}
+	}
 
-		// STEP 5: Calculate the middle point for the second side
-		middle_fraction = start_fraction + (end_fraction - start_fraction) * fraction2;
-		middle		= gs_vec3_add(start, gs_vec3_scale(gs_vec3_sub(end, start), fraction2));
+	_bsp_trace_add_patches(map, patch_tesselation);
 
-		// STEP 6: Check the second side
-		_bsp_trace_check_node(trace, node.children[1 - side], middle_fraction, end_fraction, middle, end, content_mask);
+	map->trace_scratch = gs_malloc(MG_JOB_MANAGER_THREADS * sizeof(bsp_trace_scratch_t));
+	for (size_t i = 0; i < MG_JOB_MANAGER_THREADS; i++)
+	{
+		map->trace_scratch[i].checkcount   = 0;
+		map->trace_scratch[i].brush_checks = gs_calloc(gs_max(map->brushes.count, 1), sizeof(uint32_t));
+		map->trace_scratch[i].patch_checks = gs_calloc(gs_max(packed->num_patches, 1), sizeof(uint32_t));
+	}
+}
+
+void bsp_trace_free(bsp_map_t *map)
+{
+	if (map->trace_scratch == NULL)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < MG_JOB_MANAGER_THREADS; i++)
+	{
+		gs_free(map->trace_scratch[i].brush_checks);
+		gs_free(map->trace_scratch[i].patch_checks);
+	}
+	gs_free(map->trace_scratch);
+	map->trace_scratch = NULL;
+
+	gs_free(map->trace_brushes.brushes);
+	gs_free(map->trace_brushes.planes);
+	gs_free(map->trace_brushes.signbits);
+	gs_free(map->trace_brushes.types);
+	gs_free(map->trace_brushes.plane_types);
+	gs_free(map->trace_brushes.surface_flags);
+	gs_free(map->trace_brushes.patches);
+	gs_free(map->trace_brushes.leaf_first_patch);
+	gs_free(map->trace_brushes.leaf_patches);
+	map->trace_brushes = (bsp_trace_brushes_t){0};
+}
+
+// Appends a side to the last packed brush
+void _bsp_trace_add_plane(bsp_trace_brushes_t *packed, bsp_trace_brush_t *brush, gs_vec3 normal, float32_t dist, int32_t surface_flags)
+{
+	uint32_t index = packed->num_planes++;
+	uint8_t type   = _bsp_trace_plane_type(normal);
+
+	uint8_t signbits = 0;
+	for (size_t i = 0; i < 3; i++)
+	{
+		packed->planes[index].normal[i] = normal.xyz[i];
+		if (normal.xyz[i] < 0)
+		{
+			signbits |= 1 << i;
+		}
+	}
+	packed->planes[index].dist   = dist;
+	packed->signbits[index]	     = signbits;
+	packed->types[index]	     = type;
+	packed->surface_flags[index] = surface_flags;
+	brush->num_planes++;
+
+	// Axial sides bound the brush
+	if (type < BSP_TRACE_PLANE_NON_AXIAL)
+	{
+		if (normal.xyz[type] > 0)
+		{
+			brush->maxs[type] = fminf(brush->maxs[type], dist);
+		}
+		else
+		{
+			brush->mins[type] = fmaxf(brush->mins[type], -dist);
+		}
+	}
+}
+
+// Tesselates patch faces into facet brushes and lists them per leaf
+void _bsp_trace_add_patches(bsp_map_t *map, int32_t tesselation)
+{
+	bsp_trace_brushes_t *packed = &map->trace_brushes;
+	int32_t *face_patches	    = gs_malloc(gs_max(map->faces.count, 1) * sizeof(int32_t));
+
+	for (size_t i = 0; i < map->faces.count; i++)
+	{
+		face_patches[i]	     = -1;
+		bsp_face_lump_t face = map->faces.data[i];
+		if (tesselation == 0 || face.type != BSP_FACE_TYPE_PATCH || map->textures.data[face.texture].contents == 0)
+		{
+			continue;
+		}
+
+		bsp_trace_patch_t patch = {
+			.first_brush = packed->num_brushes,
+			.contents    = map->textures.data[face.texture].contents,
+			.mins	     = {FLT_MAX, FLT_MAX, FLT_MAX},
+			.maxs	     = {-FLT_MAX, -FLT_MAX, -FLT_MAX},
+		};
+		int32_t flags = map->textures.data[face.texture].flags;
+
+		uint32_t num_patches_x = (face.size[0] - 1) >> 1;
+		uint32_t num_patches_y = (face.size[1] - 1) >> 1;
+		for (size_t x = 0; x < num_patches_x; x++)
+		{
+			for (size_t y = 0; y < num_patches_y; y++)
+			{
+				bsp_quadratic_patch_t quadratic = {
+					.tesselation = tesselation,
+				};
+				bsp_quadratic_patch_control_points(map->vertices.data, face, x, y, quadratic.control_points);
+				bsp_quadratic_patch_tesselate(&quadratic);
+
+				for (size_t j = 0; j + 2 < gs_dyn_array_size(quadratic.indices); j += 3)
+				{
+					_bsp_trace_add_facet(
+						packed,
+						quadratic.vertices[quadratic.indices[j + 0]].position,
+						quadratic.vertices[quadratic.indices[j + 1]].position,
+						quadratic.vertices[quadratic.indices[j + 2]].position,
+						patch.contents,
+						flags);
+				}
+
+				bsp_quadratic_patch_free(&quadratic);
+			}
+		}
+
+		patch.num_brushes = packed->num_brushes - patch.first_brush;
+		if (patch.num_brushes == 0)
+		{
+			continue;
+		}
+
+		for (size_t j = 0; j < patch.num_brushes; j++)
+		{
+			for (size_t k = 0; k < 3; k++)
+			{
+				patch.mins[k] = fminf(patch.mins[k], packed->brushes[patch.first_brush + j].mins[k]);
+				patch.maxs[k] = fmaxf(patch.maxs[k], packed->brushes[patch.first_brush + j].maxs[k]);
+			}
+		}
+
+		face_patches[i]			       = packed->num_patches;
+		packed->patches[packed->num_patches++] = patch;
+	}
+
+	// Patches in each leaf, from the leaf faces
+	packed->leaf_first_patch = gs_calloc(map->leaves.count + 1, sizeof(uint32_t));
+	for (size_t i = 0; i < map->leaves.count; i++)
+	{
+		bsp_leaf_lump_t leaf		= map->leaves.data[i];
+		packed->leaf_first_patch[i + 1] = packed->leaf_first_patch[i];
+		for (size_t j = 0; j < leaf.num_leaf_faces; j++)
+		{
+			int32_t face = map->leaf_faces.data[leaf.first_leaf_face + j].face;
+			packed->leaf_first_patch[i + 1] += face_patches[face] >= 0;
+		}
+	}
+
+	packed->leaf_patches = gs_malloc(gs_max(packed->leaf_first_patch[map->leaves.count], 1) * sizeof(uint32_t));
+	for (size_t i = 0; i < map->leaves.count; i++)
+	{
+		bsp_leaf_lump_t leaf = map->leaves.data[i];
+		uint32_t next	     = packed->leaf_first_patch[i];
+		for (size_t j = 0; j < leaf.num_leaf_faces; j++)
+		{
+			int32_t face = map->leaf_faces.data[leaf.first_leaf_face + j].face;
+			if (face_patches[face] >= 0)
+			{
+				packed->leaf_patches[next++] = face_patches[face];
+			}
+		}
+	}
+
+	gs_free(face_patches);
+}
+
+// Packs a patch triangle into a thin convex brush:
+// surface planes on both sides, edge planes and axial bevels.
+void _bsp_trace_add_facet(bsp_trace_brushes_t *packed, gs_vec3 a, gs_vec3 b, gs_vec3 c, int32_t contents, int32_t surface_flags)
+{
+	gs_vec3 normal = gs_vec3_cross(gs_vec3_sub(b, a), gs_vec3_sub(c, a));
+	if (gs_vec3_len(normal) < BSP_TRACE_EPSILON)
+	{
+		// Degenerate, patch edges can collapse to points
+		return;
+	}
+	normal = gs_vec3_norm(normal);
+
+	bsp_trace_brush_t *brush = &packed->brushes[packed->num_brushes++];
+	*brush			 = (bsp_trace_brush_t){
+		.first_plane = packed->num_planes,
+		.contents    = contents,
+		.mins	     = {-FLT_MAX, -FLT_MAX, -FLT_MAX},
+		.maxs	     = {FLT_MAX, FLT_MAX, FLT_MAX},
+	};
+
+	// Patches can be seen from both sides, extend the surface both ways
+	float32_t dist	    = gs_vec3_dot(normal, a);
+	float32_t half_size = BSP_PATCH_COLLISION_THICKNESS * 0.5f;
+	_bsp_trace_add_plane(packed, brush, normal, dist + half_size, surface_flags);
+	_bsp_trace_add_plane(packed, brush, gs_vec3_scale(normal, -1.0f), -dist + half_size, surface_flags);
+
+	// Edges
+	gs_vec3 points[3] = {a, b, c};
+	for (size_t i = 0; i < 3; i++)
+	{
+		gs_vec3 p	    = points[i];
+		gs_vec3 q	    = points[(i + 1) % 3];
+		gs_vec3 r	    = points[(i + 2) % 3];
+		gs_vec3 edge_normal = gs_vec3_norm(gs_vec3_cross(gs_vec3_sub(q, p), normal));
+		if (gs_vec3_dot(edge_normal, gs_vec3_sub(r, p)) > 0)
+		{
+			edge_normal = gs_vec3_scale(edge_normal, -1.0f);
+		}
+		_bsp_trace_add_plane(packed, brush, edge_normal, gs_vec3_dot(edge_normal, p), surface_flags);
+	}
+
+	// Axial bevels keep boxes from sliding into the edges
+	for (size_t i = 0; i < 3; i++)
+	{
+		float32_t lo = fminf(a.xyz[i], fminf(b.xyz[i], c.xyz[i])) - fabsf(normal.xyz[i]) * half_size;
+		float32_t hi = fmaxf(a.xyz[i], fmaxf(b.xyz[i], c.xyz[i])) + fabsf(normal.xyz[i]) * half_size;
+
+		gs_vec3 axis = gs_v3(0, 0, 0);
+		axis.xyz[i]  = 1.0f;
+		_bsp_trace_add_plane(packed, brush, axis, hi, surface_flags);
+		axis.xyz[i] = -1.0f;
+		_bsp_trace_add_plane(packed, brush, axis, -lo, surface_flags);
+	}
+}
+
+// Axis index of planes with a single +-1 normal component
+uint8_t _bsp_trace_plane_type(gs_vec3 normal)
+{
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		if (fabsf(normal.xyz[i]) == 1.0f && normal.xyz[(i + 1) % 3] == 0 && normal.xyz[(i + 2) % 3] == 0)
+		{
+			return i;
+		}
+	}
+	return BSP_TRACE_PLANE_NON_AXIAL;
+}
+
+// False if an axial side of the brush separates it from the trace.
+// Margin keeps this from rejecting anything the clip would hit.
+bool32_t _bsp_trace_bounds_touch_sweep(const bsp_trace_t *trace, const float32_t *mins, const float32_t *maxs)
+{
+	return maxs[0] >= trace->sweep_mins.x && mins[0] <= trace->sweep_maxs.x &&
+	       maxs[1] >= trace->sweep_mins.y && mins[1] <= trace->sweep_maxs.y &&
+	       maxs[2] >= trace->sweep_mins.z && mins[2] <= trace->sweep_maxs.z;
+}
+
+// Same clipping as _bsp_trace_check_brush_lumps,
+// on the packed planes.
+void _bsp_trace_check_brush(bsp_trace_t *trace, const bsp_trace_brush_t *brush, gs_vec3 start, gs_vec3 end)
+{
+	const bsp_trace_brushes_t *packed = &trace->map->trace_brushes;
+	const bsp_trace_plane_t *planes	  = &packed->planes[brush->first_plane];
+	const uint8_t *signbits		  = &packed->signbits[brush->first_plane];
+	const uint8_t *types		  = &packed->types[brush->first_plane];
+
+	float32_t start_fraction = -1.0f;
+	float32_t end_fraction	 = 1.0f;
+	bool32_t starts_out	 = false;
+	bool32_t ends_out	 = false;
+	int32_t clip_plane	 = -1;
+
+	for (uint32_t i = 0; i < brush->num_planes; i++)
+	{
+		const float32_t *n = planes[i].normal;
+		gs_vec3 offset	   = trace->offsets[signbits[i]];
+		float32_t dist	   = planes[i].dist + trace->radius;
+
+		float32_t start_distance;
+		float32_t end_distance;
+		uint8_t type = types[i];
+		if (type < BSP_TRACE_PLANE_NON_AXIAL)
+		{
+			// Other components would add zeros
+			start_distance = (start.xyz[type] + offset.xyz[type]) * n[type] - dist;
+			end_distance   = (end.xyz[type] + offset.xyz[type]) * n[type] - dist;
+		}
+		else
+		{
+			// Written out like gs_vec3_dot(gs_vec3_add(p, offset), normal)
+			// so results match the lump version exactly.
+			start_distance = (start.x + offset.x) * n[0] + (start.y + offset.y) * n[1] + (start.z + offset.z) * n[2] - dist;
+			end_distance   = (end.x + offset.x) * n[0] + (end.y + offset.y) * n[1] + (end.z + offset.z) * n[2] - dist;
+		}
+
+		if (start_distance > 0)
+			starts_out = true;
+		if (end_distance > 0)
+			ends_out = true;
+
+		if (start_distance > 0 && (end_distance >= BSP_TRACE_EPSILON || end_distance >= start_distance))
+		{
+			// Both are in front of the plane, outside of the brush
+			return;
+		}
+		if (start_distance <= 0 && end_distance <= 0)
+		{
+			// Both are behind this plane, check the next one
+			continue;
+		}
+
+		if (start_distance > end_distance)
+		{
+			// The line is entering the plane
+			float32_t fraction = (start_distance - BSP_TRACE_EPSILON) / (start_distance - end_distance);
+			if (fraction < 0)
+			{
+				fraction = 0;
+			}
+			if (fraction > start_fraction)
+			{
+				start_fraction = fraction;
+				clip_plane     = i;
+			}
+		}
+		else
+		{
+			// The line is leaving the plane
+			float32_t fraction = (start_distance + BSP_TRACE_EPSILON) / (start_distance - end_distance);
+			if (fraction > 1.0f)
+			{
+				fraction = 1.0f;
+			}
+			if (fraction < end_fraction)
+			{
+				end_fraction = fraction;
+			}
+		}
+	}
+
+	if (!starts_out)
+	{
+		trace->start_solid = true;
+		if (!ends_out)
+		{
+			trace->all_solid = true;
+			trace->fraction	 = 0;
+			trace->contents	 = brush->contents;
+		}
+		return;
+	}
+
+	if (start_fraction < end_fraction)
+	{
+		if (start_fraction > -1.0f && start_fraction < trace->fraction)
+		{
+			const float32_t *n   = planes[clip_plane].normal;
+			trace->fraction	     = fmaxf(0.0f, start_fraction);
+			trace->normal	     = gs_v3(n[0], n[1], n[2]);
+			trace->contents	     = brush->contents;
+			trace->surface_flags = packed->surface_flags[brush->first_plane + clip_plane];
+		}
 	}
 }
 
-void _bsp_trace_check_brush(bsp_trace_t *trace, bsp_brush_lump_t brush, gs_vec3 start, gs_vec3 end)
+void _bsp_trace_check_brush_lumps(bsp_trace_t *trace, bsp_brush_lump_t brush, gs_vec3 start, gs_vec3 end)
 {
 	float32_t start_fraction = -1.0f;
 	float end_fraction	 = 1.0f;
@@ -14,7 +14,12 @@
 
 #include "bsp_types.h"
 
-#define BSP_TRACE_EPSILON 0.125f
+#define BSP_TRACE_EPSILON	  0.125f
+#define BSP_TRACE_BATCH_CHUNK	  64			     // requests taken by a thread at a time
+#define BSP_TRACE_STACK_SIZE	  256			     // deeper than any Q3 BSP tree
+#define BSP_TRACE_PLANE_NON_AXIAL 3			     // plane type, 0-2 are axes
+#define BSP_TRACE_FACET_PLANES	  11			     // per patch triangle
+#define BSP_TRACE_BRUSH_MARGIN	  (BSP_TRACE_EPSILON * 2.0f) // brush bounds slack, above rounding errors
 
 typedef enum bsp_trace_type
 {
@@ -38,13 +43,58 @@ typedef struct bsp_trace_t
 	gs_vec3 extents;
 	int32_t contents;
 	int32_t surface_flags;
+	uint32_t thread;       // job manager thread running the trace, 0 for main
+	bool32_t reference;    // clip brush lumps instead of the packed brushes, for comparing
+	bool32_t skip_patches; // brushes only, for comparing
+	gs_vec3 offsets[8];    // box corner per plane normal signbits
+	gs_vec3 sweep_mins;    // swept bounds with margin
+	gs_vec3 sweep_maxs;
+
+	// Profiling counters of the last trace
+	uint32_t nodes_visited;
+	uint32_t brushes_tested;
+	uint32_t brushes_skipped; // already clipped in another leaf
+	uint32_t brushes_culled;  // bounds outside the sweep
 } bsp_trace_t;
 
+// Part of the trace still to check against a node
+typedef struct bsp_trace_stack_entry_t
+{
+	int32_t node;
+	float32_t start_fraction;
+	float32_t end_fraction;
+	gs_vec3 start;
+	gs_vec3 end;
+} bsp_trace_stack_entry_t;
+
+// Input for bsp_trace_batch
+typedef struct bsp_trace_request_t
+{
+	bsp_trace_type type;
+	gs_vec3 start;
+	gs_vec3 end;
+	gs_vec3 mins;	  // BOX
+	gs_vec3 maxs;	  // BOX
+	float32_t radius; // SPHERE
+	int32_t content_mask;
+} bsp_trace_request_t;
+
 void bsp_trace_ray(bsp_trace_t *trace, gs_vec3 start, gs_vec3 end, int32_t content_mask);
 void bsp_trace_sphere(bsp_trace_t *trace, gs_vec3 start, gs_vec3 end, float32_t radius, int32_t content_mask);
 void bsp_trace_box(bsp_trace_t *trace, gs_vec3 start, gs_vec3 end, gs_vec3 mins, gs_vec3 maxs, int32_t content_mask);
+void bsp_trace_init(bsp_map_t *map, int32_t patch_tesselation);
+void bsp_trace_free(bsp_map_t *map);
+void bsp_trace_batch(bsp_map_t *map, const bsp_trace_request_t *requests, bsp_trace_t *results, uint32_t count, uint32_t num_threads);
+void _bsp_trace_batch_job(void *data, uint32_t start, uint32_t end, uint32_t thread);
 void _bsp_trace(bsp_trace_t *trace, gs_vec3 start, gs_vec3 end, int32_t content_mask);
-void _bsp_trace_check_node(bsp_trace_t *trace, int32_t node_index, float32_t start_fraction, float32_t end_fraction, gs_vec3 start, gs_vec3 end, int32_t content_mask);
-void _bsp_trace_check_brush(bsp_trace_t *trace, bsp_brush_lump_t brush, gs_vec3 start, gs_vec3 end);
+void _bsp_trace_check_nodes(bsp_trace_t *trace, gs_vec3 start, gs_vec3 end, int32_t content_mask);
+void _bsp_trace_check_leaf(bsp_trace_t *trace, int32_t leaf_index, gs_vec3 start, gs_vec3 end, int32_t content_mask);
+uint8_t _bsp_trace_plane_type(gs_vec3 normal);
+void _bsp_trace_add_plane(bsp_trace_brushes_t *packed, bsp_trace_brush_t *brush, gs_vec3 normal, float32_t dist, int32_t surface_flags);
+void _bsp_trace_add_patches(bsp_map_t *map, int32_t tesselation);
+void _bsp_trace_add_facet(bsp_trace_brushes_t *packed, gs_vec3 a, gs_vec3 b, gs_vec3 c, int32_t contents, int32_t surface_flags);
+bool32_t _bsp_trace_bounds_touch_sweep(const bsp_trace_t *trace, const float32_t *mins, const float32_t *maxs);
+void _bsp_trace_check_brush(bsp_trace_t *trace, const bsp_trace_brush_t *brush, gs_vec3 start, gs_vec3 end);
+void _bsp_trace_check_brush_lumps(bsp_trace_t *trace, bsp_brush_lump_t brush, gs_vec3 start, gs_vec3 end);
 
 #endif // BSP_TRACE_H
\ No newline at end of file
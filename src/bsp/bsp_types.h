@@ -15,6 +15,11 @@
 
 #include <gs/gs.h>
 
+#include "../util/bitset.h"
+
+// Width and height of lightmap lumps
+#define BSP_LIGHTMAP_SIZE 128
+
 /*========
 // ENUMS
 =========*/
@@ -30,8 +35,15 @@ typedef enum bsp_content
 	BSP_CONTENT_CONTENTS_MONSTER	 = 128,
 	BSP_CONTENT_CONTENTS_PLAYERCLIP	 = 256,
 	BSP_CONTENT_CONTENTS_MONSTERCLIP = 512,
+	BSP_CONTENT_CONTENTS_TRANSLUCENT = 0x20000000,
 } bsp_content;
 
+typedef enum bsp_surface
+{
+	BSP_SURFACE_SKY	   = 0x4,
+	BSP_SURFACE_NODRAW = 0x80,
+} bsp_surface;
+
 typedef enum bsp_face_type
 {
 	BSP_FACE_TYPE_POLYGON = 1,
@@ -87,11 +99,24 @@ typedef struct bsp_stats_t
 	uint32_t total_patches;
 	uint32_t culled_leaves_pvs;
 	uint32_t culled_leaves_frustum;
+	uint32_t culled_leaves_occlusion;
+	uint32_t occluder_triangles;
 	uint32_t visible_leaves;
 	uint32_t visible_vertices;
 	uint32_t visible_indices;
 	uint32_t visible_faces;
 	uint32_t visible_patches;
+	uint32_t draw_calls;
+	uint32_t node_tests; // node AABB vs frustum tests
+	uint32_t leaf_tests; // leaf AABB vs frustum tests
+	double vis_time;     // seconds
+	uint32_t total_clusters;
+	uint32_t visible_clusters;
+	uint32_t occluded_clusters;
+	uint32_t cluster_ranges;       // draw ranges over all clusters
+	uint32_t cluster_ranges_max;   // most draw ranges in one cluster
+	size_t cluster_index_bytes;    // static per cluster index buffer size
+	size_t cluster_index_overhead; // bytes over the plain index buffer
 	uint32_t total_textures;
 	uint32_t loaded_textures;
 	uint32_t models;
@@ -102,11 +127,198 @@ typedef struct bsp_face_renderable_t
 {
 	int32_t type;
 	int32_t index;
+	int32_t texture;
+	int32_t lm_index;
 	uint32_t first_ibo_index;
 	uint32_t num_ibo_indices;
-	bool visible;
 } bsp_face_renderable_t;
 
+// Where a lightmap ended up in the atlas
+typedef struct bsp_lightmap_placement_t
+{
+	uint32_t page;
+	uint32_t x; // pixel offset of lightmap data, excluding padding
+	uint32_t y; // pixel offset of lightmap data, excluding padding
+} bsp_lightmap_placement_t;
+
+// Lightmaps packed into one or more square RGB8 pages
+typedef struct bsp_lightmap_atlas_t
+{
+	uint32_t page_size;
+	uint32_t padding;
+	uint32_t cells_per_row;
+	uint32_t num_pages;
+	uint8_t **pages; // RGB8 pixels, NULL after upload
+	uint32_t num_placements;
+	bsp_lightmap_placement_t *placements;
+} bsp_lightmap_atlas_t;
+
+// Unpacked cluster visibility, bit b of row a is set if a can see b.
+// Rows are padded to whole 64 bit words.
+typedef struct bsp_vis_t
+{
+	uint32_t num_clusters;
+	uint32_t stride;       // words per row
+	uint64_t *pvs;	       // potentially visible set rows
+	uint64_t *phs;	       // potentially hearable set rows, built on first use
+	mg_bitset_t phs_valid; // per cluster, phs row built
+	uint64_t *all;	       // row with every cluster set
+} bsp_vis_t;
+
+// Low resolution CPU depth buffer of large occluder faces,
+// stores NDC depth of the nearest occluder per pixel.
+typedef struct bsp_occlusion_t
+{
+	uint32_t width;
+	uint32_t height;
+	float *depth;
+	gs_mat4 view_projection;
+	bool32_t valid;	    // depth drawn this frame
+	uint8_t *occluders; // per render face, large enough to occlude
+	uint32_t num_occluders;
+} bsp_occlusion_t;
+
+// Same size textures stacked vertically into one texture,
+// shaders pick a layer per vertex.
+typedef struct bsp_material_array_t
+{
+	uint32_t width;
+	uint32_t height;		// of a single layer
+	gs_dyn_array(int32_t) textures;	// texture index per layer
+	gs_handle(gs_graphics_texture_t) hndl;
+} bsp_material_array_t;
+
+typedef struct bsp_material_table_t
+{
+	uint32_t num_textures;
+	uint32_t num_singletons;
+	uint32_t num_missing;
+	int32_t *texture_array;	// array index per texture, -1 if not in one
+	int32_t *texture_layer;	// layer index per texture
+	int32_t *texture_key;	// texture index to sort draws by
+	gs_dyn_array(bsp_material_array_t) arrays;
+} bsp_material_table_t;
+
+// Visible faces sharing a material,
+// merged into one range of the per-frame index buffer.
+typedef struct bsp_draw_range_t
+{
+	int32_t texture;
+	int32_t lm_index;
+	uint32_t first_index;
+	uint32_t num_indices;
+} bsp_draw_range_t;
+
+typedef struct bsp_draw_list_t
+{
+	gs_dyn_array(uint64_t) keys;	       // material and face index per visible face
+	gs_dyn_array(uint32_t) indices;	       // per-frame index buffer contents
+	gs_dyn_array(bsp_draw_range_t) ranges; // one per material
+} bsp_draw_list_t;
+
+// Material ranges of all faces in one cluster's leaves
+typedef struct bsp_cluster_draw_t
+{
+	uint32_t first_range;
+	uint32_t num_ranges;
+	uint32_t num_indices;
+} bsp_cluster_draw_t;
+
+// Static index buffer contents with clusters in contiguous ranges.
+// Faces in multiple clusters are duplicated.
+typedef struct bsp_cluster_draws_t
+{
+	uint32_t num_clusters;
+	gs_dyn_array(uint32_t) indices;		       // static index buffer contents
+	gs_dyn_array(bsp_draw_range_t) ranges;	       // ranges of all clusters
+	gs_dyn_array(bsp_cluster_draw_t) clusters;     // per cluster
+	gs_dyn_array(bsp_draw_range_t) visible_ranges; // per frame
+
+	// SoA cluster bounds, union of leaf bounds
+	float *mins[3];
+	float *maxs[3];
+	uint8_t *in_frustum; // per frame frustum test results
+} bsp_cluster_draws_t;
+
+// Leaves and faces potentially visible from a cluster,
+// rebuilt only when the view cluster changes.
+typedef struct bsp_pvs_cache_t
+{
+	bool32_t valid;
+	int32_t cluster;
+	gs_dyn_array(int32_t) leaves; // leaves passing PVS
+	gs_dyn_array(int32_t) faces;  // unique render faces in leaves
+	gs_dyn_array(uint8_t) nodes;  // per node, has leaves passing PVS
+} bsp_pvs_cache_t;
+
+// Trace state of one thread, brushes are stamped with
+// the checkcount of the last trace that clipped them.
+typedef struct bsp_trace_scratch_t
+{
+	uint32_t checkcount;
+	uint32_t *brush_checks; // per brush
+	uint32_t *patch_checks; // per collision patch
+} bsp_trace_scratch_t;
+
+// Brush side plane packed for tracing
+typedef struct bsp_trace_plane_t
+{
+	float32_t normal[3];
+	float32_t dist;
+} bsp_trace_plane_t;
+
+typedef struct bsp_trace_brush_t
+{
+	uint32_t first_plane;
+	uint32_t num_planes;
+	int32_t contents;  // of the brush texture
+	float32_t mins[3]; // from axial sides, unbounded without one
+	float32_t maxs[3];
+} bsp_trace_brush_t;
+
+// Facet brushes of one patch face
+typedef struct bsp_trace_patch_t
+{
+	uint32_t first_brush;
+	uint32_t num_brushes;
+	int32_t contents; // of the face texture
+	float32_t mins[3];
+	float32_t maxs[3];
+} bsp_trace_patch_t;
+
+// Brushes with their sides' planes stored contiguously,
+// built at load so traces don't chase lump indices.
+// Map brushes are followed by patch facets.
+typedef struct bsp_trace_brushes_t
+{
+	uint32_t num_brushes;
+	uint32_t num_planes;
+	uint32_t num_patches;
+	bsp_trace_patch_t *patches;
+	uint32_t *leaf_first_patch; // per leaf + 1, range in leaf_patches
+	uint32_t *leaf_patches;	    // patch indices
+	bsp_trace_brush_t *brushes; // per brush
+	bsp_trace_plane_t *planes;  // per brush side
+	uint8_t *signbits;	    // per brush side, bit per negative normal axis
+	uint8_t *types;		    // per brush side, axis if axial
+	int32_t *surface_flags;	    // per brush side, of the side texture
+	uint8_t *plane_types;	    // per map plane, axis if axial
+} bsp_trace_brushes_t;
+
+// Node planes on the path to a leaf that cut its bounds, built at load.
+// Inside the bounds and on the leaf side of these means inside the leaf.
+typedef struct bsp_point_leaf_t
+{
+	uint32_t first_plane;
+	uint32_t num_planes;
+} bsp_point_leaf_t;
+
+typedef struct bsp_point_leaves_t
+{
+	bsp_point_leaf_t *leaves;     // per leaf
+	gs_dyn_array(int32_t) planes; // map plane index, ~index if the leaf is behind it
+} bsp_point_leaves_t;
+
 /*
 typedef struct bsp_leaf_renderable_t
 {
@@ -240,7 +452,7 @@ typedef struct bsp_face_lump_t
 
 typedef struct bsp_lightmap_lump_t
 {
-	char map[128 * 128 * 3];
+	char map[BSP_LIGHTMAP_SIZE * BSP_LIGHTMAP_SIZE * 3];
 } bsp_lightmap_lump_t;
 
 typedef struct bsp_lightvol_lump_t
@@ -386,10 +598,16 @@ typedef struct bsp_map_t
 
 	bsp_visdata_lump_t visdata;
 
+	void *file_mapping; // whole file if memory mapped, lumps may point into it
+	size_t file_mapping_size;
+	uint32_t mapped_lumps; // bit per bsp_lump_types pointing into file_mapping
+
 	/*==== Runtime data ====*/
 
 	char *name;
 	bool32_t valid;
+	bool32_t from_cache;	// entities, faces, patches and vertex arrays from a .bspc
+	bool32_t gpu_resources; // graphics objects created, false for offline compiles
 	bsp_stats_t stats;
 	gs_dyn_array(bsp_patch_t) patches;
 	gs_dyn_array(bsp_face_renderable_t) render_faces;
@@ -398,6 +616,7 @@ typedef struct bsp_map_t
 	{
 		uint32_t count;
 		gs_asset_texture_t **data;
+		uint32_t *handles; // texture manager handles, MG_NAME_MAP_INVALID if not requested
 	} texture_assets;
 
 	struct
@@ -406,23 +625,46 @@ typedef struct bsp_map_t
 		gs_handle(gs_graphics_texture_t) * data;
 	} lightmap_textures;
 
+	bsp_lightmap_atlas_t lightmap_atlas;
+	bsp_material_table_t material_table;
+	bool32_t material_arrays; // r_texture_arrays at map load
+
 	gs_handle(gs_graphics_texture_t) missing_texture;
 	gs_handle(gs_graphics_texture_t) missing_lm_texture;
 
 	int32_t previous_leaf;
+	bsp_vis_t vis;
+	bsp_pvs_cache_t pvs_cache;
+	gs_dyn_array(int32_t) node_parents;
+	gs_dyn_array(int32_t) leaf_parents;
+	bsp_draw_list_t draw_list;
+	mg_bitset_t visible_faces; // per render face, this frame (cluster_draw: only with debug overlay open)
+	mg_bitset_t surface_faces; // polygon and mesh render faces
+	mg_bitset_t patch_faces;   // patch render faces
+	bsp_cluster_draws_t cluster_draws;
+	bsp_occlusion_t occlusion;
+	bool32_t cluster_draw;		    // r_cluster_draw at map load
+	bsp_trace_scratch_t *trace_scratch; // per job manager thread
+	bsp_trace_brushes_t trace_brushes;
+	bsp_point_leaves_t point_leaves;
 
 	gs_dyn_array(bsp_entity_t) entities;
 
 	gs_handle(gs_graphics_vertex_buffer_t) bsp_graphics_vbo;
+	gs_handle(gs_graphics_vertex_buffer_t) bsp_graphics_layer_vbo;
 	gs_handle(gs_graphics_index_buffer_t) bsp_graphics_ibo;
+	gs_handle(gs_graphics_index_buffer_t) bsp_graphics_cluster_ibo;
 	gs_handle(gs_graphics_pipeline_t) bsp_graphics_pipe;
+	gs_handle(gs_graphics_pipeline_t) bsp_graphics_layered_pipe;
 	gs_handle(gs_graphics_pipeline_t) bsp_graphics_wire_pipe;
 	gs_handle(gs_graphics_uniform_t) bsp_graphics_u_proj;
 	gs_handle(gs_graphics_uniform_t) bsp_graphics_u_tex;
 	gs_handle(gs_graphics_uniform_t) bsp_graphics_u_lm;
 	gs_handle(gs_graphics_uniform_t) bsp_graphics_u_color;
+	gs_handle(gs_graphics_uniform_t) bsp_graphics_u_layers;
 	gs_dyn_array(uint32_t) bsp_graphics_index_arr;
 	gs_dyn_array(bsp_vert_lump_t) bsp_graphics_vert_arr;
+	gs_dyn_array(float) bsp_graphics_layer_arr;
 } bsp_map_t;
 
 #endif // BSP_TYPES_H
\ No newline at end of file
@@ -0,0 +1,214 @@
+/*================================================================
+	* bsp/bsp_unstuck.c
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Finds the nearest free position for a box stuck in solid
+	by testing the closest points of nearby empty leaves
+	and the shortest pushes out of overlapping brushes.
+=================================================================*/
+
+#include "bsp_unstuck.h"
+#include "../util/math.h"
+#include "bsp_point.h"
+#include "bsp_trace.h"
+
+// Nearest position to place the box in open space.
+// Candidates come from the leaves and brushes around the box,
+// rejected cheaply by point contents before any box traces.
+bsp_unstuck_result_t bsp_unstuck(bsp_map_t *map, gs_vec3 position, gs_vec3 mins, gs_vec3 maxs, int32_t content_mask)
+{
+	bsp_unstuck_result_t result = {.position = position};
+	bsp_unstuck_candidate_t candidates[BSP_UNSTUCK_MAX_CANDIDATES];
+	uint32_t count = _bsp_unstuck_gather(map, position, mins, maxs, content_mask, candidates, &result.leaves);
+
+	gs_vec3 center	   = gs_vec3_scale(gs_vec3_add(mins, maxs), 0.5f);
+	bsp_trace_t trace  = {.map = map};
+	int32_t leaf_cache = 0; // candidates are close together
+	for (uint32_t i = 0; i < count && result.traces < BSP_UNSTUCK_MAX_BOX_TESTS; i++)
+	{
+		gs_vec3 candidate = candidates[i].position;
+
+		// Where we already are is stuck
+		if (candidates[i].dist2 < GS_EPSILON)
+		{
+			continue;
+		}
+
+		result.point_tests++;
+		if (!_bsp_unstuck_point_free(map, gs_vec3_add(candidate, center), content_mask, &leaf_cache))
+		{
+			continue;
+		}
+
+		result.traces++;
+		bsp_trace_box(&trace, candidate, candidate, mins, maxs, content_mask);
+		if (trace.start_solid)
+		{
+			continue;
+		}
+
+		// Slide back towards the stuck position to move as little as possible
+		result.traces++;
+		bsp_trace_box(&trace, candidate, position, mins, maxs, content_mask);
+		result.found	= true;
+		result.position = trace.start_solid ? candidate : trace.end;
+		break;
+	}
+
+	return result;
+}
+
+// Closest box position in each empty leaf touching the search radius,
+// and just outside each side of brushes the box overlaps.
+// Sorted nearest first, returns the number of candidates.
+uint32_t _bsp_unstuck_gather(bsp_map_t *map, gs_vec3 position, gs_vec3 mins, gs_vec3 maxs, int32_t content_mask, bsp_unstuck_candidate_t *candidates, uint32_t *num_leaves)
+{
+	gs_vec3 box_min	   = gs_vec3_add(position, mins);
+	gs_vec3 box_max	   = gs_vec3_add(position, maxs);
+	gs_vec3 radius	   = gs_v3(BSP_UNSTUCK_RADIUS, BSP_UNSTUCK_RADIUS, BSP_UNSTUCK_RADIUS);
+	gs_vec3 search_min = gs_vec3_sub(box_min, radius);
+	gs_vec3 search_max = gs_vec3_add(box_max, radius);
+
+	int32_t stack[BSP_TRACE_STACK_SIZE];
+	uint32_t stack_size = 0;
+	uint32_t count	    = 0;
+	*num_leaves	    = 0;
+	stack[stack_size++] = 0;
+
+	while (stack_size > 0)
+	{
+		int32_t index = stack[--stack_size];
+		int32_t *node_mins;
+		int32_t *node_maxs;
+		if (index >= 0)
+		{
+			node_mins = map->nodes.data[index].mins;
+			node_maxs = map->nodes.data[index].maxs;
+		}
+		else
+		{
+			node_mins = map->leaves.data[~index].mins;
+			node_maxs = map->leaves.data[~index].maxs;
+		}
+
+		if (!_bsp_unstuck_overlap(node_mins, node_maxs, search_min, search_max))
+		{
+			continue;
+		}
+
+		if (index >= 0)
+		{
+			if (stack_size + 2 <= BSP_TRACE_STACK_SIZE)
+			{
+				stack[stack_size++] = map->nodes.data[index].children[0];
+				stack[stack_size++] = map->nodes.data[index].children[1];
+			}
+			continue;
+		}
+
+		// Solid and outside leaves have no cluster
+		bsp_leaf_lump_t *leaf = &map->leaves.data[~index];
+		if (leaf->cluster < 0)
+		{
+			continue;
+		}
+		(*num_leaves)++;
+
+		// Clamp into the leaf, or center on it if the box doesn't fit
+		gs_vec3 candidate;
+		for (size_t j = 0; j < 3; j++)
+		{
+			float32_t lo = leaf->mins[j] - mins.xyz[j];
+			float32_t hi = leaf->maxs[j] - maxs.xyz[j];
+			if (lo <= hi)
+			{
+				candidate.xyz[j] = gs_clamp(position.xyz[j], lo, hi);
+			}
+			else
+			{
+				candidate.xyz[j] = (lo + hi) * 0.5f;
+			}
+		}
+		_bsp_unstuck_add(candidates, &count, position, candidate);
+
+		if (!_bsp_unstuck_overlap(leaf->mins, leaf->maxs, box_min, box_max))
+		{
+			continue;
+		}
+
+		// Shortest pushes out of the brushes we're stuck in
+		const bsp_trace_brushes_t *packed = &map->trace_brushes;
+		for (int32_t i = 0; i < leaf->num_leaf_brushes; i++)
+		{
+			const bsp_trace_brush_t *brush = &packed->brushes[map->leaf_brushes.data[leaf->first_leaf_brush + i].brush];
+			if (brush->num_planes == 0 || (brush->contents & content_mask) == 0)
+			{
+				continue;
+			}
+
+			for (size_t j = 0; j < 3; j++)
+			{
+				candidate	 = position;
+				candidate.xyz[j] = brush->maxs[j] - mins.xyz[j] + BSP_TRACE_BRUSH_MARGIN;
+				_bsp_unstuck_add(candidates, &count, position, candidate);
+				candidate.xyz[j] = brush->mins[j] - maxs.xyz[j] - BSP_TRACE_BRUSH_MARGIN;
+				_bsp_unstuck_add(candidates, &count, position, candidate);
+			}
+		}
+	}
+
+	return count;
+}
+
+// Inserts sorted by distance, dropping duplicates and the farthest when full
+void _bsp_unstuck_add(bsp_unstuck_candidate_t *candidates, uint32_t *count, gs_vec3 position, gs_vec3 candidate)
+{
+	float32_t dist2 = gs_vec3_len2(gs_vec3_sub(candidate, position));
+	if (dist2 > BSP_UNSTUCK_RADIUS * BSP_UNSTUCK_RADIUS)
+	{
+		return;
+	}
+
+	if (*count == BSP_UNSTUCK_MAX_CANDIDATES && dist2 >= candidates[*count - 1].dist2)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < *count; i++)
+	{
+		if (candidates[i].dist2 == dist2 && memcmp(&candidates[i].position, &candidate, sizeof(gs_vec3)) == 0)
+		{
+			return;
+		}
+	}
+
+	uint32_t i = gs_min(*count, BSP_UNSTUCK_MAX_CANDIDATES - 1);
+	while (i > 0 && candidates[i - 1].dist2 > dist2)
+	{
+		candidates[i] = candidates[i - 1];
+		i--;
+	}
+	candidates[i] = (bsp_unstuck_candidate_t){.position = candidate, .dist2 = dist2};
+	*count	      = gs_min(*count + 1, BSP_UNSTUCK_MAX_CANDIDATES);
+}
+
+bool32_t _bsp_unstuck_overlap(const int32_t *mins, const int32_t *maxs, gs_vec3 box_min, gs_vec3 box_max)
+{
+	return mins[0] <= box_max.x && maxs[0] >= box_min.x
+	    && mins[1] <= box_max.y && maxs[1] >= box_min.y
+	    && mins[2] <= box_max.z && maxs[2] >= box_min.z;
+}
+
+// False if the point is inside a brush matching content_mask or outside the map
+bool32_t _bsp_unstuck_point_free(bsp_map_t *map, gs_vec3 point, int32_t content_mask, int32_t *leaf_cache)
+{
+	int32_t leaf = bsp_point_leaf(map, point, leaf_cache);
+	if (map->leaves.data[leaf].cluster < 0)
+	{
+		return false;
+	}
+
+	return (_bsp_point_leaf_contents(map, leaf, point) & content_mask) == 0;
+}
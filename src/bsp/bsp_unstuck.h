@@ -0,0 +1,44 @@
+/*================================================================
+	* bsp/bsp_unstuck.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Finds the nearest free position for a box stuck in solid
+	by testing the closest points of nearby empty leaves
+	and the shortest pushes out of overlapping brushes.
+=================================================================*/
+
+#ifndef BSP_UNSTUCK_H
+#define BSP_UNSTUCK_H
+
+#include <gs/gs.h>
+
+#include "bsp_types.h"
+
+#define BSP_UNSTUCK_RADIUS	   256.0f // search distance from the stuck position
+#define BSP_UNSTUCK_MAX_CANDIDATES 32	  // nearest positions kept
+#define BSP_UNSTUCK_MAX_BOX_TESTS  8	  // box traces before giving up
+
+typedef struct bsp_unstuck_result_t
+{
+	bool32_t found;
+	gs_vec3 position;
+	uint32_t leaves;      // empty leaves in range
+	uint32_t point_tests; // candidates checked against leaf brushes
+	uint32_t traces;      // box traces
+} bsp_unstuck_result_t;
+
+typedef struct bsp_unstuck_candidate_t
+{
+	gs_vec3 position;
+	float32_t dist2;
+} bsp_unstuck_candidate_t;
+
+bsp_unstuck_result_t bsp_unstuck(bsp_map_t *map, gs_vec3 position, gs_vec3 mins, gs_vec3 maxs, int32_t content_mask);
+uint32_t _bsp_unstuck_gather(bsp_map_t *map, gs_vec3 position, gs_vec3 mins, gs_vec3 maxs, int32_t content_mask, bsp_unstuck_candidate_t *candidates, uint32_t *num_leaves);
+void _bsp_unstuck_add(bsp_unstuck_candidate_t *candidates, uint32_t *count, gs_vec3 position, gs_vec3 candidate);
+bool32_t _bsp_unstuck_overlap(const int32_t *mins, const int32_t *maxs, gs_vec3 box_min, gs_vec3 box_max);
+bool32_t _bsp_unstuck_point_free(bsp_map_t *map, gs_vec3 point, int32_t content_mask, int32_t *leaf_cache);
+
+#endif // BSP_UNSTUCK_H
@@ -0,0 +1,159 @@
+/*================================================================
+	* bsp/bsp_vis.c
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Cluster visibility queries.
+	Visdata is unpacked into word aligned rows at map load,
+	hearable sets are derived from it on first use.
+=================================================================*/
+
+#include "bsp_vis.h"
+
+// Maps without visdata see every cluster from every cluster.
+void bsp_vis_init(bsp_vis_t *vis, const bsp_map_t *map)
+{
+	int32_t num_clusters = map->visdata.num_vecs;
+	if (num_clusters <= 0)
+	{
+		num_clusters = 0;
+		for (size_t i = 0; i < map->leaves.count; i++)
+		{
+			num_clusters = gs_max(num_clusters, map->leaves.data[i].cluster + 1);
+		}
+	}
+
+	*vis = (bsp_vis_t){
+		.num_clusters = num_clusters,
+		.stride	      = gs_max((num_clusters + 63) / 64, 1),
+	};
+
+	size_t row_bytes = vis->stride * sizeof(uint64_t);
+	vis->pvs	 = gs_calloc(gs_max(num_clusters, 1), row_bytes);
+	vis->phs	 = gs_calloc(gs_max(num_clusters, 1), row_bytes);
+	vis->all	 = gs_calloc(1, row_bytes);
+	mg_bitset_init(&vis->phs_valid, num_clusters);
+
+	for (int32_t i = 0; i < num_clusters; i++)
+	{
+		vis->all[i >> 6] |= 1ull << (i & 63);
+	}
+
+	if (map->visdata.num_vecs <= 0)
+	{
+		for (int32_t i = 0; i < num_clusters; i++)
+		{
+			memcpy(vis->pvs + i * vis->stride, vis->all, row_bytes);
+		}
+		return;
+	}
+
+	// Bytes to little endian words, bit b of byte k is cluster k * 8 + b
+	for (int32_t i = 0; i < num_clusters; i++)
+	{
+		const uint8_t *src = (const uint8_t *)map->visdata.vecs + i * map->visdata.size_vecs;
+		uint64_t *dst	   = vis->pvs + i * vis->stride;
+		for (int32_t k = 0; k < map->visdata.size_vecs && k < vis->stride * 8; k++)
+		{
+			dst[k >> 3] |= (uint64_t)src[k] << ((k & 7) * 8);
+		}
+
+		// Padding bits past the last cluster
+		for (uint32_t w = 0; w < vis->stride; w++)
+		{
+			dst[w] &= vis->all[w];
+		}
+	}
+}
+
+void bsp_vis_free(bsp_vis_t *vis)
+{
+	gs_free(vis->pvs);
+	gs_free(vis->phs);
+	gs_free(vis->all);
+	mg_bitset_free(&vis->phs_valid);
+	vis->pvs	  = NULL;
+	vis->phs	  = NULL;
+	vis->all	  = NULL;
+	vis->num_clusters = 0;
+}
+
+// Sounds in a cluster can be heard from any cluster
+// that sees a cluster visible from it.
+bool32_t bsp_cluster_can_hear(bsp_vis_t *vis, int32_t from, int32_t to)
+{
+	if (to < 0 || to >= (int32_t)vis->num_clusters)
+	{
+		return false;
+	}
+
+	if (from < 0 || from >= (int32_t)vis->num_clusters)
+	{
+		return true;
+	}
+
+	if (!mg_bitset_test(&vis->phs_valid, from))
+	{
+		_bsp_vis_build_phs_row(vis, from);
+	}
+
+	return (vis->phs[from * vis->stride + (to >> 6)] >> (to & 63)) & 1;
+}
+
+// View into the PVS row of a cluster, valid until vis is freed.
+mg_bitset_t bsp_vis_pvs(const bsp_vis_t *vis, int32_t cluster)
+{
+	mg_bitset_t row = {
+		.count	   = vis->num_clusters,
+		.num_words = vis->stride,
+		.words	   = vis->all,
+	};
+
+	if (cluster >= 0 && cluster < (int32_t)vis->num_clusters)
+	{
+		row.words = vis->pvs + cluster * vis->stride;
+	}
+
+	return row;
+}
+
+// View into the PHS row of a cluster, valid until vis is freed.
+mg_bitset_t bsp_vis_phs(bsp_vis_t *vis, int32_t cluster)
+{
+	mg_bitset_t row = {
+		.count	   = vis->num_clusters,
+		.num_words = vis->stride,
+		.words	   = vis->all,
+	};
+
+	if (cluster >= 0 && cluster < (int32_t)vis->num_clusters)
+	{
+		if (!mg_bitset_test(&vis->phs_valid, cluster))
+		{
+			_bsp_vis_build_phs_row(vis, cluster);
+		}
+		row.words = vis->phs + cluster * vis->stride;
+	}
+
+	return row;
+}
+
+// Union of the PVS rows of every cluster visible from this one.
+void _bsp_vis_build_phs_row(bsp_vis_t *vis, int32_t cluster)
+{
+	mg_bitset_t pvs = bsp_vis_pvs(vis, cluster);
+	uint64_t *dst	= vis->phs + cluster * vis->stride;
+
+	memcpy(dst, pvs.words, vis->stride * sizeof(uint64_t));
+	for (int32_t i = mg_bitset_next(&pvs, 0); i >= 0; i = mg_bitset_next(&pvs, i + 1))
+	{
+		const uint64_t *src = vis->pvs + i * vis->stride;
+		for (uint32_t w = 0; w < vis->stride; w++)
+		{
+			dst[w] |= src[w];
+		}
+	}
+
+	mg_bitset_set(&vis->phs_valid, cluster);
+}
@@ -0,0 +1,45 @@
+/*================================================================
+	* bsp/bsp_vis.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Cluster visibility queries.
+	Visdata is unpacked into word aligned rows at map load,
+	hearable sets are derived from it on first use.
+
+	Clusters visible from a cluster:
+	mg_bitset_t pvs = bsp_vis_pvs(&map->vis, cluster);
+	for (int32_t i = mg_bitset_next(&pvs, 0); i >= 0; i = mg_bitset_next(&pvs, i + 1))
+=================================================================*/
+
+#ifndef BSP_VIS_H
+#define BSP_VIS_H
+
+#include "bsp_types.h"
+
+void bsp_vis_init(bsp_vis_t *vis, const bsp_map_t *map);
+void bsp_vis_free(bsp_vis_t *vis);
+bool32_t bsp_cluster_can_hear(bsp_vis_t *vis, int32_t from, int32_t to);
+mg_bitset_t bsp_vis_pvs(const bsp_vis_t *vis, int32_t cluster);
+mg_bitset_t bsp_vis_phs(bsp_vis_t *vis, int32_t cluster);
+void _bsp_vis_build_phs_row(bsp_vis_t *vis, int32_t cluster);
+
+// Invalid target clusters are never visible,
+// everything is visible from outside the map.
+static inline bool32_t bsp_cluster_can_see(const bsp_vis_t *vis, int32_t from, int32_t to)
+{
+	if (to < 0 || to >= (int32_t)vis->num_clusters)
+	{
+		return false;
+	}
+
+	if (from < 0 || from >= (int32_t)vis->num_clusters)
+	{
+		return true;
+	}
+
+	return (vis->pvs[from * vis->stride + (to >> 6)] >> (to & 63)) & 1;
+}
+
+#endif // BSP_VIS_H
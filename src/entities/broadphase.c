@@ -0,0 +1,418 @@
+/*================================================================
+	* entities/broadphase.c
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Uniform hash grid of entity bounds for
+	swept box and sphere queries between entities.
+=================================================================*/
+
+#include "broadphase.h"
+#include "../game/console.h"
+
+static inline bool32_t _mg_broadphase_overlap(gs_vec3 a_mins, gs_vec3 a_maxs, gs_vec3 b_mins, gs_vec3 b_maxs)
+{
+	return a_mins.x <= b_maxs.x && a_maxs.x >= b_mins.x
+	       && a_mins.y <= b_maxs.y && a_maxs.y >= b_mins.y
+	       && a_mins.z <= b_maxs.z && a_maxs.z >= b_mins.z;
+}
+
+void mg_broadphase_init(mg_broadphase_t *bp)
+{
+	*bp		  = (mg_broadphase_t){0};
+	bp->proxies	  = gs_dyn_array_new(mg_broadphase_proxy_t);
+	bp->free_proxies  = gs_dyn_array_new(uint32_t);
+	bp->large_proxies = gs_dyn_array_new(uint32_t);
+	bp->candidates	  = gs_dyn_array_new(uint32_t);
+	bp->results	  = gs_dyn_array_new(void *);
+	for (size_t i = 0; i < MG_BROADPHASE_BUCKETS; i++)
+	{
+		bp->buckets[i] = gs_dyn_array_new(uint32_t);
+	}
+}
+
+void mg_broadphase_free(mg_broadphase_t *bp)
+{
+	gs_dyn_array_free(bp->proxies);
+	gs_dyn_array_free(bp->free_proxies);
+	gs_dyn_array_free(bp->large_proxies);
+	gs_dyn_array_free(bp->candidates);
+	gs_dyn_array_free(bp->results);
+	for (size_t i = 0; i < MG_BROADPHASE_BUCKETS; i++)
+	{
+		gs_dyn_array_free(bp->buckets[i]);
+	}
+	*bp = (mg_broadphase_t){0};
+}
+
+// Returns a handle for move and remove
+uint32_t mg_broadphase_add(mg_broadphase_t *bp, void *user, gs_vec3 mins, gs_vec3 maxs)
+{
+	mg_broadphase_proxy_t proxy = {
+		.user	= user,
+		.mins	= mins,
+		.maxs	= maxs,
+		.active = true,
+	};
+
+	uint32_t index;
+	if (gs_dyn_array_size(bp->free_proxies) > 0)
+	{
+		index = bp->free_proxies[gs_dyn_array_size(bp->free_proxies) - 1];
+		gs_dyn_array_pop(bp->free_proxies);
+		bp->proxies[index] = proxy;
+	}
+	else
+	{
+		index = gs_dyn_array_size(bp->proxies);
+		gs_dyn_array_push(bp->proxies, proxy);
+	}
+
+	_mg_broadphase_cells(mins, maxs, bp->proxies[index].cell_mins, bp->proxies[index].cell_maxs);
+	_mg_broadphase_link(bp, index);
+	bp->num_active++;
+
+	return index;
+}
+
+// Relinks only if the covered cells change
+void mg_broadphase_move(mg_broadphase_t *bp, uint32_t proxy, gs_vec3 mins, gs_vec3 maxs)
+{
+	mg_broadphase_proxy_t *p = &bp->proxies[proxy];
+	p->mins			 = mins;
+	p->maxs			 = maxs;
+
+	int32_t cell_mins[3];
+	int32_t cell_maxs[3];
+	_mg_broadphase_cells(mins, maxs, cell_mins, cell_maxs);
+	if (memcmp(cell_mins, p->cell_mins, sizeof(cell_mins)) == 0 && memcmp(cell_maxs, p->cell_maxs, sizeof(cell_maxs)) == 0)
+	{
+		return;
+	}
+
+	_mg_broadphase_unlink(bp, proxy);
+	memcpy(p->cell_mins, cell_mins, sizeof(cell_mins));
+	memcpy(p->cell_maxs, cell_maxs, sizeof(cell_maxs));
+	_mg_broadphase_link(bp, proxy);
+}
+
+void mg_broadphase_remove(mg_broadphase_t *bp, uint32_t proxy)
+{
+	if (proxy >= gs_dyn_array_size(bp->proxies) || !bp->proxies[proxy].active)
+	{
+		mg_println("WARN: mg_broadphase_remove invalid proxy %u", proxy);
+		return;
+	}
+
+	_mg_broadphase_unlink(bp, proxy);
+	bp->proxies[proxy].active = false;
+	bp->proxies[proxy].user	  = NULL;
+	gs_dyn_array_push(bp->free_proxies, proxy);
+	bp->num_active--;
+}
+
+// Sweeps a box against proxy bounds up to max_fraction.
+// Returns the user of the closest hit and sets fraction and normal,
+// NULL if nothing was hit.
+void *mg_broadphase_sweep(mg_broadphase_t *bp, gs_vec3 start, gs_vec3 end, gs_vec3 mins, gs_vec3 maxs, float32_t max_fraction, const void *ignore, float32_t *fraction, gs_vec3 *normal)
+{
+	// Clipping counts hits within epsilon
+	gs_vec3 margin	   = gs_v3(BSP_TRACE_EPSILON, BSP_TRACE_EPSILON, BSP_TRACE_EPSILON);
+	gs_vec3 sweep_mins = gs_vec3_sub(gs_vec3_add(gs_v3(fminf(start.x, end.x), fminf(start.y, end.y), fminf(start.z, end.z)), mins), margin);
+	gs_vec3 sweep_maxs = gs_vec3_add(gs_vec3_add(gs_v3(fmaxf(start.x, end.x), fmaxf(start.y, end.y), fmaxf(start.z, end.z)), maxs), margin);
+	_mg_broadphase_gather(bp, sweep_mins, sweep_maxs);
+
+	void *hit      = NULL;
+	*fraction      = max_fraction;
+	uint32_t count = gs_dyn_array_size(bp->candidates);
+	for (size_t i = 0; i < count; i++)
+	{
+		mg_broadphase_proxy_t *p = &bp->proxies[bp->candidates[i]];
+		if (p->user == ignore)
+		{
+			continue;
+		}
+
+		// Box against proxy is a point against proxy grown by the box
+		float32_t proxy_fraction;
+		gs_vec3 proxy_normal;
+		if (_mg_broadphase_sweep_aabb(start, end, gs_vec3_sub(p->mins, maxs), gs_vec3_sub(p->maxs, mins), &proxy_fraction, &proxy_normal) && proxy_fraction < *fraction)
+		{
+			hit	  = p->user;
+			*fraction = proxy_fraction;
+			*normal	  = proxy_normal;
+		}
+	}
+
+	return hit;
+}
+
+// Box trace through the map and proxies, trace gets the closer hit.
+// Returns the hit user if a proxy was closer than the world.
+void *mg_broadphase_trace(mg_broadphase_t *bp, bsp_trace_t *trace, gs_vec3 start, gs_vec3 end, gs_vec3 mins, gs_vec3 maxs, int32_t content_mask, const void *ignore)
+{
+	bsp_trace_box(trace, start, end, mins, maxs, content_mask);
+
+	float32_t fraction;
+	gs_vec3 normal;
+	void *hit = mg_broadphase_sweep(bp, start, end, mins, maxs, trace->fraction, ignore, &fraction, &normal);
+	if (hit == NULL)
+	{
+		return NULL;
+	}
+
+	trace->fraction	     = fraction;
+	trace->normal	     = normal;
+	trace->end	     = gs_vec3_add(start, gs_vec3_scale(gs_vec3_sub(end, start), fraction));
+	trace->contents	     = 0;
+	trace->surface_flags = 0;
+	return hit;
+}
+
+// Collects users of proxies touching the sphere into bp->results
+uint32_t mg_broadphase_query_sphere(mg_broadphase_t *bp, gs_vec3 center, float32_t radius)
+{
+	gs_vec3 extents = gs_v3(radius, radius, radius);
+	_mg_broadphase_gather(bp, gs_vec3_sub(center, extents), gs_vec3_add(center, extents));
+
+	gs_dyn_array_clear(bp->results);
+	uint32_t count = gs_dyn_array_size(bp->candidates);
+	for (size_t i = 0; i < count; i++)
+	{
+		mg_broadphase_proxy_t *p = &bp->proxies[bp->candidates[i]];
+
+		// Distance to the closest point in bounds
+		float32_t dist2 = 0;
+		for (size_t j = 0; j < 3; j++)
+		{
+			float32_t d = fmaxf(fmaxf(p->mins.xyz[j] - center.xyz[j], 0), center.xyz[j] - p->maxs.xyz[j]);
+			dist2 += d * d;
+		}
+
+		if (dist2 <= radius * radius)
+		{
+			gs_dyn_array_push(bp->results, p->user);
+		}
+	}
+
+	return gs_dyn_array_size(bp->results);
+}
+
+void _mg_broadphase_cells(gs_vec3 mins, gs_vec3 maxs, int32_t *cell_mins, int32_t *cell_maxs)
+{
+	for (size_t i = 0; i < 3; i++)
+	{
+		cell_mins[i] = (int32_t)floorf(mins.xyz[i] / MG_BROADPHASE_CELL_SIZE);
+		cell_maxs[i] = (int32_t)floorf(maxs.xyz[i] / MG_BROADPHASE_CELL_SIZE);
+	}
+}
+
+uint32_t _mg_broadphase_num_cells(const int32_t *cell_mins, const int32_t *cell_maxs)
+{
+	uint64_t count = 1;
+	for (size_t i = 0; i < 3; i++)
+	{
+		count *= (uint64_t)(cell_maxs[i] - cell_mins[i] + 1);
+	}
+	return (uint32_t)gs_min(count, UINT32_MAX);
+}
+
+uint32_t _mg_broadphase_hash(int32_t x, int32_t y, int32_t z)
+{
+	uint32_t h = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+	return h & (MG_BROADPHASE_BUCKETS - 1);
+}
+
+void _mg_broadphase_link(mg_broadphase_t *bp, uint32_t proxy)
+{
+	mg_broadphase_proxy_t *p = &bp->proxies[proxy];
+	p->large		 = _mg_broadphase_num_cells(p->cell_mins, p->cell_maxs) > MG_BROADPHASE_MAX_PROXY_CELLS;
+	if (p->large)
+	{
+		gs_dyn_array_push(bp->large_proxies, proxy);
+		return;
+	}
+
+	for (int32_t x = p->cell_mins[0]; x <= p->cell_maxs[0]; x++)
+	{
+		for (int32_t y = p->cell_mins[1]; y <= p->cell_maxs[1]; y++)
+		{
+			for (int32_t z = p->cell_mins[2]; z <= p->cell_maxs[2]; z++)
+			{
+				gs_dyn_array_push(bp->buckets[_mg_broadphase_hash(x, y, z)], proxy);
+			}
+		}
+	}
+}
+
+// Cells can hash to the same bucket, removes one entry per cell
+static inline void _mg_broadphase_bucket_remove(gs_dyn_array(uint32_t) bucket, uint32_t proxy)
+{
+	uint32_t size = gs_dyn_array_size(bucket);
+	for (size_t i = 0; i < size; i++)
+	{
+		if (bucket[i] == proxy)
+		{
+			bucket[i] = bucket[size - 1];
+			gs_dyn_array_pop(bucket);
+			return;
+		}
+	}
+}
+
+void _mg_broadphase_unlink(mg_broadphase_t *bp, uint32_t proxy)
+{
+	mg_broadphase_proxy_t *p = &bp->proxies[proxy];
+	if (p->large)
+	{
+		_mg_broadphase_bucket_remove(bp->large_proxies, proxy);
+		return;
+	}
+
+	for (int32_t x = p->cell_mins[0]; x <= p->cell_maxs[0]; x++)
+	{
+		for (int32_t y = p->cell_mins[1]; y <= p->cell_maxs[1]; y++)
+		{
+			for (int32_t z = p->cell_mins[2]; z <= p->cell_maxs[2]; z++)
+			{
+				_mg_broadphase_bucket_remove(bp->buckets[_mg_broadphase_hash(x, y, z)], proxy);
+			}
+		}
+	}
+}
+
+// Fills bp->candidates with unique active proxies overlapping the bounds
+void _mg_broadphase_gather(mg_broadphase_t *bp, gs_vec3 mins, gs_vec3 maxs)
+{
+	gs_dyn_array_clear(bp->candidates);
+
+	bp->stamp++;
+	if (bp->stamp == 0)
+	{
+		for (size_t i = 0; i < gs_dyn_array_size(bp->proxies); i++)
+		{
+			bp->proxies[i].stamp = 0;
+		}
+		bp->stamp = 1;
+	}
+
+	int32_t cell_mins[3];
+	int32_t cell_maxs[3];
+	_mg_broadphase_cells(mins, maxs, cell_mins, cell_maxs);
+
+	if (_mg_broadphase_num_cells(cell_mins, cell_maxs) > MG_BROADPHASE_MAX_QUERY_CELLS)
+	{
+		// Cheaper to test everything than to visit the cells
+		for (size_t i = 0; i < gs_dyn_array_size(bp->proxies); i++)
+		{
+			mg_broadphase_proxy_t *p = &bp->proxies[i];
+			if (p->active && _mg_broadphase_overlap(p->mins, p->maxs, mins, maxs))
+			{
+				gs_dyn_array_push(bp->candidates, i);
+			}
+		}
+		return;
+	}
+
+	for (int32_t x = cell_mins[0]; x <= cell_maxs[0]; x++)
+	{
+		for (int32_t y = cell_mins[1]; y <= cell_maxs[1]; y++)
+		{
+			for (int32_t z = cell_mins[2]; z <= cell_maxs[2]; z++)
+			{
+				gs_dyn_array(uint32_t) bucket = bp->buckets[_mg_broadphase_hash(x, y, z)];
+				for (size_t i = 0; i < gs_dyn_array_size(bucket); i++)
+				{
+					mg_broadphase_proxy_t *p = &bp->proxies[bucket[i]];
+					if (p->stamp == bp->stamp)
+					{
+						continue;
+					}
+					p->stamp = bp->stamp;
+
+					if (_mg_broadphase_overlap(p->mins, p->maxs, mins, maxs))
+					{
+						gs_dyn_array_push(bp->candidates, bucket[i]);
+					}
+				}
+			}
+		}
+	}
+
+	for (size_t i = 0; i < gs_dyn_array_size(bp->large_proxies); i++)
+	{
+		mg_broadphase_proxy_t *p = &bp->proxies[bp->large_proxies[i]];
+		if (_mg_broadphase_overlap(p->mins, p->maxs, mins, maxs))
+		{
+			gs_dyn_array_push(bp->candidates, bp->large_proxies[i]);
+		}
+	}
+}
+
+// Point sweep against bounds, clipped like brushes in bsp_trace.
+// Starting inside hits at fraction 0 with a zero normal.
+bool32_t _mg_broadphase_sweep_aabb(gs_vec3 start, gs_vec3 end, gs_vec3 mins, gs_vec3 maxs, float32_t *fraction, gs_vec3 *normal)
+{
+	float32_t start_fraction = -1.0f;
+	float32_t end_fraction	 = 1.0f;
+	bool32_t starts_out	 = false;
+	gs_vec3 clip_normal	 = gs_v3(0, 0, 0);
+
+	for (size_t i = 0; i < 6; i++)
+	{
+		size_t axis		 = i >> 1;
+		float32_t sign		 = (i & 1) ? 1.0f : -1.0f;
+		float32_t dist		 = (i & 1) ? maxs.xyz[axis] : -mins.xyz[axis];
+		float32_t start_distance = sign * start.xyz[axis] - dist;
+		float32_t end_distance	 = sign * end.xyz[axis] - dist;
+
+		if (start_distance > 0)
+		{
+			starts_out = true;
+		}
+
+		if (start_distance > 0 && (end_distance >= BSP_TRACE_EPSILON || end_distance >= start_distance))
+		{
+			return false;
+		}
+		if (start_distance <= 0 && end_distance <= 0)
+		{
+			continue;
+		}
+
+		if (start_distance > end_distance)
+		{
+			// Entering
+			float32_t f = fmaxf(0.0f, (start_distance - BSP_TRACE_EPSILON) / (start_distance - end_distance));
+			if (f > start_fraction)
+			{
+				start_fraction	      = f;
+				clip_normal	      = gs_v3(0, 0, 0);
+				clip_normal.xyz[axis] = sign;
+			}
+		}
+		else
+		{
+			// Leaving
+			float32_t f  = fminf(1.0f, (start_distance + BSP_TRACE_EPSILON) / (start_distance - end_distance));
+			end_fraction = fminf(end_fraction, f);
+		}
+	}
+
+	if (!starts_out)
+	{
+		*fraction = 0;
+		*normal	  = gs_v3(0, 0, 0);
+		return true;
+	}
+
+	if (start_fraction > -1.0f && start_fraction < end_fraction)
+	{
+		*fraction = start_fraction;
+		*normal	  = clip_normal;
+		return true;
+	}
+
+	return false;
+}
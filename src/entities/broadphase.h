@@ -0,0 +1,64 @@
+/*================================================================
+	* entities/broadphase.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Uniform hash grid of entity bounds for
+	swept box and sphere queries between entities.
+=================================================================*/
+
+#ifndef MG_BROADPHASE_H
+#define MG_BROADPHASE_H
+
+#include <gs/gs.h>
+
+#include "../bsp/bsp_trace.h"
+
+#define MG_BROADPHASE_CELL_SIZE	      128.0f
+#define MG_BROADPHASE_BUCKETS	      4096 // power of two
+#define MG_BROADPHASE_MAX_PROXY_CELLS 64   // larger proxies are always tested
+#define MG_BROADPHASE_MAX_QUERY_CELLS 512  // larger queries test every proxy
+#define MG_BROADPHASE_INVALID	      UINT32_MAX
+
+typedef struct mg_broadphase_proxy_t
+{
+	void *user;
+	gs_vec3 mins; // world space
+	gs_vec3 maxs;
+	int32_t cell_mins[3];
+	int32_t cell_maxs[3];
+	uint32_t stamp; // last query that tested this
+	bool32_t active;
+	bool32_t large; // in large_proxies instead of buckets
+} mg_broadphase_proxy_t;
+
+typedef struct mg_broadphase_t
+{
+	gs_dyn_array(mg_broadphase_proxy_t) proxies;
+	gs_dyn_array(uint32_t) free_proxies;
+	gs_dyn_array(uint32_t) large_proxies;
+	gs_dyn_array(uint32_t) buckets[MG_BROADPHASE_BUCKETS]; // proxy indices per cell hash
+	gs_dyn_array(uint32_t) candidates;		       // query scratch
+	gs_dyn_array(void *) results;			       // of the last sphere query
+	uint32_t stamp;
+	uint32_t num_active;
+} mg_broadphase_t;
+
+void mg_broadphase_init(mg_broadphase_t *bp);
+void mg_broadphase_free(mg_broadphase_t *bp);
+uint32_t mg_broadphase_add(mg_broadphase_t *bp, void *user, gs_vec3 mins, gs_vec3 maxs);
+void mg_broadphase_move(mg_broadphase_t *bp, uint32_t proxy, gs_vec3 mins, gs_vec3 maxs);
+void mg_broadphase_remove(mg_broadphase_t *bp, uint32_t proxy);
+void *mg_broadphase_sweep(mg_broadphase_t *bp, gs_vec3 start, gs_vec3 end, gs_vec3 mins, gs_vec3 maxs, float32_t max_fraction, const void *ignore, float32_t *fraction, gs_vec3 *normal);
+void *mg_broadphase_trace(mg_broadphase_t *bp, bsp_trace_t *trace, gs_vec3 start, gs_vec3 end, gs_vec3 mins, gs_vec3 maxs, int32_t content_mask, const void *ignore);
+uint32_t mg_broadphase_query_sphere(mg_broadphase_t *bp, gs_vec3 center, float32_t radius);
+void _mg_broadphase_cells(gs_vec3 mins, gs_vec3 maxs, int32_t *cell_mins, int32_t *cell_maxs);
+uint32_t _mg_broadphase_num_cells(const int32_t *cell_mins, const int32_t *cell_maxs);
+uint32_t _mg_broadphase_hash(int32_t x, int32_t y, int32_t z);
+void _mg_broadphase_link(mg_broadphase_t *bp, uint32_t proxy);
+void _mg_broadphase_unlink(mg_broadphase_t *bp, uint32_t proxy);
+void _mg_broadphase_gather(mg_broadphase_t *bp, gs_vec3 mins, gs_vec3 maxs);
+bool32_t _mg_broadphase_sweep_aabb(gs_vec3 start, gs_vec3 end, gs_vec3 mins, gs_vec3 maxs, float32_t *fraction, gs_vec3 *normal);
+
+#endif // MG_BROADPHASE_H
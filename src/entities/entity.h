@@ -17,6 +17,8 @@
 #include "../game/game_manager.h"
 #include "../graphics/renderer.h"
 
+#define MG_ENTITY_NO_ID UINT32_MAX // not in the entity manager
+
 typedef struct mg_entity_t
 {
 	uint32_t id;
@@ -24,6 +26,8 @@ typedef struct mg_entity_t
 	gs_vec3 velocity;
 	gs_vec3 mins;
 	gs_vec3 maxs;
+	uint32_t proxy;	 // broadphase, MG_BROADPHASE_INVALID if not linked
+	int32_t *health; // NULL if it can't be damaged
 } mg_entity_t;
 
 typedef struct mg_model_entity_t
@@ -52,6 +56,15 @@ static inline void mg_model_ent_free(mg_model_entity_t *ent)
 	mg_renderer_remove_renderable(ent->renderable_id);
 }
 
+/**
+ * Apply damage to entity, ignored if it has no health.
+ */
+static inline void mg_ent_damage(mg_entity_t *ent, const int32_t damage)
+{
+	if (ent->health == NULL || damage <= 0) return;
+	*ent->health -= damage;
+}
+
 /**
  * Apply friction to entity.
  */
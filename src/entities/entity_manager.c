@@ -8,6 +8,7 @@
 =================================================================*/
 
 #include "entity_manager.h"
+#include "../game/job_manager.h"
 #include "../game/time_manager.h"
 
 mg_entity_manager_t *g_entity_manager;
@@ -16,6 +17,8 @@ void mg_entity_manager_init()
 {
 	g_entity_manager	    = gs_malloc_init(mg_entity_manager_t);
 	g_entity_manager->ent_funcs = gs_slot_array_new(mg_entity_func_wrapper_t);
+	mg_broadphase_init(&g_entity_manager->broadphase);
+	mg_hitscan_init(&g_entity_manager->hitscan);
 }
 
 void mg_entity_manager_free()
@@ -32,11 +35,13 @@ void mg_entity_manager_free()
 		}
 	}
 	gs_slot_array_free(g_entity_manager->ent_funcs);
+	mg_broadphase_free(&g_entity_manager->broadphase);
+	mg_hitscan_free(&g_entity_manager->hitscan);
 }
 
 void mg_entity_manager_update()
 {
-	double dt = g_time_manager->delta;
+	double dt = g_time_manager->tick_delta;
 	for (
 		gs_slot_array_iter it = gs_slot_array_iter_new(g_entity_manager->ent_funcs);
 		gs_slot_array_iter_valid(g_entity_manager->ent_funcs, it);
@@ -48,6 +53,17 @@ void mg_entity_manager_update()
 			ent.update_func(ent.entity, dt);
 		}
 	}
+
+	// Relink after everything has moved
+	for (
+		gs_slot_array_iter it = gs_slot_array_iter_new(g_entity_manager->ent_funcs);
+		gs_slot_array_iter_valid(g_entity_manager->ent_funcs, it);
+		gs_slot_array_iter_advance(g_entity_manager->ent_funcs, it))
+	{
+		mg_entity_manager_relink(gs_slot_array_iter_get(g_entity_manager->ent_funcs, it).entity);
+	}
+
+	mg_hitscan_flush(&g_entity_manager->hitscan, g_game_manager->map, &g_entity_manager->broadphase, MG_JOB_MANAGER_THREADS);
 }
 
 uint32_t mg_entity_manager_add_entity(mg_entity_t *entity, void (*update_func)(void *, double), void (*free_func)(void *))
@@ -60,6 +76,8 @@ uint32_t mg_entity_manager_add_entity(mg_entity_t *entity, void (*update_func)(v
 	uint32_t id	     = gs_slot_array_insert(g_entity_manager->ent_funcs, ent_funcs);
 	mg_entity_funcs_t *f = gs_slot_array_getp(g_entity_manager->ent_funcs, id);
 	f->entity->id	     = id;
+	mg_entity_manager_link(f->entity);
+
 	return id;
 }
 
@@ -67,6 +85,44 @@ void mg_entity_manager_remove_entity(const uint32_t id)
 {
 	if (gs_slot_array_handle_valid(g_entity_manager->ent_funcs, id))
 	{
+		mg_entity_manager_unlink(gs_slot_array_getp(g_entity_manager->ent_funcs, id)->entity);
 		gs_slot_array_erase(g_entity_manager->ent_funcs, id);
 	}
 }
+
+// Adds entity to the broadphase, also for entities updated outside the manager
+void mg_entity_manager_link(mg_entity_t *entity)
+{
+	// Point entities don't collide with each other
+	entity->proxy = MG_BROADPHASE_INVALID;
+	if (gs_vec3_len2(gs_vec3_sub(entity->maxs, entity->mins)) > 0)
+	{
+		entity->proxy = mg_broadphase_add(
+			&g_entity_manager->broadphase,
+			entity,
+			gs_vec3_add(entity->transform.position, entity->mins),
+			gs_vec3_add(entity->transform.position, entity->maxs));
+	}
+}
+
+// Moves the proxy to the current position and bounds
+void mg_entity_manager_relink(mg_entity_t *entity)
+{
+	if (entity->proxy != MG_BROADPHASE_INVALID)
+	{
+		mg_broadphase_move(
+			&g_entity_manager->broadphase,
+			entity->proxy,
+			gs_vec3_add(entity->transform.position, entity->mins),
+			gs_vec3_add(entity->transform.position, entity->maxs));
+	}
+}
+
+void mg_entity_manager_unlink(mg_entity_t *entity)
+{
+	if (entity->proxy != MG_BROADPHASE_INVALID)
+	{
+		mg_broadphase_remove(&g_entity_manager->broadphase, entity->proxy);
+		entity->proxy = MG_BROADPHASE_INVALID;
+	}
+}
@@ -12,7 +12,9 @@
 
 #include <gs/gs.h>
 
+#include "broadphase.h"
 #include "entity.h"
+#include "hitscan.h"
 
 typedef struct mg_entity_funcs_t
 {
@@ -24,6 +26,8 @@ typedef struct mg_entity_funcs_t
 typedef struct mg_entity_manager_t
 {
 	gs_slot_array(mg_entity_funcs_t) ent_funcs;
+	mg_broadphase_t broadphase; // entities with bounds
+	mg_hitscan_t hitscan;	    // rays fired this tick
 } mg_entity_manager_t;
 
 void mg_entity_manager_init();
@@ -31,6 +35,9 @@ void mg_entity_manager_free();
 void mg_entity_manager_update();
 uint32_t mg_entity_manager_add_entity(mg_entity_t *entity, void (*update_func)(void *, double), void (*free_func)(void *));
 void mg_entity_manager_remove_entity(const uint32_t id);
+void mg_entity_manager_link(mg_entity_t *entity);
+void mg_entity_manager_relink(mg_entity_t *entity);
+void mg_entity_manager_unlink(mg_entity_t *entity);
 
 extern mg_entity_manager_t *g_entity_manager;
 
@@ -0,0 +1,199 @@
+/*================================================================
+	* entities/hitscan.c
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Instant hit rays queued during a tick and traced
+	together through the BSP and the entity broadphase.
+=================================================================*/
+
+#include "hitscan.h"
+#include "entity.h"
+
+void mg_hitscan_init(mg_hitscan_t *hs)
+{
+	*hs	     = (mg_hitscan_t){0};
+	hs->rays     = gs_dyn_array_new(mg_hitscan_ray_t);
+	hs->requests = gs_dyn_array_new(bsp_trace_request_t);
+	hs->traces   = gs_dyn_array_new(bsp_trace_t);
+	hs->hits     = gs_dyn_array_new(mg_hitscan_hit_t);
+	hs->times    = gs_dyn_array_new(double);
+}
+
+void mg_hitscan_free(mg_hitscan_t *hs)
+{
+	gs_dyn_array_free(hs->rays);
+	gs_dyn_array_free(hs->requests);
+	gs_dyn_array_free(hs->traces);
+	gs_dyn_array_free(hs->hits);
+	gs_dyn_array_free(hs->times);
+	*hs = (mg_hitscan_t){0};
+}
+
+// Queues a ray for the next flush, returns its index in hits
+uint32_t mg_hitscan_add(mg_hitscan_t *hs, mg_hitscan_ray_t ray)
+{
+	gs_dyn_array_push(hs->rays, ray);
+	return gs_dyn_array_size(hs->rays) - 1;
+}
+
+// Queues pellets spread randomly in a cone of spread radians around the ray.
+// Returns the index of the first pellet.
+uint32_t mg_hitscan_add_spread(mg_hitscan_t *hs, mg_hitscan_ray_t ray, uint32_t pellets, float32_t spread)
+{
+	gs_vec3 dir	= gs_vec3_sub(ray.end, ray.start);
+	float32_t range = gs_vec3_len(dir);
+	dir		= gs_vec3_scale(dir, 1.0f / gs_max(range, GS_EPSILON));
+
+	// Any two axes perpendicular to the ray
+	gs_vec3 up    = fabsf(dir.z) < 0.9f ? gs_v3(0, 0, 1.0f) : gs_v3(1.0f, 0, 0);
+	gs_vec3 right = gs_vec3_norm(gs_vec3_cross(dir, up));
+	up	      = gs_vec3_cross(right, dir);
+
+	uint32_t first = gs_dyn_array_size(hs->rays);
+	for (uint32_t i = 0; i < pellets; i++)
+	{
+		// Uniform in the cone cross section
+		float32_t r	= tanf(spread) * sqrtf((float32_t)rand() / (float32_t)RAND_MAX);
+		float32_t angle = 2.0f * GS_PI * (float32_t)rand() / (float32_t)RAND_MAX;
+		gs_vec3 offset	= gs_vec3_add(gs_vec3_scale(right, r * cosf(angle)), gs_vec3_scale(up, r * sinf(angle)));
+		gs_vec3 pellet	= gs_vec3_norm(gs_vec3_add(dir, offset));
+
+		mg_hitscan_ray_t pellet_ray = ray;
+		pellet_ray.end		    = gs_vec3_add(ray.start, gs_vec3_scale(pellet, range));
+		gs_dyn_array_push(hs->rays, pellet_ray);
+	}
+
+	return first;
+}
+
+// Traces every queued ray and calls their on_hit.
+// World traces are split over num_threads, entity sweeps run on the caller.
+// Rays added from on_hit are traced on the next flush.
+void mg_hitscan_flush(mg_hitscan_t *hs, bsp_map_t *map, mg_broadphase_t *bp, uint32_t num_threads)
+{
+	uint32_t count = gs_dyn_array_size(hs->rays);
+
+	gs_dyn_array_clear(hs->requests);
+	gs_dyn_array_clear(hs->traces);
+	gs_dyn_array_clear(hs->hits);
+	if (count == 0)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		bsp_trace_request_t req = {
+			.type	      = RAY,
+			.start	      = hs->rays[i].start,
+			.end	      = hs->rays[i].end,
+			.content_mask = hs->rays[i].content_mask,
+		};
+		bsp_trace_t trace = {
+			.map	  = map,
+			.fraction = 1.0f,
+			.end	  = hs->rays[i].end,
+		};
+		gs_dyn_array_push(hs->requests, req);
+		gs_dyn_array_push(hs->traces, trace);
+	}
+
+	if (map != NULL && map->valid)
+	{
+		bsp_trace_batch(map, hs->requests, hs->traces, count, num_threads);
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		mg_hitscan_hit_t hit = {
+			.fraction      = hs->traces[i].fraction,
+			.position      = hs->traces[i].end,
+			.normal	       = hs->traces[i].normal,
+			.contents      = hs->traces[i].contents,
+			.surface_flags = hs->traces[i].surface_flags,
+			.entity	       = NULL,
+			.entity_id     = MG_HITSCAN_NO_ENTITY,
+		};
+		gs_dyn_array_push(hs->hits, hit);
+	}
+
+	// The world is static, only entities need rewinding
+	if (bp != NULL && hs->rewind == NULL)
+	{
+		_mg_hitscan_sweep_entities(hs, bp, false, 0);
+	}
+	else if (bp != NULL)
+	{
+		gs_dyn_array_clear(hs->times);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			bool32_t found = false;
+			for (uint32_t j = 0; j < gs_dyn_array_size(hs->times) && !found; j++)
+			{
+				found = hs->times[j] == hs->rays[i].time;
+			}
+			if (!found)
+			{
+				gs_dyn_array_push(hs->times, hs->rays[i].time);
+			}
+		}
+
+		for (uint32_t i = 0; i < gs_dyn_array_size(hs->times); i++)
+		{
+			hs->rewind(hs->rewind_data, hs->times[i]);
+			_mg_hitscan_sweep_entities(hs, bp, true, hs->times[i]);
+		}
+
+		if (hs->restore != NULL)
+		{
+			hs->restore(hs->rewind_data);
+		}
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		// Callback may push rays and move the array
+		mg_hitscan_ray_t ray = hs->rays[i];
+		if (ray.on_hit != NULL)
+		{
+			ray.on_hit(ray.user, &hs->hits[i]);
+		}
+	}
+
+	uint32_t added = gs_dyn_array_size(hs->rays) - count;
+	memmove(hs->rays, hs->rays + count, added * sizeof(mg_hitscan_ray_t));
+	gs_dyn_array_head(hs->rays)->size = added;
+}
+
+// Clips hits to entities closer than the world.
+// If match_time, only rays fired at time.
+void _mg_hitscan_sweep_entities(mg_hitscan_t *hs, mg_broadphase_t *bp, bool32_t match_time, double time)
+{
+	for (uint32_t i = 0; i < gs_dyn_array_size(hs->hits); i++)
+	{
+		const mg_hitscan_ray_t *ray = &hs->rays[i];
+		if (match_time && ray->time != time)
+		{
+			continue;
+		}
+
+		mg_hitscan_hit_t *hit = &hs->hits[i];
+		float32_t fraction;
+		gs_vec3 normal;
+		mg_entity_t *ent = mg_broadphase_sweep(bp, ray->start, ray->end, gs_v3(0, 0, 0), gs_v3(0, 0, 0), hit->fraction, ray->ignore, &fraction, &normal);
+		if (ent == NULL)
+		{
+			continue;
+		}
+
+		hit->fraction	   = fraction;
+		hit->position	   = gs_vec3_add(ray->start, gs_vec3_scale(gs_vec3_sub(ray->end, ray->start), fraction));
+		hit->normal	   = normal;
+		hit->contents	   = 0;
+		hit->surface_flags = 0;
+		hit->entity	   = ent;
+		hit->entity_id	   = ent->id;
+	}
+}
@@ -0,0 +1,72 @@
+/*================================================================
+	* entities/hitscan.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Instant hit rays queued during a tick and traced
+	together through the BSP and the entity broadphase.
+=================================================================*/
+
+#ifndef MG_HITSCAN_H
+#define MG_HITSCAN_H
+
+#include <gs/gs.h>
+
+#include "../bsp/bsp_trace.h"
+#include "broadphase.h"
+
+#define MG_HITSCAN_NO_ENTITY UINT32_MAX
+
+typedef struct mg_hitscan_hit_t mg_hitscan_hit_t;
+
+// Called for every ray when flushing, hit or not
+typedef void (*mg_hitscan_hit_fn)(void *user, const mg_hitscan_hit_t *hit);
+
+// Lag compensation, moves entities to where they were at time
+// and back to the present. Proxies must be moved too.
+typedef void (*mg_hitscan_rewind_fn)(void *data, double time);
+typedef void (*mg_hitscan_restore_fn)(void *data);
+
+typedef struct mg_hitscan_ray_t
+{
+	gs_vec3 start;
+	gs_vec3 end;
+	int32_t content_mask;
+	const void *ignore; // entity that fired the ray
+	double time;	    // world time the shooter saw
+	mg_hitscan_hit_fn on_hit;
+	void *user;
+} mg_hitscan_ray_t;
+
+struct mg_hitscan_hit_t
+{
+	float32_t fraction; // 1 if nothing was hit
+	gs_vec3 position;
+	gs_vec3 normal;
+	int32_t contents;	    // of the world, 0 for entities
+	int32_t surface_flags;	    // of the world, 0 for entities
+	struct mg_entity_t *entity; // NULL for the world
+	uint32_t entity_id;	    // MG_HITSCAN_NO_ENTITY for the world
+};
+
+typedef struct mg_hitscan_t
+{
+	gs_dyn_array(mg_hitscan_ray_t) rays;
+	gs_dyn_array(bsp_trace_request_t) requests;
+	gs_dyn_array(bsp_trace_t) traces;
+	gs_dyn_array(mg_hitscan_hit_t) hits; // of the last flush, per ray
+	gs_dyn_array(double) times;	     // flush scratch
+	mg_hitscan_rewind_fn rewind;
+	mg_hitscan_restore_fn restore;
+	void *rewind_data;
+} mg_hitscan_t;
+
+void mg_hitscan_init(mg_hitscan_t *hs);
+void mg_hitscan_free(mg_hitscan_t *hs);
+uint32_t mg_hitscan_add(mg_hitscan_t *hs, mg_hitscan_ray_t ray);
+uint32_t mg_hitscan_add_spread(mg_hitscan_t *hs, mg_hitscan_ray_t ray, uint32_t pellets, float32_t spread);
+void mg_hitscan_flush(mg_hitscan_t *hs, bsp_map_t *map, mg_broadphase_t *bp, uint32_t num_threads);
+void _mg_hitscan_sweep_entities(mg_hitscan_t *hs, mg_broadphase_t *bp, bool32_t match_time, double time);
+
+#endif // MG_HITSCAN_H
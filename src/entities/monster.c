@@ -9,7 +9,9 @@
 
 #include "monster.h"
 #include "../audio/audio_manager.h"
+#include "../bsp/bsp_point.h"
 #include "../bsp/bsp_trace.h"
+#include "../bsp/bsp_unstuck.h"
 #include "../game/config.h"
 #include "../game/console.h"
 #include "../game/game_manager.h"
@@ -18,6 +20,7 @@
 #include "../util/math.h"
 #include "../util/transform.h"
 #include "entity.h"
+#include "entity_manager.h"
 #include <gs/util/gs_idraw.h>
 
 mg_monster_t *mg_monster_new(const char *model_path, const gs_vec3 mins, const gs_vec3 maxs)
@@ -36,6 +39,7 @@ mg_monster_t *mg_monster_new(const char *model_path, const gs_vec3 mins, const g
 		.last_ground_time = 0,
 		.height		  = maxs.z,
 		.crouch_height	  = maxs.z * 0.5f,
+		.jump_sound	  = g_audio_manager != NULL ? mg_audio_manager_get_handle("monster/jump1.wav") : MG_NAME_MAP_INVALID,
 	};
 
 	monster->model = mg_model_manager_find(model_path);
@@ -47,11 +51,24 @@ mg_monster_t *mg_monster_new(const char *model_path, const gs_vec3 mins, const g
 	monster->model_id   = mg_renderer_create_renderable(*monster->model, &monster->transform);
 	monster->renderable = mg_renderer_get_renderable(monster->model_id);
 
+	// Updated by the monster manager, relinked at the end of each tick
+	monster->ent  = gs_malloc_init(mg_entity_t);
+	*monster->ent = (mg_entity_t){
+		.id	   = MG_ENTITY_NO_ID,
+		.transform = monster->transform,
+		.mins	   = monster->mins,
+		.maxs	   = monster->maxs,
+		.health	   = &monster->health,
+	};
+	mg_entity_manager_link(monster->ent);
+
 	return monster;
 }
 
 void mg_monster_free(mg_monster_t *monster)
 {
+	mg_entity_manager_unlink(monster->ent);
+	gs_free(monster->ent);
 	gs_free(monster);
 }
 
@@ -61,8 +78,8 @@ void mg_monster_update(mg_monster_t *monster)
 	if (g_ui_manager->show_cursor) return;
 	if (g_game_manager->map == NULL || !g_game_manager->map->valid) return;
 
-	double dt = g_time_manager->delta;
-	double pt = g_time_manager->time;
+	double dt = g_time_manager->tick_delta;
+	double pt = g_time_manager->tick_time;
 
 	_mg_monster_think(monster, pt);
 	_mg_monster_check_floor(monster);
@@ -143,12 +160,11 @@ void mg_monster_update(mg_monster_t *monster)
 		    BSP_CONTENT_CONTENTS_SOLID | BSP_CONTENT_CONTENTS_MONSTERCLIP,
 		    dt))
 	{
-		// FIXME: this just makes you fly up walls...
-		// _mg_monster_unstuck(monster);
+		_mg_monster_unstuck(monster);
 	}
 
 	// Check out of map bounds
-	uint32_t leaf_index   = g_game_manager->map->stats.current_leaf;
+	int32_t leaf_index    = bsp_point_leaf(g_game_manager->map, gs_vec3_add(monster->transform.position, monster->eye_pos), &monster->leaf);
 	int32_t cluster_index = g_game_manager->map->leaves.data[leaf_index].cluster;
 	if (cluster_index < 0)
 	{
@@ -160,6 +176,8 @@ void mg_monster_update(mg_monster_t *monster)
 		monster->transform.position = monster->last_valid_pos;
 		monster->velocity	    = gs_v3(0, 0, 0);
 	}
+
+	_mg_monster_relink(monster);
 }
 
 void _mg_monster_think(mg_monster_t *monster, double platform_time)
@@ -186,7 +204,7 @@ void _mg_monster_do_jump(mg_monster_t *monster)
 	monster->grounded   = false;
 	monster->has_jumped = true;
 	if (g_audio_manager != NULL)
-		mg_audio_manager_play("monster/jump1.wav", 0.03f);
+		mg_audio_manager_play_handle(monster->jump_sound, 0.03f);
 }
 
 void _mg_monster_check_floor(mg_monster_t *monster)
@@ -210,9 +228,9 @@ void _mg_monster_check_floor(mg_monster_t *monster)
 		monster->grounded	  = true;
 		monster->has_jumped	  = false;
 		monster->ground_normal	  = trace.normal;
-		monster->last_ground_time = g_time_manager->time;
+		monster->last_ground_time = g_time_manager->tick_time;
 
-		uint32_t leaf_index   = g_game_manager->map->stats.current_leaf;
+		int32_t leaf_index    = bsp_point_leaf(g_game_manager->map, gs_vec3_add(monster->transform.position, monster->eye_pos), &monster->leaf);
 		int32_t cluster_index = g_game_manager->map->leaves.data[leaf_index].cluster;
 		if (cluster_index >= 0)
 		{
@@ -333,72 +351,47 @@ void _mg_monster_unstuck(mg_monster_t *monster)
 {
 	monster->velocity = gs_v3(0, 0, 0);
 
-	// Directions to attempt to teleport to,
-	// in listed order.
-	gs_vec3 directions[6] = {
-		MG_AXIS_UP,
-		MG_AXIS_FORWARD,
-		MG_AXIS_RIGHT,
-		MG_AXIS_BACKWARD,
-		MG_AXIS_LEFT,
-		MG_AXIS_DOWN,
-	};
-
-	float distance	   = 0.0f;
-	float increment	   = 64.0f;
-	float max_distance = increment * 10;
-	uint32_t dir	   = 0;
-	gs_vec3 start	   = gs_v3(0, 0, 0);
-	gs_vec3 end	   = gs_v3(0, 0, 0);
-	bsp_trace_t trace  = {.map = g_game_manager->map};
+	bsp_unstuck_result_t result = bsp_unstuck(
+		g_game_manager->map,
+		monster->transform.position,
+		monster->mins,
+		monster->maxs,
+		BSP_CONTENT_CONTENTS_SOLID | BSP_CONTENT_CONTENTS_MONSTERCLIP);
 
-	while (true)
+	if (!result.found)
 	{
-		// Sweep monster aabb by 1 unit
-		start = gs_vec3_add(monster->transform.position, gs_vec3_scale(directions[dir], distance));
-		end   = gs_vec3_add(start, directions[dir]);
-		bsp_trace_box(&trace, start, end, monster->mins, monster->maxs, BSP_CONTENT_CONTENTS_SOLID | BSP_CONTENT_CONTENTS_MONSTERCLIP);
-
-		if (trace.fraction > 0.0f && !trace.all_solid)
-		{
-			// Trace ends in a valid position.
-			// Trace back towards start so we move
-			// the minimum distance to get unstuck.
-			gs_vec3 valid_pos = trace.end;
-			bsp_trace_box(&trace, trace.end, monster->transform.position, monster->mins, monster->maxs, BSP_CONTENT_CONTENTS_SOLID | BSP_CONTENT_CONTENTS_MONSTERCLIP);
-			if (trace.fraction < 1.0f && !trace.all_solid)
-			{
-				valid_pos = trace.end;
-			}
+		mg_println(
+			"WARN: monster stuck in solid at [%f, %f, %f], could not unstuck, reset to last valid pos: [%f, %f, %f]",
+			monster->transform.position.x,
+			monster->transform.position.y,
+			monster->transform.position.z,
+			monster->last_valid_pos.x,
+			monster->last_valid_pos.y,
+			monster->last_valid_pos.z);
+		monster->transform.position = monster->last_valid_pos;
+		return;
+	}
 
-			mg_println(
-				"WARN: monster stuck in solid at [%f, %f, %f], freeing to [%f, %f, %f].",
-				monster->transform.position.x,
-				monster->transform.position.y,
-				monster->transform.position.z,
-				valid_pos.x,
-				valid_pos.y,
-				valid_pos.z);
-			monster->transform.position = valid_pos;
-			break;
-		}
+	mg_println(
+		"WARN: monster stuck in solid at [%f, %f, %f], freeing to [%f, %f, %f] (%u leaves, %u point tests, %u traces).",
+		monster->transform.position.x,
+		monster->transform.position.y,
+		monster->transform.position.z,
+		result.position.x,
+		result.position.y,
+		result.position.z,
+		result.leaves,
+		result.point_tests,
+		result.traces);
+	monster->transform.position = result.position;
+}
 
-		// Swap to the next direction,
-		// increment distance if looped through all.
-		dir++;
-		if (dir >= 6)
-		{
-			dir = 0;
-			distance += increment;
-			if (distance > max_distance)
-			{
-				mg_println(
-					"WARN: monster stuck in solid at [%f, %f, %f], could not unstuck.",
-					monster->transform.position.x,
-					monster->transform.position.y,
-					monster->transform.position.z);
-				break;
-			}
-		}
-	}
-}
\ No newline at end of file
+// Sync the broadphase proxy, crouching changes the bounds
+void _mg_monster_relink(mg_monster_t *monster)
+{
+	monster->ent->transform = monster->transform;
+	monster->ent->velocity	= monster->velocity;
+	monster->ent->mins	= monster->mins;
+	monster->ent->maxs	= monster->maxs;
+	mg_entity_manager_relink(monster->ent);
+}
@@ -39,6 +39,7 @@
 typedef struct mg_monster_t
 {
 	gs_vqs transform;
+	struct mg_entity_t *ent; // broadphase proxy and damage target
 	int32_t health;
 	gs_vec3 velocity;
 	gs_vec3 wish_move;
@@ -53,6 +54,7 @@ typedef struct mg_monster_t
 	bool32_t has_jumped;
 	float32_t crouch_fraction;
 	gs_vec3 last_valid_pos;
+	int32_t leaf; // of eye position, lookup cache
 	double last_ground_time;
 	double last_think_time;
 	mg_model_t *model;
@@ -60,6 +62,7 @@ typedef struct mg_monster_t
 	mg_renderable_t *renderable;
 	float height;
 	float crouch_height;
+	uint32_t jump_sound; // audio handle
 } mg_monster_t;
 
 mg_monster_t *mg_monster_new(const char *model_path, const gs_vec3 mins, const gs_vec3 maxs);
@@ -71,5 +74,6 @@ void _mg_monster_uncrouch(mg_monster_t *monster, float delta_time);
 void _mg_monster_crouch(mg_monster_t *monster, float delta_time);
 void _mg_monster_do_jump(mg_monster_t *monster);
 void _mg_monster_check_floor(mg_monster_t *monster);
+void _mg_monster_relink(mg_monster_t *monster);
 
 #endif // MG_MONSTER_H
\ No newline at end of file
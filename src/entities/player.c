@@ -9,7 +9,9 @@
 
 #include "player.h"
 #include "../audio/audio_manager.h"
+#include "../bsp/bsp_point.h"
 #include "../bsp/bsp_trace.h"
+#include "../bsp/bsp_unstuck.h"
 #include "../game/config.h"
 #include "../game/console.h"
 #include "../game/game_manager.h"
@@ -20,6 +22,7 @@
 #include "../util/camera.h"
 #include "../util/math.h"
 #include "entity.h"
+#include "entity_manager.h"
 
 #include <gs/util/gs_idraw.h>
 
@@ -54,8 +57,16 @@ mg_player_t *mg_player_new()
 		.maxs		  = gs_v3(MG_PLAYER_HALF_WIDTH, MG_PLAYER_HALF_WIDTH, MG_PLAYER_HEIGHT),
 		.last_ground_time = 0,
 		.weapon_current	  = -1,
+		.jump_sound	  = g_audio_manager != NULL ? mg_audio_manager_get_handle("player/jump1.wav") : MG_NAME_MAP_INVALID,
 	};
 
+	player->viewmodel_pos[0]   = mg_cvar("r_viewmodel_pos_x");
+	player->viewmodel_pos[1]   = mg_cvar("r_viewmodel_pos_y");
+	player->viewmodel_pos[2]   = mg_cvar("r_viewmodel_pos_z");
+	player->viewmodel_scale[0] = mg_cvar("r_viewmodel_scale_x");
+	player->viewmodel_scale[1] = mg_cvar("r_viewmodel_scale_y");
+	player->viewmodel_scale[2] = mg_cvar("r_viewmodel_scale_z");
+
 	for (size_t i = 0; i < MG_WEAPON_COUNT; i++)
 	{
 		player->weapons[i] = mg_weapon_create(i);
@@ -63,13 +74,27 @@ mg_player_t *mg_player_new()
 		mg_renderer_set_model_type(player->weapons[i]->renderable_id, MG_MODEL_VIEWMODEL);
 	}
 
-	_mg_player_camera_update(player);
+	_mg_player_camera_update(player, 1.0f);
+
+	// Updated by the game manager, relinked at the end of each tick
+	player->ent  = gs_malloc_init(mg_entity_t);
+	*player->ent = (mg_entity_t){
+		.id	   = MG_ENTITY_NO_ID,
+		.transform = player->transform,
+		.mins	   = player->mins,
+		.maxs	   = player->maxs,
+		.health	   = &player->health,
+	};
+	mg_entity_manager_link(player->ent);
 
 	return player;
 }
 
 void mg_player_free(mg_player_t *player)
 {
+	mg_entity_manager_unlink(player->ent);
+	gs_free(player->ent);
+
 	for (size_t i = 0; i < MG_WEAPON_COUNT; i++)
 	{
 		mg_weapon_free(player->weapons[i]);
@@ -80,12 +105,14 @@ void mg_player_free(mg_player_t *player)
 
 void mg_player_update(mg_player_t *player)
 {
+	player->prev_position = player->transform.position;
+
 	// TODO: time manager, pausing
 	if (g_ui_manager->show_cursor) return;
 	if (g_game_manager->map == NULL || !g_game_manager->map->valid) return;
 
-	double dt = g_time_manager->delta;
-	double pt = g_time_manager->time;
+	double dt = g_time_manager->tick_delta;
+	double pt = g_time_manager->tick_time;
 
 	_mg_player_check_floor(player);
 
@@ -171,14 +198,13 @@ void mg_player_update(mg_player_t *player)
 		    BSP_CONTENT_CONTENTS_SOLID | BSP_CONTENT_CONTENTS_PLAYERCLIP,
 		    dt))
 	{
-		// FIXME: this just makes you fly up walls...
-		// _mg_player_unstuck(player);
+		_mg_player_unstuck(player);
 	}
 
-	_mg_player_camera_update(player);
+	_mg_player_camera_update(player, 1.0f);
 
 	// Check out of map bounds
-	uint32_t leaf_index   = g_game_manager->map->stats.current_leaf;
+	int32_t leaf_index    = bsp_point_leaf(g_game_manager->map, gs_vec3_add(player->transform.position, player->eye_pos), &player->leaf);
 	int32_t cluster_index = g_game_manager->map->leaves.data[leaf_index].cluster;
 	if (cluster_index < 0)
 	{
@@ -188,9 +214,13 @@ void mg_player_update(mg_player_t *player)
 			player->last_valid_pos.y,
 			player->last_valid_pos.z);
 		player->transform.position = player->last_valid_pos;
+		player->prev_position	   = player->last_valid_pos;
 		player->velocity	   = gs_v3(0, 0, 0);
 	}
 
+	// Before shooting so the ray can skip our own proxy
+	_mg_player_relink(player);
+
 	if (player->wish_shoot)
 	{
 		_mg_player_shoot(player);
@@ -224,7 +254,7 @@ void _mg_player_do_jump(mg_player_t *player)
 	player->grounded   = false;
 	player->has_jumped = true;
 	if (g_audio_manager != NULL)
-		mg_audio_manager_play("player/jump1.wav", 0.03f);
+		mg_audio_manager_play_handle(player->jump_sound, 0.03f);
 }
 
 void _mg_player_check_floor(mg_player_t *player)
@@ -248,9 +278,9 @@ void _mg_player_check_floor(mg_player_t *player)
 		player->grounded	 = true;
 		player->has_jumped	 = false;
 		player->ground_normal	 = trace.normal;
-		player->last_ground_time = g_time_manager->time;
+		player->last_ground_time = g_time_manager->tick_time;
 
-		uint32_t leaf_index   = g_game_manager->map->stats.current_leaf;
+		int32_t leaf_index    = bsp_point_leaf(g_game_manager->map, gs_vec3_add(player->transform.position, player->eye_pos), &player->leaf);
 		int32_t cluster_index = g_game_manager->map->leaves.data[leaf_index].cluster;
 		if (cluster_index >= 0)
 		{
@@ -263,8 +293,18 @@ void _mg_player_check_floor(mg_player_t *player)
 	}
 }
 
-void _mg_player_camera_update(mg_player_t *player)
+// Places the camera between the last two ticks
+void mg_player_interpolate(mg_player_t *player, float32_t alpha)
 {
+	_mg_player_camera_update(player, alpha);
+}
+
+// Camera at alpha between the previous and current tick position
+void _mg_player_camera_update(mg_player_t *player, float32_t alpha)
+{
+	gs_vqs view   = player->transform;
+	view.position = gs_vec3_add(player->prev_position, gs_vec3_scale(gs_vec3_sub(player->transform.position, player->prev_position), alpha));
+
 	player->camera.cam.transform = gs_vqs_absolute_transform(
 		&(gs_vqs){
 			.position = player->eye_pos,
@@ -273,7 +313,7 @@ void _mg_player_camera_update(mg_player_t *player)
 				gs_quat_angle_axis(gs_deg2rad(player->camera.roll), MG_AXIS_FORWARD)),
 			.scale = gs_v3(1.0f, 1.0f, 1.0f),
 		},
-		&player->transform);
+		&view);
 
 	player->viewmodel_camera.transform = player->camera.cam.transform;
 
@@ -283,14 +323,14 @@ void _mg_player_camera_update(mg_player_t *player)
 		weapon->transform   = gs_vqs_absolute_transform(
 			  &(gs_vqs){
 				  .position = gs_v3(
-					  mg_cvar("r_viewmodel_pos_x")->value.f,
-					  mg_cvar("r_viewmodel_pos_y")->value.f,
-					  mg_cvar("r_viewmodel_pos_z")->value.f),
+					  player->viewmodel_pos[0]->value.f,
+					  player->viewmodel_pos[1]->value.f,
+					  player->viewmodel_pos[2]->value.f),
 				  .rotation = gs_quat_default(),
 				  .scale    = gs_v3(
-					     weapon->view_scale.x * mg_cvar("r_viewmodel_scale_x")->value.f,
-					     weapon->view_scale.y * mg_cvar("r_viewmodel_scale_y")->value.f,
-					     weapon->view_scale.z * mg_cvar("r_viewmodel_scale_z")->value.f),
+					     weapon->view_scale.x * player->viewmodel_scale[0]->value.f,
+					     weapon->view_scale.y * player->viewmodel_scale[1]->value.f,
+					     weapon->view_scale.z * player->viewmodel_scale[2]->value.f),
 			  },
 			  &player->camera.cam.transform);
 	}
@@ -404,74 +444,41 @@ void _mg_player_unstuck(mg_player_t *player)
 {
 	player->velocity = gs_v3(0, 0, 0);
 
-	// Directions to attempt to teleport to,
-	// in listed order.
-	gs_vec3 directions[6] = {
-		MG_AXIS_UP,
-		MG_AXIS_FORWARD,
-		MG_AXIS_RIGHT,
-		MG_AXIS_BACKWARD,
-		MG_AXIS_LEFT,
-		MG_AXIS_DOWN,
-	};
-
-	float distance	   = 0.0f;
-	float increment	   = 64.0f;
-	float max_distance = increment * 10;
-	uint32_t dir	   = 0;
-	gs_vec3 start	   = gs_v3(0, 0, 0);
-	gs_vec3 end	   = gs_v3(0, 0, 0);
-	bsp_trace_t trace  = {.map = g_game_manager->map};
+	bsp_unstuck_result_t result = bsp_unstuck(
+		g_game_manager->map,
+		player->transform.position,
+		player->mins,
+		player->maxs,
+		BSP_CONTENT_CONTENTS_SOLID | BSP_CONTENT_CONTENTS_PLAYERCLIP);
 
-	while (true)
+	if (!result.found)
 	{
-		// Sweep player aabb by 1 unit
-		start = gs_vec3_add(player->transform.position, gs_vec3_scale(directions[dir], distance));
-		end   = gs_vec3_add(start, directions[dir]);
-		bsp_trace_box(&trace, start, end, player->mins, player->maxs, BSP_CONTENT_CONTENTS_SOLID | BSP_CONTENT_CONTENTS_PLAYERCLIP);
-
-		if (trace.fraction > 0.0f && !trace.all_solid)
-		{
-			// Trace ends in a valid position.
-			// Trace back towards start so we move
-			// the minimum distance to get unstuck.
-			gs_vec3 valid_pos = trace.end;
-			bsp_trace_box(&trace, trace.end, player->transform.position, player->mins, player->maxs, BSP_CONTENT_CONTENTS_SOLID | BSP_CONTENT_CONTENTS_PLAYERCLIP);
-			if (trace.fraction < 1.0f && !trace.all_solid)
-			{
-				valid_pos = trace.end;
-			}
-
-			mg_println(
-				"WARN: player stuck in solid at [%f, %f, %f], freeing to [%f, %f, %f].",
-				player->transform.position.x,
-				player->transform.position.y,
-				player->transform.position.z,
-				valid_pos.x,
-				valid_pos.y,
-				valid_pos.z);
-			player->transform.position = valid_pos;
-			break;
-		}
-
-		// Swap to the next direction,
-		// increment distance if looped through all.
-		dir++;
-		if (dir >= 6)
-		{
-			dir = 0;
-			distance += increment;
-			if (distance > max_distance)
-			{
-				mg_println(
-					"WARN: player stuck in solid at [%f, %f, %f], could not unstuck.",
-					player->transform.position.x,
-					player->transform.position.y,
-					player->transform.position.z);
-				break;
-			}
-		}
+		mg_println(
+			"WARN: player stuck in solid at [%f, %f, %f], could not unstuck, reset to last valid pos: [%f, %f, %f]",
+			player->transform.position.x,
+			player->transform.position.y,
+			player->transform.position.z,
+			player->last_valid_pos.x,
+			player->last_valid_pos.y,
+			player->last_valid_pos.z);
+		player->transform.position = player->last_valid_pos;
+		player->prev_position	   = player->last_valid_pos;
+		return;
 	}
+
+	mg_println(
+		"WARN: player stuck in solid at [%f, %f, %f], freeing to [%f, %f, %f] (%u leaves, %u point tests, %u traces).",
+		player->transform.position.x,
+		player->transform.position.y,
+		player->transform.position.z,
+		result.position.x,
+		result.position.y,
+		result.position.z,
+		result.leaves,
+		result.point_tests,
+		result.traces);
+	player->transform.position = result.position;
+	player->prev_position	   = result.position;
 }
 
 void _mg_player_shoot(mg_player_t *player)
@@ -482,6 +489,16 @@ void _mg_player_shoot(mg_player_t *player)
 	}
 
 	mg_weapon_t *weapon	      = player->weapons[player->weapon_current];
-	mg_weapon_shoot_result result = mg_weapon_shoot(weapon, player->camera.cam.transform);
+	mg_weapon_shoot_result result = mg_weapon_shoot(weapon, player->camera.cam.transform, player->ent);
 	// TODO: shoot anim, out of ammo sound
-}
\ No newline at end of file
+}
+
+// Sync the broadphase proxy, crouching changes the bounds
+void _mg_player_relink(mg_player_t *player)
+{
+	player->ent->transform = player->transform;
+	player->ent->velocity  = player->velocity;
+	player->ent->mins      = player->mins;
+	player->ent->maxs      = player->maxs;
+	mg_entity_manager_relink(player->ent);
+}
@@ -13,6 +13,7 @@
 #include <gs/gs.h>
 
 #include "../bsp/bsp_map.h"
+#include "../game/config.h"
 #include "weapon.h"
 
 #define MG_PLAYER_HEIGHT	    64.0f
@@ -48,6 +49,7 @@ typedef struct mg_player_camera_t
 typedef struct mg_player_t
 {
 	gs_vqs transform;
+	struct mg_entity_t *ent; // broadphase proxy and damage target
 	mg_player_camera_t camera;
 	gs_camera_t viewmodel_camera;
 	float32_t yaw;
@@ -66,21 +68,28 @@ typedef struct mg_player_t
 	bool32_t wish_shoot;
 	float32_t crouch_fraction;
 	gs_vec3 last_valid_pos;
+	gs_vec3 prev_position; // at the start of the last tick
+	int32_t leaf;	       // of eye position, lookup cache
 	int32_t weapon_current;
 	mg_weapon_t *weapons[MG_WEAPON_COUNT];
 	double last_ground_time;
+	uint32_t jump_sound;	       // audio handle
+	mg_cvar_t *viewmodel_pos[3];   // r_viewmodel_pos_x, y, z
+	mg_cvar_t *viewmodel_scale[3]; // r_viewmodel_scale_x, y, z
 } mg_player_t;
 
 mg_player_t *mg_player_new();
 void mg_player_free(mg_player_t *player);
 void mg_player_update(mg_player_t *player);
+void mg_player_interpolate(mg_player_t *player, float32_t alpha);
 void mg_player_switch_weapon(mg_player_t *player, int32_t slot);
 void _mg_player_unstuck(mg_player_t *player);
 void _mg_player_uncrouch(mg_player_t *player, float delta_time);
 void _mg_player_crouch(mg_player_t *player, float delta_time);
-void _mg_player_camera_update(mg_player_t *player);
+void _mg_player_camera_update(mg_player_t *player, float32_t alpha);
 void _mg_player_do_jump(mg_player_t *player);
 void _mg_player_check_floor(mg_player_t *player);
 void _mg_player_shoot(mg_player_t *player);
+void _mg_player_relink(mg_player_t *player);
 
 #endif // MG_PLAYER_H
\ No newline at end of file
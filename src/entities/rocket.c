@@ -14,15 +14,16 @@
 #include "../util/transform.h"
 #include "entity_manager.h"
 
-mg_rocket_t *mg_rocket_new(gs_vqs transform)
+mg_rocket_t *mg_rocket_new(gs_vqs transform, const mg_entity_t *owner)
 {
 	mg_rocket_t *rocket = gs_malloc_init(mg_rocket_t);
 	gs_assert(mg_model_ent_init(&rocket->mdl_ent, transform, "projectiles/rocket.md3", "basic"));
 	rocket->mdl_ent.ent.velocity = gs_vec3_scale(mg_get_forward(transform.rotation), MG_ROCKET_SPEED);
 	rocket->life_time	     = MG_ROCKET_LIFE;
-	rocket->start_time	     = g_time_manager->time;
+	rocket->start_time	     = g_time_manager->tick_time;
 	rocket->hidden		     = true;
 	rocket->trail		     = mg_rocket_trail_new(&rocket->mdl_ent.ent.transform);
+	rocket->owner		     = owner;
 	mg_renderer_set_hidden(rocket->mdl_ent.renderable_id, true);
 	mg_entity_manager_add_entity(rocket, mg_rocket_update, mg_rocket_free);
 	return rocket;
@@ -44,7 +45,7 @@ void mg_rocket_update(mg_rocket_t *rocket, double dt)
 		return;
 	}
 
-	double time = g_time_manager->time;
+	double time = g_time_manager->tick_time;
 	if (rocket->hidden && time - rocket->start_time >= MG_ROCKET_HIDE_TIME)
 	{
 		rocket->hidden = false;
@@ -58,7 +59,15 @@ void mg_rocket_update(mg_rocket_t *rocket, double dt)
 
 	bsp_trace_t trace = {0};
 	trace.map	  = g_game_manager->map;
-	bsp_trace_ray(&trace, current_pos, new_pos, BSP_CONTENT_CONTENTS_SOLID);
+	mg_broadphase_trace(
+		&g_entity_manager->broadphase,
+		&trace,
+		current_pos,
+		new_pos,
+		gs_v3(0, 0, 0),
+		gs_v3(0, 0, 0),
+		BSP_CONTENT_CONTENTS_SOLID,
+		rocket->owner);
 
 	if (trace.start_solid)
 	{
@@ -77,8 +86,6 @@ void mg_rocket_update(mg_rocket_t *rocket, double dt)
 		return;
 	}
 
-	// TODO: trace against entities
-
 	rocket->mdl_ent.ent.transform.position = new_pos;
 
 	// TODO: travel sound at pos
@@ -93,7 +100,28 @@ void _mg_rocket_remove(mg_rocket_t *rocket)
 
 void _mg_rocket_explode(mg_rocket_t *rocket)
 {
-	// TODO: sphere iter nearby ents + trace + damage
+	gs_vec3 origin	  = rocket->mdl_ent.ent.transform.position;
+	bsp_trace_t trace = {.map = g_game_manager->map};
+
+	// Splash damage falls off with distance to the center of bounds,
+	// the owner takes it too for rocket jumps
+	uint32_t count = mg_broadphase_query_sphere(&g_entity_manager->broadphase, origin, MG_ROCKET_SPLASH);
+	for (size_t i = 0; i < count; i++)
+	{
+		mg_entity_t *ent = g_entity_manager->broadphase.results[i];
+		gs_vec3 center	 = gs_vec3_add(ent->transform.position, gs_vec3_scale(gs_vec3_add(ent->mins, ent->maxs), 0.5f));
+
+		// No damage through walls
+		bsp_trace_ray(&trace, origin, center, BSP_CONTENT_CONTENTS_SOLID);
+		if (trace.fraction < 1.0f)
+		{
+			continue;
+		}
+
+		float32_t falloff = 1.0f - fminf(gs_vec3_dist(origin, center) / MG_ROCKET_SPLASH, 1.0f);
+		mg_ent_damage(ent, (int32_t)(MG_ROCKET_DAMAGE * falloff));
+	}
+
 	// TODO: explosion sound at pos
 	// TODO: explosion fx
 	_mg_rocket_remove(rocket);
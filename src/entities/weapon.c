@@ -12,6 +12,7 @@
 #include "../game/time_manager.h"
 #include "../graphics/renderer.h"
 #include "../util/transform.h"
+#include "entity_manager.h"
 #include "rocket.h"
 
 mg_weapon_t *mg_weapon_create(mg_weapon_type type)
@@ -65,14 +66,14 @@ void mg_weapon_free(mg_weapon_t *weapon)
 	gs_free(weapon);
 }
 
-mg_weapon_shoot_result mg_weapon_shoot(mg_weapon_t *weapon, gs_vqs origin)
+mg_weapon_shoot_result mg_weapon_shoot(mg_weapon_t *weapon, gs_vqs origin, const void *owner)
 {
 	if (weapon->ammo_current <= 0)
 	{
 		return MG_WEAPON_RESULT_NO_AMMO;
 	}
 
-	double time = g_time_manager->time;
+	double time = g_time_manager->tick_time;
 
 	if (time - weapon->last_shot < weapon->shoot_interval)
 	{
@@ -85,17 +86,29 @@ mg_weapon_shoot_result mg_weapon_shoot(mg_weapon_t *weapon, gs_vqs origin)
 	switch (weapon->type)
 	{
 	case MG_WEAPON_MACHINE_GUN:
-		// TODO: trace
+		mg_hitscan_add(
+			&g_entity_manager->hitscan,
+			(mg_hitscan_ray_t){
+				.start	      = origin.position,
+				.end	      = gs_vec3_add(origin.position, gs_vec3_scale(mg_get_forward(origin.rotation), MG_WEAPON_HITSCAN_RANGE)),
+				.content_mask = BSP_CONTENT_CONTENTS_SOLID,
+				.ignore	      = owner,
+				.time	      = time,
+				.on_hit	      = _mg_weapon_bullet_hit,
+				.user	      = weapon,
+			});
 		break;
 
 	case MG_WEAPON_ROCKET_LAUNCHER:
-		mg_rocket_new(gs_vqs_absolute_transform(
-			&(gs_vqs){
-				.position = gs_vec3_scale(MG_AXIS_DOWN, 8.0f),
-				.rotation = gs_quat_default(),
-				.scale	  = gs_v3(1.0f, 1.0f, 1.0f),
-			},
-			&origin));
+		mg_rocket_new(
+			gs_vqs_absolute_transform(
+				&(gs_vqs){
+					.position = gs_vec3_scale(MG_AXIS_DOWN, 8.0f),
+					.rotation = gs_quat_default(),
+					.scale	  = gs_v3(1.0f, 1.0f, 1.0f),
+				},
+				&origin),
+			owner);
 		break;
 
 	default:
@@ -106,4 +119,17 @@ mg_weapon_shoot_result mg_weapon_shoot(mg_weapon_t *weapon, gs_vqs origin)
 	// TODO: sound
 
 	return MG_WEAPON_RESULT_SHOT;
-}
\ No newline at end of file
+}
+
+void _mg_weapon_bullet_hit(mg_weapon_t *weapon, const mg_hitscan_hit_t *hit)
+{
+	if (hit->fraction == 1.0f)
+	{
+		return;
+	}
+
+	if (hit->entity != NULL)
+	{
+		mg_ent_damage(hit->entity, MG_WEAPON_BULLET_DAMAGE);
+	}
+}
@@ -13,6 +13,10 @@
 #include <gs/gs.h>
 
 #include "../graphics/model_manager.h"
+#include "hitscan.h"
+
+#define MG_WEAPON_HITSCAN_RANGE 8192.0f
+#define MG_WEAPON_BULLET_DAMAGE 7
 
 typedef enum mg_ammo_type
 {
@@ -53,6 +57,7 @@ typedef struct mg_weapon_t
 
 mg_weapon_t *mg_weapon_create(mg_weapon_type type);
 void mg_weapon_free(mg_weapon_t *weapon);
-mg_weapon_shoot_result mg_weapon_shoot(mg_weapon_t *weapon, gs_vqs origin);
+mg_weapon_shoot_result mg_weapon_shoot(mg_weapon_t *weapon, gs_vqs origin, const void *owner);
+void _mg_weapon_bullet_hit(mg_weapon_t *weapon, const mg_hitscan_hit_t *hit);
 
 #endif // MG_WEAPON_H
\ No newline at end of file
@@ -36,7 +36,7 @@ void mg_rocket_trail_update(mg_rocket_trail_t *trail, double dt)
 {
 	if (!trail->attached)
 	{
-		double frac = (g_time_manager->time - trail->detach_time) / MG_ROCKET_TRAIL_FADE_TIME;
+		double frac = (g_time_manager->tick_time - trail->detach_time) / MG_ROCKET_TRAIL_FADE_TIME;
 		if (frac >= 1.0)
 		{
 			mg_rocket_trail_remove(trail);
@@ -73,5 +73,5 @@ void mg_rocket_trail_detach(mg_rocket_trail_t *trail)
 {
 	trail->attached		= false;
 	trail->rocket_transform = NULL;
-	trail->detach_time	= g_time_manager->time;
+	trail->detach_time	= g_time_manager->tick_time;
 }
\ No newline at end of file
@@ -0,0 +1,738 @@
+/*================================================================
+	* game/bench.c
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Console commands for benchmarking hot paths
+	against the currently loaded map.
+=================================================================*/
+
+#include "bench.h"
+#include "../bsp/bsp_point.h"
+#include "../bsp/bsp_trace.h"
+#include "../bsp/bsp_vis.h"
+#include "../entities/broadphase.h"
+#include "../entities/entity.h"
+#include "../entities/hitscan.h"
+#include "../entities/player.h"
+#include "../entities/weapon.h"
+#include "../graphics/renderer.h"
+#include "../graphics/texture_manager.h"
+#include "../util/camera.h"
+#include "../util/name_map.h"
+#include "console.h"
+#include "game_manager.h"
+#include "job_manager.h"
+
+void mg_bench_init()
+{
+	mg_cmd_new("bench_frustum", "Benchmark leaf frustum culling, per leaf vs batched", &mg_bench_frustum, NULL, 0);
+	mg_cmd_new("bench_vis", "Benchmark random cluster to cluster visibility queries", &mg_bench_vis, NULL, 0);
+	mg_cmd_new("bench_trace", "Benchmark random box traces, single vs batched on 1, 2, 4 and 8 threads", &mg_bench_trace, NULL, 0);
+	mg_cmd_new("bench_broadphase", "Benchmark entity broadphase moves, swept box and sphere queries", &mg_bench_broadphase, NULL, 0);
+	mg_cmd_new("bench_hitscan", "Benchmark batched hitscan rays against single world and entity traces", &mg_bench_hitscan, NULL, 0);
+	mg_cmd_new("bench_point", "Benchmark cached point leaf lookups of moving points against walking from the root", &mg_bench_point, NULL, 0);
+	mg_cmd_new("bench_textures", "Benchmark decoding the map textures, serial vs on job threads", &mg_bench_textures, NULL, 0);
+	mg_cmd_new("bench_names", "Benchmark name lookups in a large registry, linear scan vs hashed", &mg_bench_names, NULL, 0);
+}
+
+void mg_bench_frustum()
+{
+	bsp_map_t *map = _mg_bench_get_map();
+	if (map == NULL || g_renderer->cam == NULL)
+	{
+		return;
+	}
+
+	uint32_t count = map->leaves.count;
+	float *mins[3];
+	float *maxs[3];
+	for (size_t i = 0; i < 3; i++)
+	{
+		mins[i] = gs_malloc(count * sizeof(float));
+		maxs[i] = gs_malloc(count * sizeof(float));
+		for (size_t j = 0; j < count; j++)
+		{
+			mins[i][j] = map->leaves.data[j].mins[i];
+			maxs[i][j] = map->leaves.data[j].maxs[i];
+		}
+	}
+	uint8_t *visible = gs_malloc(count * sizeof(uint8_t));
+
+	gs_mat4 proj	       = mg_camera_get_view_projection(g_renderer->cam, (s32)g_renderer->fb_size.x, (s32)g_renderer->fb_size.y);
+	mg_camera_frustum_t fr = mg_camera_get_frustum_planes(proj, false);
+
+	uint32_t scalar_visible = 0;
+	double start		= gs_platform_elapsed_time();
+	for (size_t i = 0; i < MG_BENCH_FRUSTUM_ITERATIONS; i++)
+	{
+		scalar_visible = 0;
+		for (size_t j = 0; j < count; j++)
+		{
+			scalar_visible += mg_camera_aabb_in_frustum(
+				fr,
+				gs_v3(mins[0][j], mins[1][j], mins[2][j]),
+				gs_v3(maxs[0][j], maxs[1][j], maxs[2][j]));
+		}
+	}
+	double scalar_ms = gs_platform_elapsed_time() - start;
+
+	uint32_t batch_visible = 0;
+	start		       = gs_platform_elapsed_time();
+	for (size_t i = 0; i < MG_BENCH_FRUSTUM_ITERATIONS; i++)
+	{
+		batch_visible = mg_camera_aabbs_in_frustum(&fr, (const float *const *)mins, (const float *const *)maxs, count, visible);
+	}
+	double batch_ms = gs_platform_elapsed_time() - start;
+
+	mg_println("bench_frustum: %u leaves, %d iterations", count, MG_BENCH_FRUSTUM_ITERATIONS);
+	mg_println("  per leaf: %.4f ms/pass, %u visible", scalar_ms / MG_BENCH_FRUSTUM_ITERATIONS, scalar_visible);
+	mg_println("  batched:  %.4f ms/pass, %u visible (simd width %d)", batch_ms / MG_BENCH_FRUSTUM_ITERATIONS, batch_visible, MG_CAMERA_SIMD_WIDTH);
+
+	for (size_t i = 0; i < 3; i++)
+	{
+		gs_free(mins[i]);
+		gs_free(maxs[i]);
+	}
+	gs_free(visible);
+}
+
+void mg_bench_vis()
+{
+	bsp_map_t *map = _mg_bench_get_map();
+	if (map == NULL)
+	{
+		return;
+	}
+
+	int32_t num_clusters = map->vis.num_clusters;
+	if (num_clusters == 0)
+	{
+		mg_println("WARN: mg_bench_vis map has no clusters");
+		return;
+	}
+
+	// Same pairs for every pass, generated up front
+	int32_t *pairs = gs_malloc(MG_BENCH_VIS_QUERIES * 2 * sizeof(int32_t));
+	srand(1234);
+	for (size_t i = 0; i < MG_BENCH_VIS_QUERIES * 2; i++)
+	{
+		pairs[i] = rand() % num_clusters;
+	}
+
+	// Packed visdata bytes, one bit at a time
+	uint32_t raw_visible = 0;
+	double start	     = gs_platform_elapsed_time();
+	if (map->visdata.num_vecs > 0)
+	{
+		for (size_t i = 0; i < MG_BENCH_VIS_QUERIES; i++)
+		{
+			int32_t from = pairs[i * 2];
+			int32_t to   = pairs[i * 2 + 1];
+			raw_visible += (map->visdata.vecs[from * map->visdata.size_vecs + (to >> 3)] & (1 << (to & 7))) != 0;
+		}
+	}
+	else
+	{
+		raw_visible = MG_BENCH_VIS_QUERIES;
+	}
+	double raw_ms = gs_platform_elapsed_time() - start;
+
+	uint32_t visible = 0;
+	start		 = gs_platform_elapsed_time();
+	for (size_t i = 0; i < MG_BENCH_VIS_QUERIES; i++)
+	{
+		visible += bsp_cluster_can_see(&map->vis, pairs[i * 2], pairs[i * 2 + 1]);
+	}
+	double pvs_ms = gs_platform_elapsed_time() - start;
+
+	// First pass builds the hearable rows
+	uint32_t hearable = 0;
+	start		  = gs_platform_elapsed_time();
+	for (size_t i = 0; i < MG_BENCH_VIS_QUERIES; i++)
+	{
+		hearable += bsp_cluster_can_hear(&map->vis, pairs[i * 2], pairs[i * 2 + 1]);
+	}
+	double phs_cold_ms = gs_platform_elapsed_time() - start;
+
+	hearable = 0;
+	start	 = gs_platform_elapsed_time();
+	for (size_t i = 0; i < MG_BENCH_VIS_QUERIES; i++)
+	{
+		hearable += bsp_cluster_can_hear(&map->vis, pairs[i * 2], pairs[i * 2 + 1]);
+	}
+	double phs_ms = gs_platform_elapsed_time() - start;
+
+	mg_println("bench_vis: %d clusters, %d queries", num_clusters, MG_BENCH_VIS_QUERIES);
+	mg_println("  packed bytes: %.3f ms, %u visible", raw_ms, raw_visible);
+	mg_println("  pvs rows:     %.3f ms, %u visible", pvs_ms, visible);
+	mg_println("  phs rows:     %.3f ms (%.3f ms first pass), %u hearable", phs_ms, phs_cold_ms, hearable);
+	if (raw_visible != visible)
+	{
+		mg_println("WARN: mg_bench_vis pvs rows disagree with packed visdata");
+	}
+
+	gs_free(pairs);
+}
+
+void mg_bench_trace()
+{
+	bsp_map_t *map = _mg_bench_get_map();
+	if (map == NULL)
+	{
+		return;
+	}
+
+	// Random player sized boxes inside the root node bounds
+	bsp_node_lump_t root	      = map->nodes.data[0];
+	bsp_trace_request_t *requests = gs_malloc(MG_BENCH_TRACE_COUNT * sizeof(bsp_trace_request_t));
+	srand(1234);
+	for (size_t i = 0; i < MG_BENCH_TRACE_COUNT; i++)
+	{
+		float32_t p[6];
+		for (size_t j = 0; j < 6; j++)
+		{
+			float32_t t = (float32_t)rand() / (float32_t)RAND_MAX;
+			p[j]	    = root.mins[j % 3] + t * (root.maxs[j % 3] - root.mins[j % 3]);
+		}
+
+		requests[i] = (bsp_trace_request_t){
+			.type	      = BOX,
+			.start	      = gs_v3(p[0], p[1], p[2]),
+			.end	      = gs_v3(p[3], p[4], p[5]),
+			.mins	      = gs_v3(-MG_PLAYER_HALF_WIDTH, -MG_PLAYER_HALF_WIDTH, 0),
+			.maxs	      = gs_v3(MG_PLAYER_HALF_WIDTH, MG_PLAYER_HALF_WIDTH, MG_PLAYER_HEIGHT),
+			.content_mask = BSP_CONTENT_CONTENTS_SOLID | BSP_CONTENT_CONTENTS_PLAYERCLIP,
+		};
+	}
+
+	bsp_trace_t *expected = gs_malloc(MG_BENCH_TRACE_COUNT * sizeof(bsp_trace_t));
+	bsp_trace_t *results  = gs_malloc(MG_BENCH_TRACE_COUNT * sizeof(bsp_trace_t));
+
+	uint32_t hits	 = 0;
+	uint64_t nodes	 = 0;
+	uint64_t brushes = 0;
+	uint64_t skipped = 0;
+	uint64_t culled	 = 0;
+	double start	 = gs_platform_elapsed_time();
+	for (size_t i = 0; i < MG_BENCH_TRACE_COUNT; i++)
+	{
+		const bsp_trace_request_t *req = &requests[i];
+		expected[i]		       = (bsp_trace_t){.map = map};
+		bsp_trace_box(&expected[i], req->start, req->end, req->mins, req->maxs, req->content_mask);
+		hits += expected[i].fraction < 1.0f;
+		nodes += expected[i].nodes_visited;
+		brushes += expected[i].brushes_tested;
+		skipped += expected[i].brushes_skipped;
+		culled += expected[i].brushes_culled;
+	}
+	double single_ms = gs_platform_elapsed_time() - start;
+
+	mg_println("bench_trace: %d box traces, %u hit", MG_BENCH_TRACE_COUNT, hits);
+	mg_println("  single:    %.3f ms", single_ms);
+	mg_println("  per trace: %.1f nodes, %.1f brushes clipped, %.1f culled by bounds, %.1f duplicates skipped", (double)nodes / MG_BENCH_TRACE_COUNT, (double)brushes / MG_BENCH_TRACE_COUNT, (double)culled / MG_BENCH_TRACE_COUNT, (double)skipped / MG_BENCH_TRACE_COUNT);
+
+	// Same traces clipping brush lumps instead of packed brushes
+	start = gs_platform_elapsed_time();
+	for (size_t i = 0; i < MG_BENCH_TRACE_COUNT; i++)
+	{
+		const bsp_trace_request_t *req = &requests[i];
+		results[i]		       = (bsp_trace_t){.map = map, .reference = true};
+		bsp_trace_box(&results[i], req->start, req->end, req->mins, req->maxs, req->content_mask);
+	}
+	double lumps_ms = gs_platform_elapsed_time() - start;
+
+	// Compare bits, not values
+	uint32_t lump_mismatches = 0;
+	for (size_t i = 0; i < MG_BENCH_TRACE_COUNT; i++)
+	{
+		lump_mismatches += memcmp(&results[i].fraction, &expected[i].fraction, sizeof(float32_t)) != 0 ||
+				   memcmp(&results[i].normal, &expected[i].normal, sizeof(gs_vec3)) != 0;
+	}
+
+	mg_println("  lumps:     %.3f ms, packed brushes %.2fx", lumps_ms, lumps_ms / gs_max(single_ms, DBL_MIN));
+	if (lump_mismatches > 0)
+	{
+		mg_println("WARN: mg_bench_trace %u packed brush traces differ from brush lump traces", lump_mismatches);
+	}
+
+	// Same traces without patch facets
+	uint32_t patch_hits = 0;
+	start		    = gs_platform_elapsed_time();
+	for (size_t i = 0; i < MG_BENCH_TRACE_COUNT; i++)
+	{
+		const bsp_trace_request_t *req = &requests[i];
+		results[i]		       = (bsp_trace_t){.map = map, .skip_patches = true};
+		bsp_trace_box(&results[i], req->start, req->end, req->mins, req->maxs, req->content_mask);
+		patch_hits += results[i].fraction != expected[i].fraction;
+	}
+	double no_patches_ms = gs_platform_elapsed_time() - start;
+
+	bsp_trace_brushes_t *packed = &map->trace_brushes;
+	mg_println("  no patches: %.3f ms, %u patches with %u facets add %.3f ms, change %u traces", no_patches_ms, packed->num_patches, packed->num_brushes - map->brushes.count, single_ms - no_patches_ms, patch_hits);
+
+	uint32_t thread_counts[] = {1, 2, 4, 8};
+	for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++)
+	{
+		memset(results, 0, MG_BENCH_TRACE_COUNT * sizeof(bsp_trace_t));
+
+		start = gs_platform_elapsed_time();
+		bsp_trace_batch(map, requests, results, MG_BENCH_TRACE_COUNT, thread_counts[i]);
+		double batch_ms = gs_platform_elapsed_time() - start;
+
+		uint32_t mismatches = 0;
+		for (size_t j = 0; j < MG_BENCH_TRACE_COUNT; j++)
+		{
+			mismatches += results[j].fraction != expected[j].fraction || results[j].all_solid != expected[j].all_solid;
+		}
+
+		mg_println("  %u threads: %.3f ms, %.2fx", thread_counts[i], batch_ms, single_ms / gs_max(batch_ms, DBL_MIN));
+		if (mismatches > 0)
+		{
+			mg_println("WARN: mg_bench_trace %u batched traces differ from single traces", mismatches);
+		}
+	}
+
+	gs_free(requests);
+	gs_free(expected);
+	gs_free(results);
+}
+
+void mg_bench_broadphase()
+{
+	mg_broadphase_t bp;
+	mg_broadphase_init(&bp);
+
+	// Random boxes moving around a cube
+	gs_vec3 *positions  = gs_malloc(MG_BENCH_BROADPHASE_ENTS * sizeof(gs_vec3));
+	gs_vec3 *velocities = gs_malloc(MG_BENCH_BROADPHASE_ENTS * sizeof(gs_vec3));
+	gs_vec3 *extents    = gs_malloc(MG_BENCH_BROADPHASE_ENTS * sizeof(gs_vec3));
+	uint32_t *proxies   = gs_malloc(MG_BENCH_BROADPHASE_ENTS * sizeof(uint32_t));
+	srand(1234);
+	for (size_t i = 0; i < MG_BENCH_BROADPHASE_ENTS; i++)
+	{
+		for (size_t j = 0; j < 3; j++)
+		{
+			positions[i].xyz[j]  = ((float32_t)rand() / (float32_t)RAND_MAX) * MG_BENCH_BROADPHASE_EXTENTS;
+			velocities[i].xyz[j] = ((float32_t)rand() / (float32_t)RAND_MAX - 0.5f) * 640.0f;
+			extents[i].xyz[j]    = 8.0f + ((float32_t)rand() / (float32_t)RAND_MAX) * 24.0f;
+		}
+		proxies[i] = mg_broadphase_add(&bp, &positions[i], gs_vec3_sub(positions[i], extents[i]), gs_vec3_add(positions[i], extents[i]));
+	}
+
+	gs_vec3 box_mins = gs_v3(-8.0f, -8.0f, -8.0f);
+	gs_vec3 box_maxs = gs_v3(8.0f, 8.0f, 8.0f);
+
+	double move_ms	    = 0;
+	double sweep_ms	    = 0;
+	double sphere_ms    = 0;
+	uint32_t hits	    = 0;
+	uint64_t overlaps   = 0;
+	uint32_t mismatches = 0;
+	for (size_t frame = 0; frame < MG_BENCH_BROADPHASE_FRAMES; frame++)
+	{
+		double start = gs_platform_elapsed_time();
+		for (size_t i = 0; i < MG_BENCH_BROADPHASE_ENTS; i++)
+		{
+			positions[i] = gs_vec3_add(positions[i], gs_vec3_scale(velocities[i], 1.0f / 60.0f));
+			for (size_t j = 0; j < 3; j++)
+			{
+				if (positions[i].xyz[j] < 0 || positions[i].xyz[j] > MG_BENCH_BROADPHASE_EXTENTS)
+				{
+					velocities[i].xyz[j] = -velocities[i].xyz[j];
+				}
+			}
+			mg_broadphase_move(&bp, proxies[i], gs_vec3_sub(positions[i], extents[i]), gs_vec3_add(positions[i], extents[i]));
+		}
+		move_ms += gs_platform_elapsed_time() - start;
+
+		// Projectile sized sweeps from random entities
+		for (size_t i = 0; i < MG_BENCH_BROADPHASE_QUERIES; i++)
+		{
+			size_t ent	   = rand() % MG_BENCH_BROADPHASE_ENTS;
+			gs_vec3 dir	   = gs_v3((float32_t)rand() / (float32_t)RAND_MAX - 0.5f, (float32_t)rand() / (float32_t)RAND_MAX - 0.5f, (float32_t)rand() / (float32_t)RAND_MAX - 0.5f);
+			gs_vec3 sweep_end  = gs_vec3_add(positions[ent], gs_vec3_scale(dir, 512.0f));
+			float32_t fraction = 0;
+			gs_vec3 normal;
+
+			start	  = gs_platform_elapsed_time();
+			void *hit = mg_broadphase_sweep(&bp, positions[ent], sweep_end, box_mins, box_maxs, 1.0f, &positions[ent], &fraction, &normal);
+			sweep_ms += gs_platform_elapsed_time() - start;
+			hits += hit != NULL;
+
+			// Against every entity
+			float32_t expected = 1.0f;
+			for (size_t j = 0; j < MG_BENCH_BROADPHASE_ENTS; j++)
+			{
+				float32_t f;
+				gs_vec3 n;
+				if (j != ent && _mg_broadphase_sweep_aabb(positions[ent], sweep_end, gs_vec3_sub(bp.proxies[proxies[j]].mins, box_maxs), gs_vec3_sub(bp.proxies[proxies[j]].maxs, box_mins), &f, &n))
+				{
+					expected = fminf(expected, f);
+				}
+			}
+			mismatches += (hit != NULL ? fraction : 1.0f) != expected;
+		}
+
+		start = gs_platform_elapsed_time();
+		for (size_t i = 0; i < MG_BENCH_BROADPHASE_QUERIES; i++)
+		{
+			overlaps += mg_broadphase_query_sphere(&bp, positions[rand() % MG_BENCH_BROADPHASE_ENTS], 120.0f);
+		}
+		sphere_ms += gs_platform_elapsed_time() - start;
+	}
+
+	uint32_t num_queries = MG_BENCH_BROADPHASE_FRAMES * MG_BENCH_BROADPHASE_QUERIES;
+	mg_println("bench_broadphase: %d entities, %d frames", MG_BENCH_BROADPHASE_ENTS, MG_BENCH_BROADPHASE_FRAMES);
+	mg_println("  move:   %.3f ms per frame", move_ms / MG_BENCH_BROADPHASE_FRAMES);
+	mg_println("  sweep:  %.3f us per query, %u hit", sweep_ms * 1000.0 / num_queries, hits);
+	mg_println("  sphere: %.3f us per query, %.1f entities per query", sphere_ms * 1000.0 / num_queries, (double)overlaps / num_queries);
+	if (mismatches > 0)
+	{
+		mg_println("WARN: mg_bench_broadphase %u sweeps differ from testing every entity", mismatches);
+	}
+
+	mg_broadphase_free(&bp);
+	gs_free(positions);
+	gs_free(velocities);
+	gs_free(extents);
+	gs_free(proxies);
+}
+
+void mg_bench_hitscan()
+{
+	// World is optional, entities are random player sized boxes
+	bsp_map_t *map = NULL;
+	gs_vec3 mins   = gs_v3(0, 0, 0);
+	gs_vec3 maxs   = gs_v3(MG_BENCH_BROADPHASE_EXTENTS, MG_BENCH_BROADPHASE_EXTENTS, MG_BENCH_BROADPHASE_EXTENTS);
+	if (g_game_manager != NULL && g_game_manager->map != NULL && g_game_manager->map->valid)
+	{
+		bsp_node_lump_t root = g_game_manager->map->nodes.data[0];
+		map		     = g_game_manager->map;
+		mins		     = gs_v3(root.mins[0], root.mins[1], root.mins[2]);
+		maxs		     = gs_v3(root.maxs[0], root.maxs[1], root.maxs[2]);
+	}
+
+	mg_broadphase_t bp;
+	mg_broadphase_init(&bp);
+	mg_entity_t *ents = gs_malloc(MG_BENCH_BROADPHASE_ENTS * sizeof(mg_entity_t));
+	srand(1234);
+	for (size_t i = 0; i < MG_BENCH_BROADPHASE_ENTS; i++)
+	{
+		ents[i] = (mg_entity_t){
+			.id   = i,
+			.mins = gs_v3(-MG_PLAYER_HALF_WIDTH, -MG_PLAYER_HALF_WIDTH, 0),
+			.maxs = gs_v3(MG_PLAYER_HALF_WIDTH, MG_PLAYER_HALF_WIDTH, MG_PLAYER_HEIGHT),
+		};
+		for (size_t j = 0; j < 3; j++)
+		{
+			ents[i].transform.position.xyz[j] = mins.xyz[j] + ((float32_t)rand() / (float32_t)RAND_MAX) * (maxs.xyz[j] - mins.xyz[j]);
+		}
+		ents[i].proxy = mg_broadphase_add(&bp, &ents[i], gs_vec3_add(ents[i].transform.position, ents[i].mins), gs_vec3_add(ents[i].transform.position, ents[i].maxs));
+	}
+
+	mg_hitscan_t hs;
+	mg_hitscan_init(&hs);
+	float32_t *fractions = gs_malloc(MG_BENCH_HITSCAN_RAYS * sizeof(float32_t));
+	void **hit_ents	     = gs_malloc(MG_BENCH_HITSCAN_RAYS * sizeof(void *));
+
+	double single_ms    = 0;
+	double batch_ms	    = 0;
+	double spread_ms    = 0;
+	uint32_t world_hits = 0;
+	uint32_t ent_hits   = 0;
+	uint32_t mismatches = 0;
+	for (size_t tick = 0; tick < MG_BENCH_HITSCAN_TICKS; tick++)
+	{
+		// Rays from random entities in random directions
+		for (size_t i = 0; i < MG_BENCH_HITSCAN_RAYS; i++)
+		{
+			mg_entity_t *shooter = &ents[rand() % MG_BENCH_BROADPHASE_ENTS];
+			gs_vec3 dir	     = gs_vec3_norm(gs_v3((float32_t)rand() / (float32_t)RAND_MAX - 0.5f, (float32_t)rand() / (float32_t)RAND_MAX - 0.5f, (float32_t)rand() / (float32_t)RAND_MAX - 0.5f));
+			gs_vec3 eye	     = gs_vec3_add(shooter->transform.position, gs_v3(0, 0, MG_PLAYER_HEIGHT * 0.5f));
+			mg_hitscan_add(
+				&hs,
+				(mg_hitscan_ray_t){
+					.start	      = eye,
+					.end	      = gs_vec3_add(eye, gs_vec3_scale(dir, MG_WEAPON_HITSCAN_RANGE)),
+					.content_mask = BSP_CONTENT_CONTENTS_SOLID,
+					.ignore	      = shooter,
+				});
+		}
+
+		// One world trace and entity sweep per ray
+		double start = gs_platform_elapsed_time();
+		for (size_t i = 0; i < MG_BENCH_HITSCAN_RAYS; i++)
+		{
+			const mg_hitscan_ray_t *ray = &hs.rays[i];
+			bsp_trace_t trace	    = {.map = map, .fraction = 1.0f};
+			if (map != NULL)
+			{
+				bsp_trace_ray(&trace, ray->start, ray->end, ray->content_mask);
+			}
+
+			float32_t fraction;
+			gs_vec3 normal;
+			hit_ents[i]  = mg_broadphase_sweep(&bp, ray->start, ray->end, gs_v3(0, 0, 0), gs_v3(0, 0, 0), trace.fraction, ray->ignore, &fraction, &normal);
+			fractions[i] = hit_ents[i] != NULL ? fraction : trace.fraction;
+		}
+		single_ms += gs_platform_elapsed_time() - start;
+
+		start = gs_platform_elapsed_time();
+		mg_hitscan_flush(&hs, map, &bp, MG_JOB_MANAGER_THREADS);
+		batch_ms += gs_platform_elapsed_time() - start;
+
+		for (size_t i = 0; i < MG_BENCH_HITSCAN_RAYS; i++)
+		{
+			world_hits += hs.hits[i].entity == NULL && hs.hits[i].fraction < 1.0f;
+			ent_hits += hs.hits[i].entity != NULL;
+			mismatches += hs.hits[i].fraction != fractions[i] || (void *)hs.hits[i].entity != hit_ents[i];
+		}
+
+		// Every pellet of a single shot in one batch
+		mg_entity_t *shooter = &ents[rand() % MG_BENCH_BROADPHASE_ENTS];
+		start		     = gs_platform_elapsed_time();
+		mg_hitscan_add_spread(
+			&hs,
+			(mg_hitscan_ray_t){
+				.start	      = shooter->transform.position,
+				.end	      = gs_vec3_add(shooter->transform.position, gs_v3(MG_WEAPON_HITSCAN_RANGE, 0, 0)),
+				.content_mask = BSP_CONTENT_CONTENTS_SOLID,
+				.ignore	      = shooter,
+			},
+			MG_BENCH_HITSCAN_RAYS,
+			0.1f);
+		mg_hitscan_flush(&hs, map, &bp, MG_JOB_MANAGER_THREADS);
+		spread_ms += gs_platform_elapsed_time() - start;
+	}
+
+	mg_println("bench_hitscan: %d rays per tick, %d ticks, %d entities, %s", MG_BENCH_HITSCAN_RAYS, MG_BENCH_HITSCAN_TICKS, MG_BENCH_BROADPHASE_ENTS, map != NULL ? "world" : "no map");
+	mg_println("  single:  %.3f ms per tick, %u world hits, %u entity hits", single_ms / MG_BENCH_HITSCAN_TICKS, world_hits, ent_hits);
+	mg_println("  batched: %.3f ms per tick, %.2fx", batch_ms / MG_BENCH_HITSCAN_TICKS, single_ms / gs_max(batch_ms, DBL_MIN));
+	mg_println("  spread:  %.3f ms per tick, one shot of %d pellets", spread_ms / MG_BENCH_HITSCAN_TICKS, MG_BENCH_HITSCAN_RAYS);
+	if (mismatches > 0)
+	{
+		mg_println("WARN: mg_bench_hitscan %u batched rays differ from single traces", mismatches);
+	}
+
+	mg_hitscan_free(&hs);
+	mg_broadphase_free(&bp);
+	gs_free(ents);
+	gs_free(fractions);
+	gs_free(hit_ents);
+}
+
+void mg_bench_point()
+{
+	bsp_map_t *map = _mg_bench_get_map();
+	if (map == NULL)
+	{
+		return;
+	}
+
+	// Random points drifting inside the root node bounds
+	bsp_node_lump_t root = map->nodes.data[0];
+	gs_vec3 *points	     = gs_malloc(MG_BENCH_POINT_COUNT * sizeof(gs_vec3));
+	gs_vec3 *velocities  = gs_malloc(MG_BENCH_POINT_COUNT * sizeof(gs_vec3));
+	int32_t *expected    = gs_malloc(MG_BENCH_POINT_COUNT * sizeof(int32_t));
+	int32_t *cached	     = gs_calloc(MG_BENCH_POINT_COUNT, sizeof(int32_t));
+	int32_t *batched     = gs_calloc(MG_BENCH_POINT_COUNT, sizeof(int32_t));
+	srand(1234);
+	for (size_t i = 0; i < MG_BENCH_POINT_COUNT; i++)
+	{
+		for (size_t j = 0; j < 3; j++)
+		{
+			points[i].xyz[j]     = root.mins[j] + ((float32_t)rand() / (float32_t)RAND_MAX) * (root.maxs[j] - root.mins[j]);
+			velocities[i].xyz[j] = ((float32_t)rand() / (float32_t)RAND_MAX * 2.0f - 1.0f) * MG_BENCH_POINT_STEP;
+		}
+	}
+
+	double root_ms	    = 0;
+	double cached_ms    = 0;
+	double batched_ms   = 0;
+	uint32_t changes    = 0;
+	uint32_t mismatches = 0;
+	for (size_t frame = 0; frame < MG_BENCH_POINT_FRAMES; frame++)
+	{
+		for (size_t i = 0; i < MG_BENCH_POINT_COUNT; i++)
+		{
+			points[i] = gs_vec3_add(points[i], velocities[i]);
+			for (size_t j = 0; j < 3; j++)
+			{
+				if (points[i].xyz[j] < root.mins[j] || points[i].xyz[j] > root.maxs[j])
+				{
+					velocities[i].xyz[j] = -velocities[i].xyz[j];
+				}
+			}
+		}
+
+		double start = gs_platform_elapsed_time();
+		for (size_t i = 0; i < MG_BENCH_POINT_COUNT; i++)
+		{
+			expected[i] = _bsp_find_camera_leaf(map, points[i]);
+		}
+		root_ms += gs_platform_elapsed_time() - start;
+
+		start = gs_platform_elapsed_time();
+		for (size_t i = 0; i < MG_BENCH_POINT_COUNT; i++)
+		{
+			int32_t previous = cached[i];
+			bsp_point_leaf(map, points[i], &cached[i]);
+			changes += cached[i] != previous;
+		}
+		cached_ms += gs_platform_elapsed_time() - start;
+
+		start = gs_platform_elapsed_time();
+		bsp_point_leaf_batch(map, points, batched, MG_BENCH_POINT_COUNT, MG_JOB_MANAGER_THREADS);
+		batched_ms += gs_platform_elapsed_time() - start;
+
+		for (size_t i = 0; i < MG_BENCH_POINT_COUNT; i++)
+		{
+			mismatches += cached[i] != expected[i] || batched[i] != expected[i];
+		}
+	}
+
+	mg_println("bench_point: %d points, %d frames, %u leaf changes, %u planes checked by %u leaves", MG_BENCH_POINT_COUNT, MG_BENCH_POINT_FRAMES, changes, gs_dyn_array_size(map->point_leaves.planes), map->leaves.count);
+	mg_println("  from root: %.3f ms per frame", root_ms / MG_BENCH_POINT_FRAMES);
+	mg_println("  cached:    %.3f ms per frame, %.2fx", cached_ms / MG_BENCH_POINT_FRAMES, root_ms / gs_max(cached_ms, DBL_MIN));
+	mg_println("  batched:   %.3f ms per frame, %.2fx", batched_ms / MG_BENCH_POINT_FRAMES, root_ms / gs_max(batched_ms, DBL_MIN));
+	if (mismatches > 0)
+	{
+		mg_println("WARN: mg_bench_point %u cached leaves differ from walking from the root", mismatches);
+	}
+
+	gs_free(points);
+	gs_free(velocities);
+	gs_free(expected);
+	gs_free(cached);
+	gs_free(batched);
+}
+
+void mg_bench_textures()
+{
+	bsp_map_t *map = _mg_bench_get_map();
+	if (map == NULL)
+	{
+		return;
+	}
+
+	// Skip textures that failed to load to keep the output clean
+	gs_dyn_array(mg_texture_decode_t) jobs = NULL;
+	for (size_t i = 0; i < map->textures.count; i++)
+	{
+		if (mg_texture_manager_find(map->textures.data[i].name) != NULL)
+		{
+			gs_dyn_array_push(jobs, ((mg_texture_decode_t){.filename = map->textures.data[i].name}));
+		}
+	}
+	uint32_t count = gs_dyn_array_size(jobs);
+
+	double start = gs_platform_elapsed_time();
+	_mg_bench_decode_textures(jobs, 0, count, 0);
+	double serial_ms = gs_platform_elapsed_time() - start;
+
+	uint64_t bytes = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		bytes += (uint64_t)jobs[i].width * jobs[i].height * 4;
+		gs_free(jobs[i].data);
+		jobs[i].data = NULL;
+	}
+
+	start = gs_platform_elapsed_time();
+	mg_job_manager_parallel_for(&_mg_bench_decode_textures, jobs, count, 1, MG_JOB_MANAGER_THREADS);
+	double parallel_ms = gs_platform_elapsed_time() - start;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		gs_free(jobs[i].data);
+	}
+	gs_dyn_array_free(jobs);
+
+	mg_println("bench_textures: %u textures, %.2f MB decoded", count, bytes / (1024.0 * 1024.0));
+	mg_println("  serial:    %.3f ms", serial_ms);
+	mg_println("  %u threads: %.3f ms, %.2fx", MG_JOB_MANAGER_THREADS, parallel_ms, serial_ms / gs_max(parallel_ms, DBL_MIN));
+}
+
+void mg_bench_names()
+{
+	// Asset like names sharing a long prefix, like texture paths do
+	char **names   = gs_malloc(MG_BENCH_NAMES_COUNT * sizeof(char *));
+	uint32_t *keys = gs_malloc(MG_BENCH_NAMES_LOOKUPS * sizeof(uint32_t));
+	mg_name_map_t map;
+	mg_name_map_init(&map, MG_BENCH_NAMES_COUNT);
+	for (size_t i = 0; i < MG_BENCH_NAMES_COUNT; i++)
+	{
+		names[i] = gs_malloc(MG_BENCH_NAMES_LEN);
+		snprintf(names[i], MG_BENCH_NAMES_LEN, "textures/bench/name_%05zu", i);
+		mg_name_map_set(&map, names[i], i);
+	}
+
+	srand(1234);
+	for (size_t i = 0; i < MG_BENCH_NAMES_LOOKUPS; i++)
+	{
+		keys[i] = rand() % MG_BENCH_NAMES_COUNT;
+	}
+
+	uint32_t mismatches = 0;
+	double start	    = gs_platform_elapsed_time();
+	for (size_t i = 0; i < MG_BENCH_NAMES_LOOKUPS; i++)
+	{
+		for (size_t j = 0; j < MG_BENCH_NAMES_COUNT; j++)
+		{
+			if (strcmp(names[j], names[keys[i]]) == 0)
+			{
+				mismatches += j != keys[i];
+				break;
+			}
+		}
+	}
+	double linear_ms = gs_platform_elapsed_time() - start;
+
+	start = gs_platform_elapsed_time();
+	for (size_t i = 0; i < MG_BENCH_NAMES_LOOKUPS; i++)
+	{
+		mismatches += mg_name_map_find(&map, names[keys[i]]) != keys[i];
+	}
+	double hashed_ms = gs_platform_elapsed_time() - start;
+
+	mg_println("bench_names: %d names, %d lookups, %u slots", MG_BENCH_NAMES_COUNT, MG_BENCH_NAMES_LOOKUPS, map.capacity);
+	mg_println("  linear:    %.3f ms, %.1f ns per lookup", linear_ms, linear_ms * 1e6 / MG_BENCH_NAMES_LOOKUPS);
+	mg_println("  hashed:    %.3f ms, %.1f ns per lookup, %.2fx", hashed_ms, hashed_ms * 1e6 / MG_BENCH_NAMES_LOOKUPS, linear_ms / gs_max(hashed_ms, DBL_MIN));
+	if (mismatches > 0)
+	{
+		mg_println("WARN: mg_bench_names %u lookups found the wrong name", mismatches);
+	}
+
+	for (size_t i = 0; i < MG_BENCH_NAMES_COUNT; i++)
+	{
+		gs_free(names[i]);
+	}
+	gs_free(names);
+	gs_free(keys);
+	mg_name_map_free(&map);
+}
+
+void _mg_bench_decode_textures(void *data, uint32_t start, uint32_t end, uint32_t thread)
+{
+	mg_texture_decode_t *jobs = data;
+	for (uint32_t i = start; i < end; i++)
+	{
+		if (!mg_texture_manager_load_pixels(jobs[i].filename, &jobs[i].width, &jobs[i].height, &jobs[i].data))
+		{
+			jobs[i].data = NULL;
+		}
+	}
+}
+
+bsp_map_t *_mg_bench_get_map()
+{
+	if (g_game_manager == NULL || g_game_manager->map == NULL || !g_game_manager->map->valid)
+	{
+		mg_println("WARN: _mg_bench_get_map no map loaded");
+		return NULL;
+	}
+
+	return g_game_manager->map;
+}
@@ -0,0 +1,47 @@
+/*================================================================
+	* game/bench.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Console commands for benchmarking hot paths
+	against the currently loaded map.
+	bench_broadphase, bench_hitscan and bench_names don't need a map.
+=================================================================*/
+
+#ifndef MG_BENCH_H
+#define MG_BENCH_H
+
+#include <gs/gs.h>
+
+#include "../bsp/bsp_types.h"
+
+#define MG_BENCH_FRUSTUM_ITERATIONS 1000
+#define MG_BENCH_VIS_QUERIES	    1000000
+#define MG_BENCH_TRACE_COUNT	    100000
+#define MG_BENCH_BROADPHASE_ENTS    2000
+#define MG_BENCH_BROADPHASE_FRAMES  100
+#define MG_BENCH_BROADPHASE_QUERIES 1000 // per frame
+#define MG_BENCH_BROADPHASE_EXTENTS 4096.0f
+#define MG_BENCH_HITSCAN_RAYS	    10000 // per tick
+#define MG_BENCH_HITSCAN_TICKS	    10
+#define MG_BENCH_POINT_COUNT	    10000
+#define MG_BENCH_POINT_FRAMES	    100
+#define MG_BENCH_POINT_STEP	    4.0f // max units moved per frame
+#define MG_BENCH_NAMES_COUNT	    10000
+#define MG_BENCH_NAMES_LOOKUPS	    10000
+#define MG_BENCH_NAMES_LEN	    64
+
+void mg_bench_init();
+void mg_bench_frustum();
+void mg_bench_vis();
+void mg_bench_trace();
+void mg_bench_broadphase();
+void mg_bench_hitscan();
+void mg_bench_point();
+void mg_bench_textures();
+void mg_bench_names();
+bsp_map_t *_mg_bench_get_map();
+void _mg_bench_decode_textures(void *data, uint32_t start, uint32_t end, uint32_t thread);
+
+#endif // MG_BENCH_H
@@ -17,6 +17,7 @@ void mg_config_init()
 {
 	g_config	= gs_malloc(sizeof(mg_config_t));
 	g_config->cvars = gs_dyn_array_new(mg_cvar_t);
+	mg_name_map_init(&g_config->lookup, 64);
 
 	mg_cvar_new("vid_fullscreen", MG_CONFIG_TYPE_INT, 0);
 	mg_cvar_new("vid_width", MG_CONFIG_TYPE_INT, 800);
@@ -50,6 +51,9 @@ void mg_config_init()
 	mg_cvar_new("r_mips", MG_CONFIG_TYPE_INT, 0);
 #endif
 	mg_cvar_new("r_wireframe", MG_CONFIG_TYPE_INT, 0);
+	mg_cvar_new("r_texture_arrays", MG_CONFIG_TYPE_INT, 0);
+	mg_cvar_new("r_cluster_draw", MG_CONFIG_TYPE_INT, 0);
+	mg_cvar_new("r_occlusion", MG_CONFIG_TYPE_INT, 0);
 
 	mg_cvar_new("r_viewmodel_fov", MG_CONFIG_TYPE_INT, 65);
 	mg_cvar_new("r_viewmodel_pos_x", MG_CONFIG_TYPE_FLOAT, 0.0f);
@@ -66,6 +70,10 @@ void mg_config_init()
 #endif
 
 	mg_cvar_new("cl_timescale", MG_CONFIG_TYPE_FLOAT, 1.0f);
+	mg_cvar_new("cl_tick_rate", MG_CONFIG_TYPE_INT, 125);
+	mg_cvar_new("cl_patch_collision_level", MG_CONFIG_TYPE_INT, 3);
+	mg_cvar_new("cl_map_mmap", MG_CONFIG_TYPE_INT, 1);
+	mg_cvar_new("cl_map_cache", MG_CONFIG_TYPE_INT, 1);
 
 	mg_cvar_new_str("stringtest", MG_CONFIG_TYPE_STRING, "Sandvich make me strong!");
 
@@ -96,6 +104,7 @@ void mg_config_free()
 		}
 	}
 	gs_dyn_array_free(g_config->cvars);
+	mg_name_map_free(&g_config->lookup);
 
 	gs_free(g_config);
 	g_config = NULL;
@@ -103,14 +112,8 @@ void mg_config_free()
 
 mg_cvar_t *mg_config_get(char *name)
 {
-	for (size_t i = 0; i < gs_dyn_array_size(g_config->cvars); i++)
-	{
-		if (strcmp(g_config->cvars[i].name, name) == 0)
-		{
-			return &g_config->cvars[i];
-		}
-	}
-	return NULL;
+	uint32_t index = mg_name_map_find(&g_config->lookup, name);
+	return index != MG_NAME_MAP_INVALID ? &g_config->cvars[index] : NULL;
 }
 
 void mg_config_print()
@@ -121,6 +124,22 @@ void mg_config_print()
 	}
 }
 
+void _mg_config_add(mg_cvar_t cvar)
+{
+	if (mg_name_map_find(&g_config->lookup, cvar.name) != MG_NAME_MAP_INVALID)
+	{
+		mg_println("WARN: _mg_config_add duplicate cvar %s", cvar.name);
+		if (cvar.type == MG_CONFIG_TYPE_STRING)
+		{
+			gs_free(cvar.value.s);
+		}
+		return;
+	}
+
+	mg_name_map_set(&g_config->lookup, cvar.name, gs_dyn_array_size(g_config->cvars));
+	gs_dyn_array_push(g_config->cvars, cvar);
+}
+
 // Load config from file
 void _mg_config_load(char *filepath)
 {
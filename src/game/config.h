@@ -10,6 +10,7 @@
 #ifndef MG_CONFIG_H
 #define MG_CONFIG_H
 
+#include "../util/name_map.h"
 #include "console.h"
 #include <gs/gs.h>
 
@@ -38,12 +39,14 @@ typedef struct mg_cvar_t
 typedef struct mg_config_t
 {
 	gs_dyn_array(mg_cvar_t) cvars;
+	mg_name_map_t lookup; // name to index in cvars
 } mg_config_t;
 
 void mg_config_init();
 void mg_config_free();
 mg_cvar_t *mg_config_get(char *name);
 void mg_config_print();
+void _mg_config_add(mg_cvar_t cvar);
 void _mg_config_load(char *filepath);
 void _mg_config_save(char *filepath);
 
@@ -64,7 +67,7 @@ extern mg_config_t *g_config;
 		{                                                               \
 			gs_assert(false);                                       \
 		}                                                               \
-		gs_dyn_array_push(g_config->cvars, cvar);                       \
+		_mg_config_add(cvar);                                           \
 	}
 
 // painful to make into a single macro because of float -> char* casting
@@ -74,9 +77,11 @@ extern mg_config_t *g_config;
 		cvar.value.s   = gs_malloc(MG_CVAR_STR_LEN);                               \
 		memset(cvar.value.s, 0, MG_CVAR_STR_LEN);                                  \
 		memcpy(cvar.value.s, v, gs_min(MG_CVAR_STR_LEN - 1, gs_string_length(v))); \
-		gs_dyn_array_push(g_config->cvars, cvar);                                  \
+		_mg_config_add(cvar);                                                      \
 	}
 
+// Cvars are all added in mg_config_init, so the pointer stays valid
+// until mg_config_free. Resolve it once outside per-frame code.
 #define mg_cvar(n) \
 	mg_config_get(n)
 
@@ -16,6 +16,10 @@ void mg_console_init()
 	}
 	g_console->commands = gs_dyn_array_new(mg_cmd_t);
 
+	g_console->main_thread = pthread_self();
+	g_console->pending     = gs_dyn_array_new(char *);
+	pthread_mutex_init(&g_console->pending_mutex, NULL);
+
 	mg_cmd_new("clear", "Clears the console", &mg_console_clear, NULL, 0);
 	mg_cmd_new("help", "Shows available commands", &mg_console_help, NULL, 0);
 	mg_cmd_new("exit", "Exits the game", &gs_quit, NULL, 0);
@@ -41,10 +45,49 @@ void mg_console_free()
 		}
 	}
 	gs_dyn_array_free(g_console->commands);
+	for (size_t i = 0; i < gs_dyn_array_size(g_console->pending); i++)
+	{
+		gs_free(g_console->pending[i]);
+	}
+	gs_dyn_array_free(g_console->pending);
+	pthread_mutex_destroy(&g_console->pending_mutex);
 	gs_free(g_console);
 }
 
+// Safe from any thread, the UI reads output on the main thread
+// so lines from other threads wait for mg_console_flush.
 void mg_console_println(const char *text)
+{
+	if (!pthread_equal(pthread_self(), g_console->main_thread))
+	{
+		size_t sz  = gs_string_length(text) + 1;
+		char *line = gs_malloc(sz);
+		memcpy(line, text, sz);
+
+		pthread_mutex_lock(&g_console->pending_mutex);
+		gs_dyn_array_push(g_console->pending, line);
+		pthread_mutex_unlock(&g_console->pending_mutex);
+		return;
+	}
+
+	mg_console_flush();
+	_mg_console_add_line(text);
+}
+
+// Adds lines printed from other threads, call from the main thread
+void mg_console_flush()
+{
+	pthread_mutex_lock(&g_console->pending_mutex);
+	for (size_t i = 0; i < gs_dyn_array_size(g_console->pending); i++)
+	{
+		_mg_console_add_line(g_console->pending[i]);
+		gs_free(g_console->pending[i]);
+	}
+	gs_dyn_array_clear(g_console->pending);
+	pthread_mutex_unlock(&g_console->pending_mutex);
+}
+
+void _mg_console_add_line(const char *text)
 {
 	size_t sz    = gs_string_length(text) + 1;
 	char *target = mg_console_get_last(g_console->output, MG_CON_LINES, sz);
@@ -2,6 +2,7 @@
 #define MG_CONSOLE_H
 
 #include <gs/gs.h>
+#include <pthread.h>
 
 #define MG_CON_LINES 512
 #define MG_CON_HIST  64
@@ -28,12 +29,19 @@ typedef struct mg_console_t
 	char *output[MG_CON_LINES];
 	char *input[MG_CON_HIST];
 	gs_dyn_array(mg_cmd_t) commands;
+
+	// Lines printed from other threads, added on the main thread
+	pthread_t main_thread;
+	pthread_mutex_t pending_mutex;
+	gs_dyn_array(char *) pending;
 } mg_console_t;
 
 void mg_console_init();
 void mg_console_free();
 
 void mg_console_println(const char *text);
+void mg_console_flush();
+void _mg_console_add_line(const char *text);
 void mg_console_input(const char *text);
 void mg_console_run(const mg_cmd_t cmd, void **argv);
 char *mg_console_get_last(char **container, size_t container_len, size_t sz);
@@ -1,7 +1,9 @@
 #include "game_manager.h"
+#include "../bsp/bsp_cache.h"
 #include "../graphics/renderer.h"
 #include "../graphics/ui_manager.h"
 #include "../util/transform.h"
+#include "bench.h"
 #include "config.h"
 #include "console.h"
 #include "monster_manager.h"
@@ -11,23 +13,30 @@ mg_game_manager_t *g_game_manager;
 
 void mg_game_manager_init()
 {
-	g_game_manager	       = gs_malloc_init(mg_game_manager_t);
-	g_game_manager->player = mg_player_new();
+	g_game_manager		       = gs_malloc_init(mg_game_manager_t);
+	g_game_manager->player	       = mg_player_new();
+	g_game_manager->cl_sensitivity = mg_cvar("cl_sensitivity");
 
+	// Nothing to keep responsive yet, wait for the first map
 	mg_game_manager_load_map("assets/maps/q3dm1.bsp");
-	mg_game_manager_spawn_player();
+	_mg_game_manager_set_map(mg_map_loader_wait(&g_game_manager->loader));
 
 	mg_monster_manager_init();
 
 	mg_cmd_arg_type types[] = {MG_CMD_ARG_STRING};
 	mg_cmd_new("map", "Load map", &mg_game_manager_load_map, (mg_cmd_arg_type *)types, 1);
+	mg_cmd_new("bsp_compile", "Write a .bspc cache next to a map for faster loading", &mg_game_manager_compile_map, (mg_cmd_arg_type *)types, 1);
 	mg_cmd_new("spawn", "Spawn player", &mg_game_manager_spawn_player, NULL, 0);
+	mg_cmd_new("bsp_materials", "Shows how map textures are grouped into layered textures", &mg_game_manager_print_materials, NULL, 0);
+
+	mg_bench_init();
 }
 
 void mg_game_manager_free()
 {
 	mg_monster_manager_free();
 
+	mg_map_loader_free(&g_game_manager->loader);
 	mg_player_free(g_game_manager->player);
 	g_game_manager->player = NULL;
 	bsp_map_free(g_game_manager->map);
@@ -39,6 +48,9 @@ void mg_game_manager_free()
 
 void mg_game_manager_update()
 {
+	mg_console_flush();
+	_mg_game_manager_set_map(mg_map_loader_update(&g_game_manager->loader));
+
 	if (g_ui_manager->console_open)
 	{
 		mg_game_manager_input_console();
@@ -50,56 +62,100 @@ void mg_game_manager_update()
 	else if (g_game_manager->player)
 	{
 		mg_game_manager_input_alive();
-		mg_player_update(g_game_manager->player);
-		mg_monster_manager_update();
 	}
 
 	mg_game_manager_input_general();
 }
 
+// Fixed rate simulation, runs g_time_manager->ticks times a frame
+void mg_game_manager_tick()
+{
+	if (g_ui_manager->console_open || g_ui_manager->menu_open || g_game_manager->player == NULL)
+	{
+		return;
+	}
+
+	mg_player_update(g_game_manager->player);
+	mg_monster_manager_update();
+}
+
+// Rendered state between the last two ticks
+void mg_game_manager_interpolate()
+{
+	if (g_game_manager->player == NULL || g_game_manager->map == NULL || !g_game_manager->map->valid)
+	{
+		return;
+	}
+
+	mg_player_interpolate(g_game_manager->player, g_time_manager->tick_alpha);
+}
+
+// Loads in the background, the current map stays until the new one is done
 void mg_game_manager_load_map(char *filename)
 {
 	if (!gs_platform_file_exists(filename))
 	{
 		mg_println("mg_game_manager_load_map() failed: file not found '%s'", filename);
-		return false;
+		return;
 	}
 
-	if (g_game_manager->map != NULL)
+	if (!mg_map_loader_start(&g_game_manager->loader, filename))
 	{
-		bsp_map_free(g_game_manager->map);
-		g_game_manager->map = NULL;
+		mg_println("mg_game_manager_load_map() failed: already loading '%s'", g_game_manager->loader.filename);
 	}
+}
 
-	g_game_manager->map = gs_malloc_init(bsp_map_t);
-	load_bsp(filename, g_game_manager->map);
-
-	if (g_game_manager->map->valid)
+// Blocks until written, the map is loaded separately from the current one
+void mg_game_manager_compile_map(char *filename)
+{
+	if (!gs_platform_file_exists(filename))
 	{
-		bsp_map_init(g_game_manager->map);
-		mg_game_manager_spawn_player();
+		mg_println("mg_game_manager_compile_map() failed: file not found '%s'", filename);
+		return;
 	}
-	else
+
+	bsp_cache_compile(filename);
+}
+
+// Replaces the current map with a loaded one, NULL does nothing
+void _mg_game_manager_set_map(bsp_map_t *map)
+{
+	if (map == NULL)
 	{
-		mg_println("Failed to load map %s", filename);
-		bsp_map_free(g_game_manager->map);
-		g_game_manager->map = NULL;
+		return;
 	}
+
+	bsp_map_free(g_game_manager->map);
+	g_game_manager->map = map;
+	mg_game_manager_spawn_player();
 }
 
 void mg_game_manager_spawn_player()
 {
-	if (g_game_manager->map->valid)
+	if (g_game_manager->map != NULL && g_game_manager->map->valid)
 	{
 		g_game_manager->player->velocity     = gs_v3(0, 0, 0);
 		g_game_manager->player->camera.pitch = 0;
 		bsp_map_find_spawn_point(g_game_manager->map, &g_game_manager->player->transform.position, &g_game_manager->player->yaw);
 		g_game_manager->player->last_valid_pos = g_game_manager->player->transform.position;
+		g_game_manager->player->prev_position  = g_game_manager->player->transform.position;
 		g_game_manager->player->yaw -= 90;
 		g_renderer->cam = &g_game_manager->player->camera.cam;
 	}
 }
 
+void mg_game_manager_print_materials()
+{
+	if (g_game_manager->map == NULL || !g_game_manager->map->valid)
+	{
+		mg_println("mg_game_manager_print_materials() failed: no map loaded");
+		return;
+	}
+
+	mg_println("r_texture_arrays at map load: %d", g_game_manager->map->material_arrays);
+	bsp_material_table_print(&g_game_manager->map->material_table);
+}
+
 #ifdef __ANDROID__
 mg_player_input_t mg_game_manager_get_input()
 {
@@ -110,7 +166,7 @@ mg_player_input_t mg_game_manager_get_input()
 
 	if (gs_platform_touch_down(0))
 	{
-		input.delta_aim = gs_vec2_scale(gs_platform_touch_deltav(0), mg_cvar("cl_sensitivity")->value.f * 0.022f);
+		input.delta_aim = gs_vec2_scale(gs_platform_touch_deltav(0), g_game_manager->cl_sensitivity->value.f * 0.022f);
 	}
 
 	return input;
@@ -121,7 +177,7 @@ mg_player_input_t mg_game_manager_get_input()
 	double dt		= g_time_manager->unscaled_delta;
 	mg_player_input_t input = {0};
 
-	input.delta_aim = gs_vec2_scale(gs_platform_mouse_deltav(), mg_cvar("cl_sensitivity")->value.f * 0.022f);
+	input.delta_aim = gs_vec2_scale(gs_platform_mouse_deltav(), g_game_manager->cl_sensitivity->value.f * 0.022f);
 
 	f32 scroll_x, scroll_y;
 	gs_platform_mouse_wheel(&scroll_x, &scroll_y);
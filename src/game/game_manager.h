@@ -6,11 +6,15 @@
 #include "../bsp/bsp_loader.h"
 #include "../bsp/bsp_map.h"
 #include "../entities/player.h"
+#include "config.h"
+#include "map_loader.h"
 
 typedef struct mg_game_manager_t
 {
 	bsp_map_t *map;
 	mg_player_t *player;
+	mg_map_loader_t loader;
+	mg_cvar_t *cl_sensitivity;
 } mg_game_manager_t;
 
 typedef struct mg_player_input_t
@@ -26,9 +30,14 @@ typedef struct mg_player_input_t
 void mg_game_manager_init();
 void mg_game_manager_free();
 void mg_game_manager_update();
+void mg_game_manager_tick();
+void mg_game_manager_interpolate();
 
 void mg_game_manager_load_map(char *filename);
+void mg_game_manager_compile_map(char *filename);
+void _mg_game_manager_set_map(bsp_map_t *map);
 void mg_game_manager_spawn_player();
+void mg_game_manager_print_materials();
 
 mg_player_input_t mg_game_manager_get_input();
 void mg_game_manager_input_alive();
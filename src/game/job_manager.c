@@ -0,0 +1,154 @@
+/*================================================================
+	* game/job_manager.c
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Worker threads for splitting loops over many items.
+	One parallel for runs at a time, other callers run serially.
+=================================================================*/
+
+#include "job_manager.h"
+#include "console.h"
+
+mg_job_manager_t *g_job_manager;
+
+void mg_job_manager_init()
+{
+	g_job_manager = gs_malloc_init(mg_job_manager_t);
+
+	pthread_mutex_init(&g_job_manager->mutex, NULL);
+	pthread_mutex_init(&g_job_manager->caller_mutex, NULL);
+	pthread_cond_init(&g_job_manager->work_cond, NULL);
+	pthread_cond_init(&g_job_manager->done_cond, NULL);
+
+	for (size_t i = 0; i < MG_JOB_MANAGER_WORKERS; i++)
+	{
+		if (pthread_create(&g_job_manager->threads[i], NULL, _mg_job_manager_worker, (void *)(uintptr_t)(i + 1)) != 0)
+		{
+			mg_println("WARN: mg_job_manager_init failed to create worker %zu", i + 1);
+			break;
+		}
+		g_job_manager->num_workers++;
+	}
+}
+
+void mg_job_manager_free()
+{
+	pthread_mutex_lock(&g_job_manager->mutex);
+	g_job_manager->quit = true;
+	pthread_cond_broadcast(&g_job_manager->work_cond);
+	pthread_mutex_unlock(&g_job_manager->mutex);
+
+	for (size_t i = 0; i < g_job_manager->num_workers; i++)
+	{
+		pthread_join(g_job_manager->threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&g_job_manager->work_cond);
+	pthread_cond_destroy(&g_job_manager->done_cond);
+	pthread_mutex_destroy(&g_job_manager->mutex);
+	pthread_mutex_destroy(&g_job_manager->caller_mutex);
+
+	gs_free(g_job_manager);
+	g_job_manager = NULL;
+}
+
+// Splits count items into chunks shared by up to num_threads threads,
+// including the caller. Returns when all items are done.
+// Runs on the calling thread only if the manager isn't initialized
+// or another thread's job is running, e.g. the map loader's.
+void mg_job_manager_parallel_for(mg_job_fn fn, void *data, uint32_t count, uint32_t chunk, uint32_t num_threads)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	chunk		     = gs_max(chunk, 1);
+	uint32_t max_workers = 0;
+	if (g_job_manager != NULL && num_threads > 1)
+	{
+		max_workers = gs_min(num_threads - 1, g_job_manager->num_workers);
+	}
+
+	if (max_workers == 0 || count <= chunk || pthread_mutex_trylock(&g_job_manager->caller_mutex) != 0)
+	{
+		fn(data, 0, count, 0);
+		return;
+	}
+
+	pthread_mutex_lock(&g_job_manager->mutex);
+	g_job_manager->fn	   = fn;
+	g_job_manager->data	   = data;
+	g_job_manager->count	   = count;
+	g_job_manager->chunk	   = chunk;
+	g_job_manager->next	   = 0;
+	g_job_manager->max_workers = max_workers;
+	g_job_manager->active	   = max_workers;
+	g_job_manager->generation++;
+	pthread_cond_broadcast(&g_job_manager->work_cond);
+	pthread_mutex_unlock(&g_job_manager->mutex);
+
+	_mg_job_manager_run_chunks(0);
+
+	pthread_mutex_lock(&g_job_manager->mutex);
+	while (g_job_manager->active > 0)
+	{
+		pthread_cond_wait(&g_job_manager->done_cond, &g_job_manager->mutex);
+	}
+	pthread_mutex_unlock(&g_job_manager->mutex);
+	pthread_mutex_unlock(&g_job_manager->caller_mutex);
+}
+
+void *_mg_job_manager_worker(void *arg)
+{
+	uint32_t thread	    = (uint32_t)(uintptr_t)arg;
+	uint64_t generation = 0;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&g_job_manager->mutex);
+		while (!g_job_manager->quit && g_job_manager->generation == generation)
+		{
+			pthread_cond_wait(&g_job_manager->work_cond, &g_job_manager->mutex);
+		}
+		if (g_job_manager->quit)
+		{
+			pthread_mutex_unlock(&g_job_manager->mutex);
+			return NULL;
+		}
+		generation	    = g_job_manager->generation;
+		bool32_t takes_part = thread <= g_job_manager->max_workers;
+		pthread_mutex_unlock(&g_job_manager->mutex);
+
+		if (!takes_part) continue;
+
+		_mg_job_manager_run_chunks(thread);
+
+		pthread_mutex_lock(&g_job_manager->mutex);
+		g_job_manager->active--;
+		if (g_job_manager->active == 0)
+		{
+			pthread_cond_signal(&g_job_manager->done_cond);
+		}
+		pthread_mutex_unlock(&g_job_manager->mutex);
+	}
+}
+
+void _mg_job_manager_run_chunks(uint32_t thread)
+{
+	uint32_t count = g_job_manager->count;
+	uint32_t chunk = g_job_manager->chunk;
+
+	for (;;)
+	{
+		uint32_t start = __atomic_fetch_add(&g_job_manager->next, chunk, __ATOMIC_RELAXED);
+		if (start >= count)
+		{
+			return;
+		}
+
+		g_job_manager->fn(g_job_manager->data, start, gs_min(start + chunk, count), thread);
+	}
+}
@@ -0,0 +1,54 @@
+/*================================================================
+	* game/job_manager.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Worker threads for splitting loops over many items.
+	One parallel for runs at a time, other callers run serially.
+=================================================================*/
+
+#ifndef MG_JOB_MANAGER_H
+#define MG_JOB_MANAGER_H
+
+#include <gs/gs.h>
+#include <pthread.h>
+
+// Worker threads, the calling thread also runs jobs
+#define MG_JOB_MANAGER_WORKERS 7
+#define MG_JOB_MANAGER_THREADS (MG_JOB_MANAGER_WORKERS + 1)
+
+// Runs items [start, end), thread is 0 for the caller
+// and 1..MG_JOB_MANAGER_WORKERS for workers.
+typedef void (*mg_job_fn)(void *data, uint32_t start, uint32_t end, uint32_t thread);
+
+typedef struct mg_job_manager_t
+{
+	pthread_t threads[MG_JOB_MANAGER_WORKERS];
+	uint32_t num_workers;
+	pthread_mutex_t mutex;
+	pthread_mutex_t caller_mutex; // held by the thread running a job
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+	uint64_t generation; // bumped for every job
+	bool32_t quit;
+
+	// Current job
+	mg_job_fn fn;
+	void *data;
+	uint32_t count;
+	uint32_t chunk;
+	uint32_t next;	      // next item to take, atomic
+	uint32_t max_workers; // workers taking part
+	uint32_t active;      // workers still running
+} mg_job_manager_t;
+
+void mg_job_manager_init();
+void mg_job_manager_free();
+void mg_job_manager_parallel_for(mg_job_fn fn, void *data, uint32_t count, uint32_t chunk, uint32_t num_threads);
+void *_mg_job_manager_worker(void *arg);
+void _mg_job_manager_run_chunks(uint32_t thread);
+
+extern mg_job_manager_t *g_job_manager;
+
+#endif // MG_JOB_MANAGER_H
@@ -0,0 +1,323 @@
+/*================================================================
+	* game/map_loader.c
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Loads maps in stages over several frames.
+	File reads and CPU work run on a loader thread,
+	graphics work runs on the main thread.
+=================================================================*/
+
+#include "map_loader.h"
+#include "../bsp/bsp_cache.h"
+#include "../bsp/bsp_loader.h"
+#include "../bsp/bsp_map.h"
+#include "../graphics/texture_manager.h"
+#include "config.h"
+#include "console.h"
+#include "job_manager.h"
+
+// Starts loading filename, call mg_map_loader_update every frame.
+// Returns false if a map is already loading.
+bool32_t mg_map_loader_start(mg_map_loader_t *loader, const char *filename)
+{
+	if (loader->active)
+	{
+		return false;
+	}
+
+	size_t sz = gs_string_length(filename) + 1;
+
+	loader->active		  = true;
+	loader->filename	  = gs_malloc(sz);
+	loader->map		  = gs_malloc_init(bsp_map_t);
+	loader->stage		  = MG_MAP_LOAD_READ;
+	loader->start_time	  = gs_platform_elapsed_time();
+	loader->textures	  = gs_dyn_array_new(uint32_t);
+	loader->textures_ready	  = 0;
+	memcpy(loader->filename, filename, sz);
+	memset(loader->stage_ms, 0, sizeof(loader->stage_ms));
+
+	return true;
+}
+
+// Advances loading, runs at most one main thread stage per call.
+// Returns the map once when it's done, NULL otherwise.
+bsp_map_t *mg_map_loader_update(mg_map_loader_t *loader)
+{
+	bool32_t ran_main = false;
+
+	while (loader->active && loader->stage < MG_MAP_LOAD_STAGE_COUNT)
+	{
+		if (loader->thread_running)
+		{
+			if (!__atomic_load_n(&loader->thread_done, __ATOMIC_ACQUIRE))
+			{
+				return NULL;
+			}
+
+			_mg_map_loader_join(loader);
+			continue;
+		}
+
+		if (_mg_map_loader_on_thread(loader->stage))
+		{
+			__atomic_store_n(&loader->thread_done, false, __ATOMIC_RELAXED);
+			if (pthread_create(&loader->thread, NULL, _mg_map_loader_thread, loader) != 0)
+			{
+				mg_println("WARN: mg_map_loader_update failed to create loader thread, loading on the main thread");
+				_mg_map_loader_thread(loader);
+				_mg_map_loader_next_stage(loader);
+				continue;
+			}
+
+			loader->thread_running = true;
+			return NULL;
+		}
+
+		// Graphics work is spread over frames
+		if (ran_main)
+		{
+			return NULL;
+		}
+		ran_main = true;
+
+		double start  = gs_platform_elapsed_time();
+		bool32_t done = _mg_map_loader_run_stage(loader);
+		loader->stage_ms[loader->stage] += gs_platform_elapsed_time() - start;
+
+		if (done)
+		{
+			_mg_map_loader_next_stage(loader);
+		}
+	}
+
+	if (!loader->active)
+	{
+		return NULL;
+	}
+
+	return _mg_map_loader_finish(loader);
+}
+
+// Finishes loading on this thread, returns the map or NULL on failure
+bsp_map_t *mg_map_loader_wait(mg_map_loader_t *loader)
+{
+	while (loader->active)
+	{
+		if (loader->thread_running)
+		{
+			_mg_map_loader_join(loader);
+		}
+		else if (loader->stage == MG_MAP_LOAD_WAIT_TEXTURES)
+		{
+			mg_texture_manager_finish();
+		}
+
+		bsp_map_t *map = mg_map_loader_update(loader);
+		if (map != NULL)
+		{
+			return map;
+		}
+	}
+
+	return NULL;
+}
+
+void mg_map_loader_free(mg_map_loader_t *loader)
+{
+	// Partially loaded maps can't be freed, finish first
+	bsp_map_free(mg_map_loader_wait(loader));
+	_mg_map_loader_free_textures(loader);
+}
+
+// 0 to 1, textures count towards their stages
+float32_t mg_map_loader_progress(mg_map_loader_t *loader)
+{
+	float32_t stage	  = loader->stage;
+	uint32_t textures = gs_dyn_array_size(loader->textures);
+
+	if (textures > 0 && loader->stage == MG_MAP_LOAD_WAIT_TEXTURES)
+	{
+		stage += (float32_t)loader->textures_ready / textures;
+	}
+
+	return stage / MG_MAP_LOAD_STAGE_COUNT;
+}
+
+const char *mg_map_loader_stage_name(mg_map_load_stage stage)
+{
+	switch (stage)
+	{
+	case MG_MAP_LOAD_READ:
+		return "reading file";
+	case MG_MAP_LOAD_CACHE:
+		return "reading cache";
+	case MG_MAP_LOAD_REQUEST_TEXTURES:
+		return "requesting textures";
+	case MG_MAP_LOAD_DATA:
+		return "building map data";
+	case MG_MAP_LOAD_WAIT_TEXTURES:
+		return "loading textures";
+	case MG_MAP_LOAD_MATERIALS:
+		return "creating materials";
+	case MG_MAP_LOAD_BUILD_BUFFERS:
+		return "building buffers";
+	case MG_MAP_LOAD_CREATE_BUFFERS:
+		return "creating buffers";
+	default:
+		return "done";
+	}
+}
+
+bool32_t _mg_map_loader_on_thread(mg_map_load_stage stage)
+{
+	switch (stage)
+	{
+	case MG_MAP_LOAD_READ:
+	case MG_MAP_LOAD_CACHE:
+	case MG_MAP_LOAD_DATA:
+	case MG_MAP_LOAD_BUILD_BUFFERS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Returns true when the stage is done
+bool32_t _mg_map_loader_run_stage(mg_map_loader_t *loader)
+{
+	switch (loader->stage)
+	{
+	case MG_MAP_LOAD_READ:
+		load_bsp(loader->filename, loader->map);
+		return true;
+	case MG_MAP_LOAD_CACHE:
+		_mg_map_loader_read_cache(loader);
+		return true;
+	case MG_MAP_LOAD_REQUEST_TEXTURES:
+		_mg_map_loader_request_textures(loader);
+		return true;
+	case MG_MAP_LOAD_DATA:
+		bsp_map_init_data(loader->map, MG_JOB_MANAGER_THREADS);
+		return true;
+	case MG_MAP_LOAD_WAIT_TEXTURES:
+		return _mg_map_loader_wait_textures(loader);
+	case MG_MAP_LOAD_MATERIALS:
+		bsp_map_init_textures(loader->map, false);
+		return true;
+	case MG_MAP_LOAD_BUILD_BUFFERS:
+		bsp_map_init_buffers(loader->map);
+		return true;
+	case MG_MAP_LOAD_CREATE_BUFFERS:
+		bsp_map_init_graphics(loader->map);
+		return true;
+	default:
+		return true;
+	}
+}
+
+void *_mg_map_loader_thread(void *arg)
+{
+	mg_map_loader_t *loader = arg;
+
+	double start = gs_platform_elapsed_time();
+	_mg_map_loader_run_stage(loader);
+	loader->stage_ms[loader->stage] += gs_platform_elapsed_time() - start;
+
+	__atomic_store_n(&loader->thread_done, true, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+void _mg_map_loader_join(mg_map_loader_t *loader)
+{
+	pthread_join(loader->thread, NULL);
+	loader->thread_running = false;
+	_mg_map_loader_next_stage(loader);
+}
+
+void _mg_map_loader_next_stage(mg_map_loader_t *loader)
+{
+	mg_println(
+		"mg_map_loader: %s took %.2f ms on the %s thread",
+		mg_map_loader_stage_name(loader->stage),
+		loader->stage_ms[loader->stage],
+		_mg_map_loader_on_thread(loader->stage) ? "loader" : "main");
+
+	// Nothing to init
+	if (loader->stage == MG_MAP_LOAD_READ && !loader->map->valid)
+	{
+		loader->stage = MG_MAP_LOAD_STAGE_COUNT;
+		return;
+	}
+
+	loader->stage++;
+}
+
+bsp_map_t *_mg_map_loader_finish(mg_map_loader_t *loader)
+{
+	bsp_map_t *map = loader->map;
+
+	if (map->valid)
+	{
+		mg_println("mg_map_loader: loaded %s in %.2f ms", loader->filename, gs_platform_elapsed_time() - loader->start_time);
+	}
+	else
+	{
+		mg_println("Failed to load map %s", loader->filename);
+		bsp_map_free(map);
+		map = NULL;
+	}
+
+	_mg_map_loader_free_textures(loader);
+	gs_free(loader->filename);
+	loader->filename = NULL;
+	loader->map	 = NULL;
+	loader->active	 = false;
+
+	return map;
+}
+
+// Compiled data next to the map, bsp_map_init_data builds it if there's none
+void _mg_map_loader_read_cache(mg_map_loader_t *loader)
+{
+	if (!mg_cvar("cl_map_cache")->value.i)
+	{
+		return;
+	}
+
+	char *filename = bsp_cache_filename(loader->filename);
+	bsp_cache_load(loader->map, filename);
+	gs_free(filename);
+}
+
+// Decoded on the texture manager's workers while the map data is built
+void _mg_map_loader_request_textures(mg_map_loader_t *loader)
+{
+	for (size_t i = 0; i < loader->map->textures.count; i++)
+	{
+		gs_dyn_array_push(loader->textures, mg_texture_manager_request_handle(loader->map->textures.data[i].name));
+	}
+}
+
+// Returns true when the texture manager has uploaded every map texture
+bool32_t _mg_map_loader_wait_textures(mg_map_loader_t *loader)
+{
+	loader->textures_ready = 0;
+	for (size_t i = 0; i < gs_dyn_array_size(loader->textures); i++)
+	{
+		if (!mg_texture_manager_is_pending(loader->textures[i]))
+		{
+			loader->textures_ready++;
+		}
+	}
+
+	return loader->textures_ready == gs_dyn_array_size(loader->textures);
+}
+
+void _mg_map_loader_free_textures(mg_map_loader_t *loader)
+{
+	gs_dyn_array_free(loader->textures);
+	loader->textures = NULL;
+}
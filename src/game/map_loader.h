@@ -0,0 +1,65 @@
+/*================================================================
+	* game/map_loader.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Loads maps in stages over several frames.
+	File reads and CPU work run on a loader thread,
+	graphics work runs on the main thread.
+=================================================================*/
+
+#ifndef MG_MAP_LOADER_H
+#define MG_MAP_LOADER_H
+
+#include <gs/gs.h>
+#include <pthread.h>
+
+#include "../bsp/bsp_types.h"
+
+typedef enum mg_map_load_stage
+{
+	MG_MAP_LOAD_READ,	      // loader thread: file and lumps
+	MG_MAP_LOAD_CACHE,	      // loader thread: compiled .bspc if valid
+	MG_MAP_LOAD_REQUEST_TEXTURES, // main thread: texture manager decodes them meanwhile
+	MG_MAP_LOAD_DATA,	      // loader thread: vis, collision, entities, patches
+	MG_MAP_LOAD_WAIT_TEXTURES,    // main thread: uploaded over several frames
+	MG_MAP_LOAD_MATERIALS,	      // main thread: lightmaps, materials
+	MG_MAP_LOAD_BUILD_BUFFERS,    // loader thread: vertex and index arrays
+	MG_MAP_LOAD_CREATE_BUFFERS,   // main thread: buffers, pipelines
+	MG_MAP_LOAD_STAGE_COUNT,
+} mg_map_load_stage;
+
+typedef struct mg_map_loader_t
+{
+	bool32_t active;
+	char *filename;
+	bsp_map_t *map;
+	mg_map_load_stage stage;
+	double start_time;
+	double stage_ms[MG_MAP_LOAD_STAGE_COUNT]; // time spent on the stage's thread
+	pthread_t thread;
+	bool32_t thread_running;
+	uint32_t thread_done; // atomic
+	gs_dyn_array(uint32_t) textures; // texture manager handles requested for the map
+	uint32_t textures_ready;
+} mg_map_loader_t;
+
+bool32_t mg_map_loader_start(mg_map_loader_t *loader, const char *filename);
+bsp_map_t *mg_map_loader_update(mg_map_loader_t *loader);
+bsp_map_t *mg_map_loader_wait(mg_map_loader_t *loader);
+void mg_map_loader_free(mg_map_loader_t *loader);
+float32_t mg_map_loader_progress(mg_map_loader_t *loader);
+const char *mg_map_loader_stage_name(mg_map_load_stage stage);
+bool32_t _mg_map_loader_on_thread(mg_map_load_stage stage);
+bool32_t _mg_map_loader_run_stage(mg_map_loader_t *loader);
+void *_mg_map_loader_thread(void *arg);
+void _mg_map_loader_join(mg_map_loader_t *loader);
+void _mg_map_loader_next_stage(mg_map_loader_t *loader);
+bsp_map_t *_mg_map_loader_finish(mg_map_loader_t *loader);
+void _mg_map_loader_read_cache(mg_map_loader_t *loader);
+void _mg_map_loader_request_textures(mg_map_loader_t *loader);
+bool32_t _mg_map_loader_wait_textures(mg_map_loader_t *loader);
+void _mg_map_loader_free_textures(mg_map_loader_t *loader);
+
+#endif // MG_MAP_LOADER_H
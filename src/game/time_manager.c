@@ -21,6 +21,9 @@ void mg_time_manager_init()
 	g_time_manager->unscaled_delta = DBL_MIN;
 	g_time_manager->unscaled_time  = DBL_MIN;
 	g_time_manager->time	       = DBL_MIN;
+
+	g_time_manager->cl_timescale = mg_cvar("cl_timescale");
+	g_time_manager->cl_tick_rate = mg_cvar("cl_tick_rate");
 }
 
 void mg_time_manager_free()
@@ -32,9 +35,29 @@ void mg_time_manager_update_start()
 {
 	g_time_manager->_update_start  = gs_platform_elapsed_time() / 1000.0f;
 	g_time_manager->unscaled_delta = gs_platform_delta_time();
-	g_time_manager->delta	       = g_time_manager->unscaled_delta * mg_cvar("cl_timescale")->value.f;
+	g_time_manager->delta	       = g_time_manager->unscaled_delta * g_time_manager->cl_timescale->value.f;
 	g_time_manager->unscaled_time += g_time_manager->unscaled_delta;
 	g_time_manager->time += g_time_manager->delta;
+
+	// Ticks to run this frame, rate changes apply between frames
+	g_time_manager->tick_delta = 1.0 / gs_clamp(g_time_manager->cl_tick_rate->value.i, 10, 1000);
+	g_time_manager->tick_accumulator += g_time_manager->delta;
+	g_time_manager->ticks = (uint32_t)(g_time_manager->tick_accumulator / g_time_manager->tick_delta);
+	g_time_manager->tick_accumulator -= g_time_manager->ticks * g_time_manager->tick_delta;
+	if (g_time_manager->ticks > MG_TIME_MANAGER_MAX_TICKS)
+	{
+		// Too slow to keep up, simulation falls behind instead of spiraling
+		g_time_manager->ticks		 = MG_TIME_MANAGER_MAX_TICKS;
+		g_time_manager->tick_accumulator = 0;
+	}
+	g_time_manager->tick_alpha = g_time_manager->tick_accumulator / g_time_manager->tick_delta;
+}
+
+// Advances simulation time, call before each tick
+void mg_time_manager_tick()
+{
+	g_time_manager->tick_count++;
+	g_time_manager->tick_time += g_time_manager->tick_delta;
 }
 
 void mg_time_manager_update_end()
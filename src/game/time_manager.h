@@ -12,6 +12,10 @@
 
 #include <gs/gs.h>
 
+#include "config.h"
+
+#define MG_TIME_MANAGER_MAX_TICKS 8 // per frame, time past this is dropped
+
 typedef struct mg_time_manager_t
 {
 	double delta;	       // seconds
@@ -19,6 +23,16 @@ typedef struct mg_time_manager_t
 	double time;	       // seconds
 	double unscaled_time;  // seconds
 
+	// Fixed rate simulation
+	double tick_delta;	 // seconds
+	double tick_time;	 // seconds, of the current tick
+	double tick_accumulator; // seconds, not yet simulated
+	double tick_alpha;	 // between the last two ticks, for interpolation
+	uint32_t ticks;		 // to run this frame
+	uint64_t tick_count;
+	mg_cvar_t *cl_timescale;
+	mg_cvar_t *cl_tick_rate;
+
 	double update;	  // seconds
 	double render;	  // seconds
 	double bsp;	  // seconds
@@ -54,6 +68,7 @@ void mg_time_manager_free();
 // TODO: macro these
 void mg_time_manager_update_start();
 void mg_time_manager_update_end();
+void mg_time_manager_tick();
 void mg_time_manager_render_start();
 void mg_time_manager_render_end();
 void mg_time_manager_bsp_start();
@@ -161,7 +161,7 @@ bool mg_load_md3(char *filename, md3_t *model)
 			// \0odels/players/...
 			if (surf->shaders[j].name[0] == '\0') surf->shaders[j].name[0] = 'm';
 
-			surf->textures[j] = mg_texture_manager_get(surf->shaders[j].name);
+			surf->textures[j] = mg_texture_manager_request(surf->shaders[j].name);
 		}
 
 		// Seek to next surface
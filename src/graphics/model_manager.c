@@ -17,7 +17,8 @@ void mg_model_manager_init()
 {
 	// Allocate
 	g_model_manager		= gs_malloc_init(mg_model_manager_t);
-	g_model_manager->models = gs_dyn_array_new(mg_model_t);
+	g_model_manager->models = gs_dyn_array_new(mg_model_t *);
+	mg_name_map_init(&g_model_manager->lookup, 64);
 
 	// Test
 	_mg_model_manager_load("players/sarge/head.md3", "basic");
@@ -29,10 +30,12 @@ void mg_model_manager_free()
 {
 	for (size_t i = 0; i < gs_dyn_array_size(g_model_manager->models); i++)
 	{
-		mg_free_md3(g_model_manager->models[i].data);
+		mg_free_md3(g_model_manager->models[i]->data);
+		gs_free(g_model_manager->models[i]);
 	}
 
 	gs_dyn_array_free(g_model_manager->models);
+	mg_name_map_free(&g_model_manager->lookup);
 
 	gs_free(g_model_manager);
 	g_model_manager = NULL;
@@ -40,12 +43,10 @@ void mg_model_manager_free()
 
 mg_model_t *mg_model_manager_find(const char *filename)
 {
-	for (size_t i = 0; i < gs_dyn_array_size(g_model_manager->models); i++)
+	uint32_t index = mg_name_map_find(&g_model_manager->lookup, filename);
+	if (index != MG_NAME_MAP_INVALID)
 	{
-		if (strcmp(filename, g_model_manager->models[i].filename) == 0)
-		{
-			return &g_model_manager->models[i];
-		}
+		return g_model_manager->models[index];
 	}
 
 	mg_println("WARN: mg_model_manager_find invalid model %s", filename);
@@ -54,17 +55,15 @@ mg_model_t *mg_model_manager_find(const char *filename)
 
 mg_model_t *mg_model_manager_find_or_load(const char *filename, const char *shader)
 {
-	for (size_t i = 0; i < gs_dyn_array_size(g_model_manager->models); i++)
+	uint32_t index = mg_name_map_find(&g_model_manager->lookup, filename);
+	if (index != MG_NAME_MAP_INVALID)
 	{
-		if (strcmp(filename, g_model_manager->models[i].filename) == 0)
-		{
-			return &g_model_manager->models[i];
-		}
+		return g_model_manager->models[index];
 	}
 
 	if (_mg_model_manager_load(filename, shader))
 	{
-		return &gs_dyn_array_back(g_model_manager->models);
+		return gs_dyn_array_back(g_model_manager->models);
 	}
 
 	mg_println("WARN: mg_model_manager_find_or_load invalid model %s", filename);
@@ -85,12 +84,12 @@ bool _mg_model_manager_load(const char *filename, const char *shader)
 		return false;
 	}
 
-	mg_model_t model = {
-		.filename = filename,
-		.shader	  = shader,
-		.data	  = data,
-	};
+	mg_model_t *model = gs_malloc_init(mg_model_t);
+	model->filename	  = filename;
+	model->shader	  = shader;
+	model->data	  = data;
 
+	mg_name_map_set(&g_model_manager->lookup, filename, gs_dyn_array_size(g_model_manager->models));
 	gs_dyn_array_push(g_model_manager->models, model);
 
 	mg_println("Model: Loaded %s", filename);
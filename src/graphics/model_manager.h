@@ -12,6 +12,7 @@
 
 #include <gs/gs.h>
 
+#include "../util/name_map.h"
 #include "model.h"
 
 typedef struct mg_model_t
@@ -23,7 +24,8 @@ typedef struct mg_model_t
 
 typedef struct mg_model_manager_t
 {
-	gs_dyn_array(mg_model_t) models;
+	gs_dyn_array(mg_model_t *) models; // allocated separately, pointers stay valid
+	mg_name_map_t lookup;		   // filename to index in models
 } mg_model_manager_t;
 
 void mg_model_manager_init();
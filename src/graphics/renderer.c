@@ -14,6 +14,7 @@
 #include "../game/time_manager.h"
 #include "../util/camera.h"
 #include "../util/render.h"
+#include "../util/transform.h"
 #include "ui_manager.h"
 
 mg_renderer_t *g_renderer;
@@ -30,10 +31,19 @@ void mg_renderer_init(uint32_t window_handle)
 	g_renderer->shader_names	= gs_dyn_array_new(char *);
 	g_renderer->shader_sources_frag = gs_dyn_array_new(char *);
 	g_renderer->shader_sources_vert = gs_dyn_array_new(char *);
+	mg_name_map_init(&g_renderer->shader_lookup, 16);
+
+	g_renderer->r_wireframe	       = mg_cvar("r_wireframe");
+	g_renderer->r_occlusion	       = mg_cvar("r_occlusion");
+	g_renderer->r_fov	       = mg_cvar("r_fov");
+	g_renderer->r_barrel_enabled   = mg_cvar("r_barrel_enabled");
+	g_renderer->r_barrel_strength  = mg_cvar("r_barrel_strength");
+	g_renderer->r_barrel_cyl_ratio = mg_cvar("r_barrel_cyl_ratio");
 
 	_mg_renderer_load_shader("basic");
 	_mg_renderer_load_shader("basic_unlit");
 	_mg_renderer_load_shader("bsp");
+	_mg_renderer_load_shader("bsp_layered");
 	_mg_renderer_load_shader("post");
 	_mg_renderer_load_shader("wireframe");
 	_mg_renderer_load_shader("bsp_wireframe");
@@ -324,7 +334,7 @@ void mg_renderer_update()
 
 	if (has_cam)
 	{
-		g_renderer->cam->fov	      = mg_cvar("r_fov")->value.i;
+		g_renderer->cam->fov	      = g_renderer->r_fov->value.i;
 		g_renderer->cam->aspect_ratio = g_renderer->fb_size.x / g_renderer->fb_size.y;
 		g_renderer->offscreen_cleared = false;
 
@@ -382,6 +392,7 @@ void mg_renderer_free()
 
 	gs_dyn_array_free(g_renderer->shader_names);
 	gs_dyn_array_free(g_renderer->shaders);
+	mg_name_map_free(&g_renderer->shader_lookup);
 	gs_dyn_array_free(g_renderer->shader_sources_frag);
 	gs_dyn_array_free(g_renderer->shader_sources_vert);
 
@@ -431,11 +442,26 @@ void mg_renderer_free()
 	g_renderer = NULL;
 }
 
+// Remembers where renderables were before the next tick moves them
+void mg_renderer_begin_tick()
+{
+	g_renderer->interpolate = true;
+	for (
+		gs_slot_array_iter it = gs_slot_array_iter_new(g_renderer->renderables);
+		gs_slot_array_iter_valid(g_renderer->renderables, it);
+		gs_slot_array_iter_advance(g_renderer->renderables, it))
+	{
+		mg_renderable_t *renderable = gs_slot_array_iter_getp(g_renderer->renderables, it);
+		renderable->prev_transform  = *renderable->transform;
+	}
+}
+
 uint32_t mg_renderer_create_renderable(mg_model_t model, gs_vqs *transform)
 {
 	mg_renderable_t renderable = {
 		.model		   = model,
 		.transform	   = transform,
+		.prev_transform	   = *transform,
 		.u_view		   = gs_vqs_to_mat4(transform),
 		.frame		   = 0,
 		.prev_frame_time   = g_time_manager->time,
@@ -466,12 +492,10 @@ mg_renderable_t *mg_renderer_get_renderable(uint32_t renderable_id)
 
 gs_handle(gs_graphics_shader_t) mg_renderer_get_shader(char *name)
 {
-	for (size_t i = 0; i < gs_dyn_array_size(g_renderer->shader_names); i++)
+	uint32_t index = mg_name_map_find(&g_renderer->shader_lookup, name);
+	if (index != MG_NAME_MAP_INVALID)
 	{
-		if (strcmp(name, g_renderer->shader_names[i]) == 0)
-		{
-			return g_renderer->shaders[i];
-		}
+		return g_renderer->shaders[index];
 	}
 
 	mg_println("ERR: mg_renderer_get_shader no shader %s", name);
@@ -628,7 +652,7 @@ void _mg_renderer_models_pass()
 		return;
 	}
 
-	bool wireframe = mg_cvar("r_wireframe")->value.i;
+	bool wireframe = g_renderer->r_wireframe->value.i;
 
 	// Uniforms that don't change per renderable
 	gs_mat4 u_proj = mg_camera_get_view_projection(g_renderer->cam, (s32)g_renderer->fb_size.x, (s32)g_renderer->fb_size.y);
@@ -687,7 +711,12 @@ void _mg_renderer_models_pass()
 		}
 
 		// View matrix
-		renderable->u_view = gs_vqs_to_mat4(renderable->transform);
+		gs_vqs transform = *renderable->transform;
+		if (g_renderer->interpolate)
+		{
+			transform = mg_vqs_lerp(&renderable->prev_transform, renderable->transform, g_time_manager->tick_alpha);
+		}
+		renderable->u_view = gs_vqs_to_mat4(&transform);
 		uniforms[1]	   = (gs_graphics_bind_uniform_desc_t){
 			       .uniform = g_renderer->u_view,
 			       .data	= &renderable->u_view,
@@ -711,7 +740,7 @@ void _mg_renderer_models_pass()
 			// Light
 			if (g_game_manager != NULL && g_game_manager->map != NULL && g_game_manager->map->valid)
 			{
-				light = bsp_sample_lightvol(g_game_manager->map, renderable->transform->position);
+				light = bsp_sample_lightvol(g_game_manager->map, transform.position);
 			}
 			else
 			{
@@ -833,7 +862,7 @@ void _mg_renderer_viewmodel_pass()
 		return;
 	}
 
-	bool wireframe = mg_cvar("r_wireframe")->value.i;
+	bool wireframe = g_renderer->r_wireframe->value.i;
 
 	// Uniforms that don't change per renderable
 	gs_mat4 u_proj = mg_camera_get_view_projection(&g_game_manager->player->viewmodel_camera, (s32)g_renderer->fb_size.x, (s32)g_renderer->fb_size.y);
@@ -1030,7 +1059,7 @@ void _mg_renderer_post_pass()
 	gs_graphics_set_viewport(&g_renderer->cb, 0, 0, (int32_t)g_renderer->fb_size.x, (int32_t)g_renderer->fb_size.y);
 	gs_graphics_pipeline_bind(&g_renderer->cb, g_renderer->post_pipe);
 
-	float32_t barrel_height = tanf(0.5 * gs_deg2rad(mg_cvar("r_fov")->value.i / g_renderer->cam->aspect_ratio));
+	float32_t barrel_height = tanf(0.5 * gs_deg2rad(g_renderer->r_fov->value.i / g_renderer->cam->aspect_ratio));
 
 	// Uniform binds
 	gs_graphics_bind_uniform_desc_t uniforms[] = {
@@ -1046,12 +1075,12 @@ void _mg_renderer_post_pass()
 		},
 		(gs_graphics_bind_uniform_desc_t){
 			.uniform = g_renderer->u_barrel_enabled,
-			.data	 = &mg_cvar("r_barrel_enabled")->value.i,
+			.data	 = &g_renderer->r_barrel_enabled->value.i,
 			.binding = 1, // VERTEX
 		},
 		(gs_graphics_bind_uniform_desc_t){
 			.uniform = g_renderer->u_barrel_strength,
-			.data	 = &mg_cvar("r_barrel_strength")->value.f,
+			.data	 = &g_renderer->r_barrel_strength->value.f,
 			.binding = 1, // VERTEX
 		},
 		(gs_graphics_bind_uniform_desc_t){
@@ -1066,7 +1095,7 @@ void _mg_renderer_post_pass()
 		},
 		(gs_graphics_bind_uniform_desc_t){
 			.uniform = g_renderer->u_barrel_cyl_ratio,
-			.data	 = &mg_cvar("r_barrel_cyl_ratio")->value.f,
+			.data	 = &g_renderer->r_barrel_cyl_ratio->value.f,
 			.binding = 4, // VERTEX
 		},
 	};
@@ -1157,6 +1186,7 @@ void _mg_renderer_load_shader(char *name)
 			.name	 = name,
 		});
 
+	mg_name_map_set(&g_renderer->shader_lookup, name, gs_dyn_array_size(g_renderer->shaders));
 	gs_dyn_array_push(g_renderer->shaders, shader);
 	// make a persistent copy
 	char *name_cpy = gs_malloc(strlen(name) + 1);
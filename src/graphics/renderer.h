@@ -18,6 +18,8 @@
 
 #include "../bsp/bsp_map.h"
 #include "../entities/player.h"
+#include "../game/config.h"
+#include "../util/name_map.h"
 #include "model_manager.h"
 #include "types.h"
 
@@ -35,6 +37,7 @@ typedef struct mg_renderable_t
 	bool hidden;
 	mg_model_type type;
 	gs_vqs *transform;
+	gs_vqs prev_transform; // at the start of the last tick
 	gs_mat4 u_view;
 	mg_model_t model;
 	mg_md3_animation_t *current_animation;
@@ -55,6 +58,7 @@ typedef struct mg_renderer_t
 	gs_handle(gs_graphics_pipeline_t) post_pipe;
 	gs_dyn_array(gs_handle(gs_graphics_shader_t)) shaders;
 	gs_dyn_array(char *) shader_names;
+	mg_name_map_t shader_lookup; // name to index in shaders
 	gs_dyn_array(char *) shader_sources_vert;
 	gs_dyn_array(char *) shader_sources_frag;
 	gs_vec2 fb_size;
@@ -85,11 +89,21 @@ typedef struct mg_renderer_t
 	gs_handle(gs_graphics_texture_t) missing_texture;
 	float clear_color[4];
 	float clear_color_overlay[4];
+	bool32_t interpolate; // world models move in ticks, draw between the last two
+
+	// Cvars read every frame, resolved once in init
+	mg_cvar_t *r_wireframe;
+	mg_cvar_t *r_occlusion;
+	mg_cvar_t *r_fov;
+	mg_cvar_t *r_barrel_enabled;
+	mg_cvar_t *r_barrel_strength;
+	mg_cvar_t *r_barrel_cyl_ratio;
 } mg_renderer_t;
 
 void mg_renderer_init(uint32_t window_handle);
 void mg_renderer_update();
 void mg_renderer_free();
+void mg_renderer_begin_tick();
 uint32_t mg_renderer_create_renderable(mg_model_t model, gs_vqs *transform);
 void mg_renderer_remove_renderable(uint32_t renderable_id);
 mg_renderable_t *mg_renderer_get_renderable(uint32_t renderable_id);
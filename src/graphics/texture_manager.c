@@ -5,11 +5,15 @@
 	* ================================
 
 	Loading and storing texture pointers by filename.
+	Requested textures are decoded on worker threads and
+	uploaded on the main thread within a frame budget.
+	Decoded pixels are kept for rebuilding on filter changes.
 =================================================================*/
 
 #include "texture_manager.h"
 #include "../game/config.h"
 #include "../game/console.h"
+#include "../util/render.h"
 #include "../util/string.h"
 
 mg_texture_manager_t *g_texture_manager;
@@ -18,164 +22,455 @@ void mg_texture_manager_init()
 {
 	g_texture_manager	    = gs_malloc_init(mg_texture_manager_t);
 	g_texture_manager->textures = gs_dyn_array_new(mg_texture_t);
+	g_texture_manager->queue    = gs_dyn_array_new(mg_texture_decode_t);
+	g_texture_manager->decoded  = gs_dyn_array_new(mg_texture_decode_t);
+	mg_name_map_init(&g_texture_manager->lookup, 256);
 
 	g_texture_manager->tex_filter = mg_cvar("r_filter")->value.i + 1;
 	g_texture_manager->mip_filter = mg_cvar("r_filter_mip")->value.i + 1;
 	g_texture_manager->num_mips   = mg_cvar("r_mips")->value.i;
+
+	// Placeholder for textures that aren't uploaded yet
+	gs_color_t *pixels		   = mg_get_missing_texture_pixels(MG_TEXTURE_MANAGER_MISSING_SIZE);
+	g_texture_manager->missing_texture = gs_graphics_texture_create(
+		&(gs_graphics_texture_desc_t){
+			.type	    = GS_GRAPHICS_TEXTURE_2D,
+			.width	    = MG_TEXTURE_MANAGER_MISSING_SIZE,
+			.height	    = MG_TEXTURE_MANAGER_MISSING_SIZE,
+			.format	    = GS_GRAPHICS_TEXTURE_FORMAT_RGBA8,
+			.min_filter = GS_GRAPHICS_TEXTURE_FILTER_NEAREST,
+			.mag_filter = GS_GRAPHICS_TEXTURE_FILTER_NEAREST,
+			.mip_filter = GS_GRAPHICS_TEXTURE_FILTER_NEAREST,
+			.num_mips   = 0,
+			.data	    = pixels});
+	gs_free(pixels);
+
+	pthread_mutex_init(&g_texture_manager->mutex, NULL);
+	pthread_cond_init(&g_texture_manager->work_cond, NULL);
+	pthread_cond_init(&g_texture_manager->done_cond, NULL);
+
+	for (size_t i = 0; i < MG_TEXTURE_MANAGER_WORKERS; i++)
+	{
+		if (pthread_create(&g_texture_manager->workers[i], NULL, _mg_texture_manager_worker, NULL) != 0)
+		{
+			mg_println("WARN: mg_texture_manager_init failed to create decode worker %zu", i);
+			break;
+		}
+		g_texture_manager->num_workers++;
+	}
 }
 
 void mg_texture_manager_free()
 {
+	pthread_mutex_lock(&g_texture_manager->mutex);
+	g_texture_manager->quit = true;
+	pthread_cond_broadcast(&g_texture_manager->work_cond);
+	pthread_mutex_unlock(&g_texture_manager->mutex);
+
+	for (size_t i = 0; i < g_texture_manager->num_workers; i++)
+	{
+		pthread_join(g_texture_manager->workers[i], NULL);
+	}
+
+	for (size_t i = g_texture_manager->queue_head; i < gs_dyn_array_size(g_texture_manager->queue); i++)
+	{
+		gs_free(g_texture_manager->queue[i].filename);
+	}
+	for (size_t i = g_texture_manager->decoded_head; i < gs_dyn_array_size(g_texture_manager->decoded); i++)
+	{
+		gs_free(g_texture_manager->decoded[i].filename);
+		gs_free(g_texture_manager->decoded[i].data);
+	}
+
 	for (size_t i = 0; i < gs_dyn_array_size(g_texture_manager->textures); i++)
 	{
-		gs_graphics_texture_destroy(g_texture_manager->textures[i].asset->hndl);
+		// Others point to the placeholder
+		if (g_texture_manager->textures[i].state == MG_TEXTURE_STATE_READY)
+		{
+			gs_graphics_texture_destroy(g_texture_manager->textures[i].asset->hndl);
+		}
 		g_texture_manager->textures[i].asset->hndl = gs_handle_invalid(gs_graphics_texture_t);
 		gs_free(g_texture_manager->textures[i].asset);
 		gs_free(g_texture_manager->textures[i].filename);
+		gs_free(g_texture_manager->textures[i].pixels);
 	}
 
+	gs_graphics_texture_destroy(g_texture_manager->missing_texture);
+	pthread_cond_destroy(&g_texture_manager->work_cond);
+	pthread_cond_destroy(&g_texture_manager->done_cond);
+	pthread_mutex_destroy(&g_texture_manager->mutex);
+
 	gs_dyn_array_free(g_texture_manager->textures);
+	mg_name_map_free(&g_texture_manager->lookup);
+	gs_dyn_array_free(g_texture_manager->queue);
+	gs_dyn_array_free(g_texture_manager->decoded);
 
 	gs_free(g_texture_manager);
 	g_texture_manager = NULL;
 }
 
+// Uploads decoded textures within the frame budget, call every frame
+void mg_texture_manager_update()
+{
+	_mg_texture_manager_upload(MG_TEXTURE_MANAGER_UPLOAD_BUDGET);
+}
+
+// Waits for every requested texture and uploads them all
+void mg_texture_manager_finish()
+{
+	while (g_texture_manager->pending > 0)
+	{
+		pthread_mutex_lock(&g_texture_manager->mutex);
+		while (g_texture_manager->decoded_head == gs_dyn_array_size(g_texture_manager->decoded))
+		{
+			pthread_cond_wait(&g_texture_manager->done_cond, &g_texture_manager->mutex);
+		}
+		pthread_mutex_unlock(&g_texture_manager->mutex);
+
+		while (_mg_texture_manager_upload(0) > 0)
+		{
+		}
+	}
+}
+
+// Rebuilds textures from their decoded pixels, nothing is read from disk
 void mg_texture_manager_set_filter(gs_graphics_texture_filtering_type tex, gs_graphics_texture_filtering_type mip, int num_mips)
 {
-	mg_println("mg_texture_manager_set_filter: reloading textures");
 	g_texture_manager->tex_filter = tex;
 	g_texture_manager->mip_filter = mip;
 	g_texture_manager->num_mips   = num_mips;
+
+	double start	 = gs_platform_elapsed_time();
+	uint32_t rebuilt = 0;
 	for (size_t i = 0; i < gs_dyn_array_size(g_texture_manager->textures); i++)
 	{
+		mg_texture_t *texture = &g_texture_manager->textures[i];
 		if (
-			g_texture_manager->textures[i].asset->desc.min_filter == tex &&
-			g_texture_manager->textures[i].asset->desc.mag_filter == tex &&
-			g_texture_manager->textures[i].asset->desc.mip_filter == mip &&
-			g_texture_manager->textures[i].asset->desc.num_mips == num_mips)
+			texture->state != MG_TEXTURE_STATE_READY ||
+			(texture->asset->desc.min_filter == tex &&
+			 texture->asset->desc.mag_filter == tex &&
+			 texture->asset->desc.mip_filter == mip &&
+			 texture->asset->desc.num_mips == num_mips))
 		{
 			continue;
 		}
 
-		gs_graphics_texture_destroy(g_texture_manager->textures[i].asset->hndl);
-		gs_assert(
-			_mg_texture_manager_load(
-				g_texture_manager->textures[i].filename,
-				g_texture_manager->textures[i].asset));
+		_mg_texture_manager_create(texture, texture->asset->desc.width, texture->asset->desc.height, texture->pixels);
+		rebuilt++;
+	}
+
+	mg_println("mg_texture_manager_set_filter: rebuilt %u textures in %.2f ms", rebuilt, gs_platform_elapsed_time() - start);
+}
+
+// Returns the texture at once, its handle is a placeholder until the
+// texture is decoded on a worker and uploaded by mg_texture_manager_update.
+// Textures that fail to load keep the placeholder.
+gs_asset_texture_t *mg_texture_manager_request(char *path)
+{
+	return g_texture_manager->textures[mg_texture_manager_request_handle(path)].asset;
+}
+
+// Like mg_texture_manager_request, returns the index in textures,
+// a stable handle for queries that shouldn't look up names.
+uint32_t mg_texture_manager_request_handle(char *path)
+{
+	// Strip any extensions from path
+	char *filename = mg_path_remove_ext(path);
+
+	uint32_t handle = mg_name_map_find(&g_texture_manager->lookup, filename);
+	if (handle != MG_NAME_MAP_INVALID)
+	{
+		gs_free(filename);
+		return handle;
+	}
+
+	handle			= gs_dyn_array_size(g_texture_manager->textures);
+	mg_texture_decode_t job = {
+		.texture  = handle,
+		.filename = mg_duplicate_string(filename),
+	};
+	_mg_texture_manager_add(filename);
+	g_texture_manager->pending++;
+
+	// No workers, decode now and upload later as usual
+	if (g_texture_manager->num_workers == 0 && !mg_texture_manager_load_pixels(job.filename, &job.width, &job.height, &job.data))
+	{
+		job.data = NULL;
+	}
+
+	pthread_mutex_lock(&g_texture_manager->mutex);
+	if (g_texture_manager->num_workers == 0)
+	{
+		gs_dyn_array_push(g_texture_manager->decoded, job);
+	}
+	else
+	{
+		gs_dyn_array_push(g_texture_manager->queue, job);
+		pthread_cond_signal(&g_texture_manager->work_cond);
 	}
+	pthread_mutex_unlock(&g_texture_manager->mutex);
+
+	return handle;
 }
 
 // Get texture pointer, load from file if required.
-// Returns NULL on failure.
+// Waits for requested textures. Returns NULL on failure.
 gs_asset_texture_t *mg_texture_manager_get(char *path)
 {
 	// Strip any extensions from path
 	char *filename = mg_path_remove_ext(path);
 
-	gs_asset_texture_t *asset = _mg_texture_manager_find(filename);
-	if (asset != NULL)
+	mg_texture_t *tex = _mg_texture_manager_find(filename);
+	if (tex != NULL && tex->state == MG_TEXTURE_STATE_PENDING)
+	{
+		mg_texture_manager_finish();
+		tex = _mg_texture_manager_find(filename);
+	}
+	if (tex != NULL)
 	{
 		gs_free(filename);
-		return asset;
+		return tex->state == MG_TEXTURE_STATE_READY ? tex->asset : NULL;
 	}
 
-	asset		 = gs_malloc_init(gs_asset_texture_t);
-	bool32_t success = _mg_texture_manager_load(filename, asset);
-	if (!success)
+	int32_t width  = 0;
+	int32_t height = 0;
+	void *data     = NULL;
+	bool32_t found = mg_texture_manager_load_pixels(filename, &width, &height, &data);
+
+	gs_asset_texture_t *asset = _mg_texture_manager_add(filename);
+	tex			  = &g_texture_manager->textures[gs_dyn_array_size(g_texture_manager->textures) - 1];
+	if (!found)
 	{
-		gs_free(asset);
-		gs_free(filename);
+		tex->state = MG_TEXTURE_STATE_FAILED;
 		return NULL;
 	}
 
-	mg_texture_t tex = (mg_texture_t){
-		.asset	  = asset,
-		.filename = filename,
-	};
-	gs_dyn_array_push(g_texture_manager->textures, tex);
-
+	_mg_texture_manager_create(tex, width, height, data);
 	return asset;
 }
 
-// Load gs_asset_texture from a file.
-bool32_t _mg_texture_manager_load(char *name, gs_asset_texture_t *asset)
+// Get texture pointer without loading, NULL if not requested or failed
+gs_asset_texture_t *mg_texture_manager_find(char *path)
+{
+	char *filename	  = mg_path_remove_ext(path);
+	mg_texture_t *tex = _mg_texture_manager_find(filename);
+	gs_free(filename);
+
+	if (tex == NULL || tex->state == MG_TEXTURE_STATE_FAILED)
+	{
+		return NULL;
+	}
+
+	return tex->asset;
+}
+
+// Handle of a requested texture, MG_NAME_MAP_INVALID if never requested
+uint32_t mg_texture_manager_find_handle(char *path)
+{
+	char *filename	= mg_path_remove_ext(path);
+	uint32_t handle = mg_name_map_find(&g_texture_manager->lookup, filename);
+	gs_free(filename);
+
+	return handle;
+}
+
+// True until a requested texture is uploaded or has failed
+bool32_t mg_texture_manager_is_pending(uint32_t handle)
+{
+	return handle < gs_dyn_array_size(g_texture_manager->textures) && g_texture_manager->textures[handle].state == MG_TEXTURE_STATE_PENDING;
+}
+
+// Decoded RGBA8 pixels at the asset size, NULL if not loaded
+const void *mg_texture_manager_get_pixels(uint32_t handle)
+{
+	if (handle >= gs_dyn_array_size(g_texture_manager->textures) || g_texture_manager->textures[handle].state != MG_TEXTURE_STATE_READY)
+	{
+		return NULL;
+	}
+
+	return g_texture_manager->textures[handle].pixels;
+}
+
+// Decode RGBA8 pixels of a texture without creating a GPU texture.
+// Caller owns data on success. Safe to call off the main thread.
+bool32_t mg_texture_manager_load_pixels(char *path, int32_t *width, int32_t *height, void **data)
 {
-	// Supported extensions
 	char extensions[2][5] = {
 		".jpg",
 		".tga",
 	};
 
+	char *name     = mg_path_remove_ext(path);
+	char *base     = mg_append_string("assets/", name);
+	char *filename = NULL;
+	bool32_t found = false;
+
+	for (size_t i = 0; i < 2 && !found; i++)
+	{
+		filename = mg_append_string(base, extensions[i]);
+		found	 = gs_platform_file_exists(filename);
+		if (!found)
+		{
+			gs_free(filename);
+			filename = NULL;
+		}
+	}
+
 	bool32_t success = false;
+	if (found)
+	{
+		uint32_t num_comps = 0;
+		success		   = gs_util_load_texture_data_from_file(filename, width, height, &num_comps, data, false);
+		if (!success)
+		{
+			mg_println("WARN: mg_texture_manager_load_pixels failed to decode %s", filename);
+		}
+	}
+	else
+	{
+		mg_println("WARN: mg_texture_manager_load_pixels could not find texture: %s", name);
+	}
 
-	// bsp textures already start with 'textures/'
-	char *path = mg_append_string("assets/", name);
+	gs_free(filename);
+	gs_free(base);
+	gs_free(name);
 
-	// Name with extension
-	size_t malloc_sz = strlen(path) + 5;
-	char *filename	 = gs_malloc(malloc_sz);
-	memset(filename, 0, malloc_sz);
-	strcat(filename, path);
-	strcat(filename, extensions[0]);
+	return success;
+}
 
-	for (size_t i = 0; i < 2; i++)
+void *_mg_texture_manager_worker(void *arg)
+{
+	pthread_mutex_lock(&g_texture_manager->mutex);
+
+	while (true)
 	{
-		if (i > 0)
+		while (!g_texture_manager->quit && g_texture_manager->queue_head == gs_dyn_array_size(g_texture_manager->queue))
 		{
-			strcpy(filename + strlen(filename) - 4, extensions[i]);
+			pthread_cond_wait(&g_texture_manager->work_cond, &g_texture_manager->mutex);
 		}
 
-		if (gs_platform_file_exists(filename))
+		if (g_texture_manager->quit)
 		{
-			success = gs_asset_texture_load_from_file(
-				filename,
-				asset,
-				&(gs_graphics_texture_desc_t){
-					.format	    = GS_GRAPHICS_TEXTURE_FORMAT_RGBA8,
-					.min_filter = g_texture_manager->tex_filter,
-					.mag_filter = g_texture_manager->tex_filter,
-					.mip_filter = g_texture_manager->mip_filter,
-					.num_mips   = g_texture_manager->num_mips,
-				},
-				false,
-				false);
+			break;
+		}
 
-			if (!success)
-			{
-				mg_println("WARN: _mg_texture_manager_load could not load texture: %s, failed to open existing file %s", name, filename);
-			}
+		mg_texture_decode_t job = g_texture_manager->queue[g_texture_manager->queue_head++];
+		if (g_texture_manager->queue_head == gs_dyn_array_size(g_texture_manager->queue))
+		{
+			gs_dyn_array_clear(g_texture_manager->queue);
+			g_texture_manager->queue_head = 0;
 		}
-		else if (i == 1)
+		pthread_mutex_unlock(&g_texture_manager->mutex);
+
+		if (!mg_texture_manager_load_pixels(job.filename, &job.width, &job.height, &job.data))
 		{
-			mg_println("WARN: _mg_texture_manager_load could not load texture: %s, file not found", name);
+			job.data = NULL;
 		}
 
-		if (success)
+		pthread_mutex_lock(&g_texture_manager->mutex);
+		gs_dyn_array_push(g_texture_manager->decoded, job);
+		pthread_cond_signal(&g_texture_manager->done_cond);
+	}
+
+	pthread_mutex_unlock(&g_texture_manager->mutex);
+	return NULL;
+}
+
+// Uploads decoded textures, at least one if there are any,
+// until budget ms have passed. Returns the number uploaded.
+uint32_t _mg_texture_manager_upload(double budget)
+{
+	double start   = gs_platform_elapsed_time();
+	uint32_t count = 0;
+
+	while (true)
+	{
+		pthread_mutex_lock(&g_texture_manager->mutex);
+		if (g_texture_manager->decoded_head == gs_dyn_array_size(g_texture_manager->decoded))
 		{
-			mg_println("_mg_texture_manager_load: Loaded texture: %s", name);
+			pthread_mutex_unlock(&g_texture_manager->mutex);
 			break;
 		}
+
+		mg_texture_decode_t job = g_texture_manager->decoded[g_texture_manager->decoded_head++];
+		if (g_texture_manager->decoded_head == gs_dyn_array_size(g_texture_manager->decoded))
+		{
+			gs_dyn_array_clear(g_texture_manager->decoded);
+			g_texture_manager->decoded_head = 0;
+		}
+		pthread_mutex_unlock(&g_texture_manager->mutex);
+
+		mg_texture_t *tex = &g_texture_manager->textures[job.texture];
+		if (job.data != NULL)
+		{
+			_mg_texture_manager_create(tex, job.width, job.height, job.data);
+		}
 		else
 		{
-			asset->hndl = gs_handle_invalid(gs_graphics_texture_t);
+			tex->state = MG_TEXTURE_STATE_FAILED;
 		}
-	}
+		gs_free(job.filename);
+		g_texture_manager->pending--;
+		count++;
 
-	gs_free(filename);
-	gs_free(path);
+		if (gs_platform_elapsed_time() - start >= budget)
+		{
+			break;
+		}
+	}
 
-	return success;
+	return count;
 }
 
-gs_asset_texture_t *_mg_texture_manager_find(char *filename)
+// (Re)creates the GPU texture with the current filter, takes ownership of data
+void _mg_texture_manager_create(mg_texture_t *tex, int32_t width, int32_t height, void *data)
 {
-	for (size_t i = 0; i < gs_dyn_array_size(g_texture_manager->textures); i++)
+	if (tex->state == MG_TEXTURE_STATE_READY)
 	{
-		if (strcmp(g_texture_manager->textures[i].filename, filename) == 0)
-		{
-			return g_texture_manager->textures[i].asset;
-		}
+		gs_graphics_texture_destroy(tex->asset->hndl);
+	}
+	if (tex->pixels != data)
+	{
+		gs_free(tex->pixels);
+		tex->pixels = data;
 	}
 
-	return NULL;
+	tex->asset->desc = (gs_graphics_texture_desc_t){
+		.type	    = GS_GRAPHICS_TEXTURE_2D,
+		.width	    = width,
+		.height	    = height,
+		.format	    = GS_GRAPHICS_TEXTURE_FORMAT_RGBA8,
+		.min_filter = g_texture_manager->tex_filter,
+		.mag_filter = g_texture_manager->tex_filter,
+		.mip_filter = g_texture_manager->mip_filter,
+		.num_mips   = g_texture_manager->num_mips,
+		.data	    = data,
+	};
+	tex->asset->hndl      = gs_graphics_texture_create(&tex->asset->desc);
+	tex->asset->desc.data = NULL;
+	tex->state	      = MG_TEXTURE_STATE_READY;
+}
+
+// Pending texture with the placeholder, takes ownership of filename
+gs_asset_texture_t *_mg_texture_manager_add(char *filename)
+{
+	gs_asset_texture_t *asset = gs_malloc_init(gs_asset_texture_t);
+	asset->hndl		  = g_texture_manager->missing_texture;
+
+	mg_texture_t tex = (mg_texture_t){
+		.asset	  = asset,
+		.filename = filename,
+		.state	  = MG_TEXTURE_STATE_PENDING,
+	};
+	mg_name_map_set(&g_texture_manager->lookup, filename, gs_dyn_array_size(g_texture_manager->textures));
+	gs_dyn_array_push(g_texture_manager->textures, tex);
+
+	return asset;
+}
+
+// Valid until the next texture is added
+mg_texture_t *_mg_texture_manager_find(char *filename)
+{
+	uint32_t index = mg_name_map_find(&g_texture_manager->lookup, filename);
+	return index != MG_NAME_MAP_INVALID ? &g_texture_manager->textures[index] : NULL;
 }
@@ -11,27 +11,79 @@
 #define MG_TEXTURE_MANAGER_H
 
 #include <gs/gs.h>
+#include <pthread.h>
+
+#include "../util/name_map.h"
+
+#define MG_TEXTURE_MANAGER_WORKERS	 3   // decode threads
+#define MG_TEXTURE_MANAGER_UPLOAD_BUDGET 4.0 // ms of uploads per frame
+#define MG_TEXTURE_MANAGER_MISSING_SIZE	 10
+
+typedef enum mg_texture_state
+{
+	MG_TEXTURE_STATE_PENDING, // decoding or waiting for upload, asset has the placeholder
+	MG_TEXTURE_STATE_READY,
+	MG_TEXTURE_STATE_FAILED, // asset keeps the placeholder
+} mg_texture_state;
 
 typedef struct mg_texture_t
 {
 	char *filename;
 	gs_asset_texture_t *asset;
+	mg_texture_state state;
+	void *pixels; // RGBA8 at the asset size, rebuilds the texture on filter changes
 } mg_texture_t;
 
+typedef struct mg_texture_decode_t
+{
+	uint32_t texture; // index in textures
+	char *filename;
+	int32_t width;
+	int32_t height;
+	void *data; // RGBA8, NULL if decoding failed
+} mg_texture_decode_t;
+
 typedef struct mg_texture_manager_t
 {
 	gs_graphics_texture_filtering_type tex_filter;
 	gs_graphics_texture_filtering_type mip_filter;
 	int num_mips;
 	gs_dyn_array(mg_texture_t) textures;
+	mg_name_map_t lookup;				  // filename to index in textures
+	gs_handle(gs_graphics_texture_t) missing_texture; // placeholder until uploaded
+
+	// Decoding, queues are guarded by mutex
+	pthread_t workers[MG_TEXTURE_MANAGER_WORKERS];
+	uint32_t num_workers;
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+	bool32_t quit;
+	gs_dyn_array(mg_texture_decode_t) queue;   // waiting for a worker
+	gs_dyn_array(mg_texture_decode_t) decoded; // waiting for upload
+	uint32_t queue_head;
+	uint32_t decoded_head;
+	uint32_t pending; // requested and not uploaded, main thread only
 } mg_texture_manager_t;
 
 void mg_texture_manager_init();
 void mg_texture_manager_free();
+void mg_texture_manager_update();
+void mg_texture_manager_finish();
 void mg_texture_manager_set_filter(gs_graphics_texture_filtering_type tex, gs_graphics_texture_filtering_type mip, int num_mips);
+gs_asset_texture_t *mg_texture_manager_request(char *path);
+uint32_t mg_texture_manager_request_handle(char *path);
 gs_asset_texture_t *mg_texture_manager_get(char *path);
-bool32_t _mg_texture_manager_load(char *path, gs_asset_texture_t *asset);
-gs_asset_texture_t *_mg_texture_manager_find(char *filename);
+gs_asset_texture_t *mg_texture_manager_find(char *path);
+uint32_t mg_texture_manager_find_handle(char *path);
+bool32_t mg_texture_manager_is_pending(uint32_t handle);
+const void *mg_texture_manager_get_pixels(uint32_t handle);
+bool32_t mg_texture_manager_load_pixels(char *path, int32_t *width, int32_t *height, void **data);
+void *_mg_texture_manager_worker(void *arg);
+uint32_t _mg_texture_manager_upload(double budget);
+void _mg_texture_manager_create(mg_texture_t *tex, int32_t width, int32_t height, void *data);
+gs_asset_texture_t *_mg_texture_manager_add(char *filename);
+mg_texture_t *_mg_texture_manager_find(char *filename);
 
 extern mg_texture_manager_t *g_texture_manager;
 
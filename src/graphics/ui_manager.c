@@ -222,6 +222,7 @@ void mg_ui_manager_render(gs_vec2 fbs, bool32_t clear)
 			gs_gui_container_t *root = gs_gui_get_current_container(&g_renderer->gui);
 			_mg_ui_manager_text_overlay(fbs, root);
 			_mg_ui_manager_dialogue_window(fbs, root);
+			_mg_ui_manager_loading_window(fbs, root);
 			_mg_ui_manager_menu_window(fbs, root);
 			_mg_ui_manager_debug_overlay(fbs, root);
 			_mg_ui_manager_console_window(fbs, root);
@@ -433,6 +434,8 @@ void _mg_ui_manager_debug_overlay(gs_vec2 fbs, gs_gui_container_t *root)
 			DRAW_TMP(10, tmp_y)
 			sprintf(tmp, "patches: %zu/%zu", g_game_manager->map->stats.visible_patches, g_game_manager->map->stats.total_patches);
 			DRAW_TMP(10, tmp_y)
+			sprintf(tmp, "draw calls: %zu", g_game_manager->map->stats.draw_calls);
+			DRAW_TMP(10, tmp_y)
 			sprintf(tmp, "leaf: %zu, cluster: %d", g_game_manager->map->stats.current_leaf, g_game_manager->map->leaves.data[g_game_manager->map->stats.current_leaf].cluster);
 			DRAW_TMP(10, tmp_y)
 			sprintf(tmp, "leaves:");
@@ -443,8 +446,33 @@ void _mg_ui_manager_debug_overlay(gs_vec2 fbs, gs_gui_container_t *root)
 			DRAW_TMP(15, tmp_y)
 			sprintf(tmp, "frustum culled: %zu", g_game_manager->map->stats.culled_leaves_frustum);
 			DRAW_TMP(15, tmp_y)
+			sprintf(tmp, "occlusion culled: %zu", g_game_manager->map->stats.culled_leaves_occlusion);
+			DRAW_TMP(15, tmp_y)
 			sprintf(tmp, "visible: %zu", g_game_manager->map->stats.visible_leaves);
 			DRAW_TMP(15, tmp_y)
+			sprintf(tmp, "vis tests:");
+			DRAW_TMP(10, tmp_y)
+			sprintf(tmp, "nodes: %zu", g_game_manager->map->stats.node_tests);
+			DRAW_TMP(15, tmp_y)
+			sprintf(tmp, "leaves: %zu", g_game_manager->map->stats.leaf_tests);
+			DRAW_TMP(15, tmp_y)
+			sprintf(tmp, "occluder tris: %zu", g_game_manager->map->stats.occluder_triangles);
+			DRAW_TMP(15, tmp_y)
+			sprintf(tmp, "time: %.2fms", g_game_manager->map->stats.vis_time * 1000.0);
+			DRAW_TMP(15, tmp_y)
+			if (g_game_manager->map->cluster_draw)
+			{
+				sprintf(tmp, "clusters:");
+				DRAW_TMP(10, tmp_y)
+				sprintf(tmp, "visible: %zu/%zu", g_game_manager->map->stats.visible_clusters, g_game_manager->map->stats.total_clusters);
+				DRAW_TMP(15, tmp_y)
+				sprintf(tmp, "occlusion culled: %zu", g_game_manager->map->stats.occluded_clusters);
+				DRAW_TMP(15, tmp_y)
+				sprintf(tmp, "ranges: %zu, max: %zu", g_game_manager->map->stats.cluster_ranges, g_game_manager->map->stats.cluster_ranges_max);
+				DRAW_TMP(15, tmp_y)
+				sprintf(tmp, "indices: %.2fMB (+%.2fMB)", g_game_manager->map->stats.cluster_index_bytes / 1048576.0, g_game_manager->map->stats.cluster_index_overhead / 1048576.0);
+				DRAW_TMP(15, tmp_y)
+			}
 		}
 
 		// draw player stats
@@ -594,6 +622,43 @@ void _mg_ui_manager_dialogue_window(gs_vec2 fbs, gs_gui_container_t *root)
 		g_ui_manager->dialogue_open = false;
 }
 
+// Map loading progress bar
+void _mg_ui_manager_loading_window(gs_vec2 fbs, gs_gui_container_t *root)
+{
+	mg_map_loader_t *loader = &g_game_manager->loader;
+	if (!loader->active) return;
+
+	char tmp[256];
+	float32_t progress = mg_map_loader_progress(loader);
+	snprintf(tmp, 256, "Loading %s: %s", loader->filename, mg_map_loader_stage_name(loader->stage));
+
+	gs_gui_set_style_sheet(&g_renderer->gui, &g_ui_manager->dialogue_style_sheet);
+
+	gs_gui_layout_set_next(&g_renderer->gui, gs_gui_layout_anchor(&root->body, fbs.x, fbs.y, 0, 0, GS_GUI_LAYOUT_ANCHOR_CENTER), 0);
+	gs_gui_panel_begin_ex(&g_renderer->gui, "#loading", NULL, GS_GUI_OPT_NOSCROLL);
+	{
+		gs_gui_container_t *loading = gs_gui_get_current_container(&g_renderer->gui);
+
+		uint32_t max_width    = 600;
+		float32_t bar_height  = 8.0f;
+		gs_asset_font_t *font = g_ui_manager->dialogue_style_sheet.styles[GS_GUI_ELEMENT_TEXT][GS_GUI_ELEMENT_STATE_DEFAULT].font;
+		float32_t line_height = gs_asset_font_max_height(font);
+
+		// draw text
+		gs_gui_layout_set_next(&g_renderer->gui, gs_gui_layout_anchor(&loading->body, max_width, line_height, 0, -line_height, GS_GUI_LAYOUT_ANCHOR_CENTER), 0);
+		gs_gui_rect_t next = gs_gui_layout_next(&g_renderer->gui);
+		gs_gui_draw_control_text(&g_renderer->gui, tmp, next, &g_ui_manager->dialogue_style_sheet.styles[GS_GUI_ELEMENT_TEXT][GS_GUI_ELEMENT_STATE_DEFAULT], 0x00);
+
+		// draw bar
+		gs_gui_layout_set_next(&g_renderer->gui, gs_gui_layout_anchor(&loading->body, max_width, bar_height, 0, 0, GS_GUI_LAYOUT_ANCHOR_CENTER), 0);
+		next = gs_gui_layout_next(&g_renderer->gui);
+		gs_gui_draw_rect(&g_renderer->gui, next, gs_color(0, 0, 0, 100));
+		next.w *= progress;
+		gs_gui_draw_rect(&g_renderer->gui, next, gs_color(255, 255, 255, 200));
+	}
+	gs_gui_panel_end(&g_renderer->gui);
+}
+
 void _mg_ui_manager_menu_window(gs_vec2 fbs, gs_gui_container_t *root)
 {
 	if (!g_ui_manager->menu_open) return;
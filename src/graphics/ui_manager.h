@@ -81,6 +81,7 @@ void _mg_ui_manager_text_overlay(gs_vec2 fbs, gs_gui_container_t *root);
 void _mg_ui_manager_debug_overlay(gs_vec2 fbs, gs_gui_container_t *root);
 void _mg_ui_manager_console_window(gs_vec2 fbs, gs_gui_container_t *root);
 void _mg_ui_manager_dialogue_window(gs_vec2 fbs, gs_gui_container_t *root);
+void _mg_ui_manager_loading_window(gs_vec2 fbs, gs_gui_container_t *root);
 void _mg_ui_manager_menu_window(gs_vec2 fbs, gs_gui_container_t *root);
 
 bool _mg_ui_manager_custom_button(const char *str);
@@ -15,6 +15,7 @@
 #include <gs/util/gs_gui.h>
 
 #include "audio/audio_manager.h"
+#include "bsp/bsp_cache.h"
 #include "bsp/bsp_loader.h"
 #include "bsp/bsp_map.h"
 #include "entities/entity_manager.h"
@@ -22,17 +23,40 @@
 #include "game/config.h"
 #include "game/console.h"
 #include "game/game_manager.h"
+#include "game/job_manager.h"
 #include "game/time_manager.h"
 #include "graphics/model_manager.h"
 #include "graphics/renderer.h"
 #include "graphics/texture_manager.h"
 #include "graphics/ui_manager.h"
 
+// Set by "-compile <map.bsp>", writes the map cache and quits
+char *compile_path = NULL;
+
+// Checked every frame, resolved once in app_init
+mg_cvar_t *vid_width	  = NULL;
+mg_cvar_t *vid_height	  = NULL;
+mg_cvar_t *vid_fullscreen = NULL;
+mg_cvar_t *vid_max_fps	  = NULL;
+mg_cvar_t *r_filter	  = NULL;
+mg_cvar_t *r_filter_mip	  = NULL;
+mg_cvar_t *r_mips	  = NULL;
+
 void app_init()
 {
+	if (compile_path != NULL)
+	{
+		mg_config_init();
+		mg_job_manager_init();
+		bsp_cache_compile(compile_path);
+		gs_quit();
+		return;
+	}
+
 	// Init managers, free in app_shutdown if adding here
 	mg_config_init();
 	mg_time_manager_init();
+	mg_job_manager_init();
 	mg_audio_manager_init();
 	mg_texture_manager_init();
 	mg_model_manager_init();
@@ -41,6 +65,14 @@ void app_init()
 	mg_ui_manager_init();
 	mg_game_manager_init();
 
+	vid_width      = mg_cvar("vid_width");
+	vid_height     = mg_cvar("vid_height");
+	vid_fullscreen = mg_cvar("vid_fullscreen");
+	vid_max_fps    = mg_cvar("vid_max_fps");
+	r_filter       = mg_cvar("r_filter");
+	r_filter_mip   = mg_cvar("r_filter_mip");
+	r_mips	       = mg_cvar("r_mips");
+
 	// Lock mouse at start by default
 	// gs_platform_lock_mouse(gs_platform_main_window(), true);
 
@@ -105,15 +137,17 @@ void app_init()
 
 void app_update()
 {
+	if (compile_path != NULL)
+	{
+		return;
+	}
+
 	mg_time_manager_update_start();
 	uint32_t main_window = gs_platform_main_window();
 
 #ifndef __ANDROID__
-	gs_vec2 window_size	  = gs_platform_window_sizev(main_window);
-	bool32_t is_fullscreen	  = gs_platform_window_fullscreen(main_window);
-	mg_cvar_t *vid_width	  = mg_cvar("vid_width");
-	mg_cvar_t *vid_height	  = mg_cvar("vid_height");
-	mg_cvar_t *vid_fullscreen = mg_cvar("vid_fullscreen");
+	gs_vec2 window_size    = gs_platform_window_sizev(main_window);
+	bool32_t is_fullscreen = gs_platform_window_fullscreen(main_window);
 	if (window_size.x != vid_width->value.i || window_size.y != vid_height->value.i)
 	{
 		gs_platform_set_window_size(main_window, vid_width->value.i, vid_height->value.i);
@@ -126,15 +160,11 @@ void app_update()
 
 	gs_platform_t *platform = gs_subsystem(platform);
 
-	mg_cvar_t *vid_max_fps = mg_cvar("vid_max_fps");
 	if (platform->time.max_fps != vid_max_fps->value.i)
 	{
 		gs_platform_set_frame_rate(vid_max_fps->value.i);
 	}
 
-	mg_cvar_t *r_filter	= mg_cvar("r_filter");
-	mg_cvar_t *r_filter_mip = mg_cvar("r_filter_mip");
-	mg_cvar_t *r_mips	= mg_cvar("r_mips");
 	if (
 		g_texture_manager->tex_filter != r_filter->value.i + 1 ||
 		g_texture_manager->mip_filter != r_filter_mip->value.i + 1 ||
@@ -144,7 +174,12 @@ void app_update()
 			r_filter->value.i + 1,
 			r_filter_mip->value.i + 1,
 			r_mips->value.i);
+		if (g_game_manager->map != NULL)
+		{
+			bsp_map_rebuild_materials(g_game_manager->map);
+		}
 	}
+	mg_texture_manager_update();
 
 #ifndef __ANDROID__
 	// If click, then lock again (in case lost)
@@ -158,8 +193,16 @@ void app_update()
 	}
 #endif
 
+	// Input every frame, movement at a fixed rate
 	mg_game_manager_update();
-	mg_entity_manager_update();
+	for (uint32_t i = 0; i < g_time_manager->ticks; i++)
+	{
+		mg_time_manager_tick();
+		mg_renderer_begin_tick();
+		mg_game_manager_tick();
+		mg_entity_manager_update();
+	}
+	mg_game_manager_interpolate();
 
 	mg_time_manager_update_end();
 
@@ -168,6 +211,14 @@ void app_update()
 
 void app_shutdown()
 {
+	if (compile_path != NULL)
+	{
+		mg_job_manager_free();
+		mg_config_free();
+		mg_console_free();
+		return;
+	}
+
 	mg_game_manager_free();
 	mg_entity_manager_free();
 	mg_renderer_free();
@@ -175,6 +226,7 @@ void app_shutdown()
 	mg_model_manager_free();
 	mg_texture_manager_free();
 	mg_audio_manager_free();
+	mg_job_manager_free();
 	mg_time_manager_free();
 	mg_config_free();
 	mg_console_free();
@@ -184,6 +236,11 @@ gs_app_desc_t gs_main(int32_t argc, char **argv)
 {
 	mg_console_init();
 
+	if (argc == 3 && strcmp(argv[1], "-compile") == 0)
+	{
+		compile_path = argv[2];
+	}
+
 	return (gs_app_desc_t){
 		.init	       = app_init,
 		.update	       = app_update,
@@ -156,6 +156,8 @@ void app_update()
 	double plat_time  = g_time_manager->time;
 	char tmp[64];
 
+	mg_texture_manager_update();
+
 	// If click, then lock again (in case lost)
 	if (gs_platform_mouse_pressed(GS_MOUSE_LBUTTON) && !gs_platform_mouse_locked() && !g_ui_manager->show_cursor)
 	{
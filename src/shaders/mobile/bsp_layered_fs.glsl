@@ -0,0 +1,53 @@
+#version 300 es
+
+in mediump vec2 tex_coord;
+in mediump vec2 lm_coord;
+flat in mediump float layer;
+
+uniform sampler2D u_tex;
+uniform sampler2D u_lm;
+uniform mediump float u_layers;
+
+out mediump vec4 frag_color;
+
+void main()
+{
+	// wrap inside the layer, gradients from unwrapped coords
+	mediump vec2 scale = vec2(1.0, 1.0 / u_layers);
+	mediump vec2 dx = dFdx(tex_coord) * scale;
+	mediump vec2 dy = dFdy(tex_coord) * scale;
+	mediump float v = fract(tex_coord.y);
+
+	if (u_layers > 1.0)
+	{
+		// cap the lod at the mip where a layer is one texel,
+		// smaller mips average neighbouring layers together
+		mediump vec2 size = vec2(textureSize(u_tex, 0));
+		mediump float layer_height = size.y * scale.y;
+		mediump float lod = log2(max(length(dx * size), length(dy * size)));
+		mediump float max_lod = log2(layer_height);
+		if (lod > max_lod)
+		{
+			dx *= exp2(max_lod - lod);
+			dy *= exp2(max_lod - lod);
+			lod = max_lod;
+		}
+
+		// keep filter taps off the neighbouring layers,
+		// half a texel of the coarser mip sampled
+		mediump float margin = 0.5 * exp2(max(ceil(lod), 0.0)) / layer_height;
+		v = clamp(v, margin, 1.0 - margin);
+	}
+
+	mediump vec2 uv = vec2(tex_coord.x, (v + layer) * scale.y);
+	mediump vec4 tex = textureGrad(u_tex, uv, dx, dy);
+	mediump vec4 lm = texture(u_lm, lm_coord);
+
+	// magic values for the look I want
+	mediump float lm_strength = 2.8;
+	mediump float gamma = 1.15;
+
+	frag_color = tex * lm * lm_strength;
+	frag_color.rgb = pow(frag_color.rgb, vec3(1.0/gamma));
+	frag_color.a = 1.0;
+}
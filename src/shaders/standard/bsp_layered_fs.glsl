@@ -0,0 +1,63 @@
+/*================================================================
+	* shaders/standard/bsp_layered_fs.glsl
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	BSP fragment shader for layered textures.
+	Layers are stacked vertically in u_tex.
+=================================================================*/
+
+#version 330 core
+
+in vec2 tex_coord;
+in vec2 lm_coord;
+flat in float layer;
+
+uniform sampler2D u_tex;
+uniform sampler2D u_lm;
+uniform float u_layers;
+
+out vec4 frag_color;
+
+void main()
+{
+	// wrap inside the layer, gradients from unwrapped coords
+	vec2 scale = vec2(1.0, 1.0 / u_layers);
+	vec2 dx = dFdx(tex_coord) * scale;
+	vec2 dy = dFdy(tex_coord) * scale;
+	float v = fract(tex_coord.y);
+
+	if (u_layers > 1.0)
+	{
+		// cap the lod at the mip where a layer is one texel,
+		// smaller mips average neighbouring layers together
+		vec2 size = vec2(textureSize(u_tex, 0));
+		float layer_height = size.y * scale.y;
+		float lod = log2(max(length(dx * size), length(dy * size)));
+		float max_lod = log2(layer_height);
+		if (lod > max_lod)
+		{
+			dx *= exp2(max_lod - lod);
+			dy *= exp2(max_lod - lod);
+			lod = max_lod;
+		}
+
+		// keep filter taps off the neighbouring layers,
+		// half a texel of the coarser mip sampled
+		float margin = 0.5 * exp2(max(ceil(lod), 0.0)) / layer_height;
+		v = clamp(v, margin, 1.0 - margin);
+	}
+
+	vec2 uv = vec2(tex_coord.x, (v + layer) * scale.y);
+	vec4 tex = textureGrad(u_tex, uv, dx, dy);
+	vec4 lm = texture(u_lm, lm_coord);
+
+	// magic values for the look I want
+	float lm_strength = 2.8;
+	float gamma = 1.15;
+
+	frag_color = tex * lm * lm_strength;
+	frag_color.rgb = pow(frag_color.rgb, vec3(1.0/gamma));
+	frag_color.a = 1.0;
+}
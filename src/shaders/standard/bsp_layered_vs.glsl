@@ -0,0 +1,31 @@
+/*================================================================
+	* shaders/standard/bsp_layered_vs.glsl
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	BSP vertex shader for layered textures.
+=================================================================*/
+
+#version 330 core
+
+layout(location = 0) in vec3 a_pos;
+layout(location = 1) in vec2 a_tex_coord;
+layout(location = 2) in vec2 a_lm_coord;
+layout(location = 3) in vec3 a_normal;
+layout(location = 4) in vec4 a_color;
+layout(location = 5) in float a_layer;
+
+uniform mat4 u_proj;
+
+out vec2 tex_coord;
+out vec2 lm_coord;
+flat out float layer;
+
+void main()
+{
+	gl_Position = u_proj * vec4(a_pos, 1.0);
+	tex_coord = a_tex_coord;
+	lm_coord = a_lm_coord;
+	layer = a_layer;
+}
@@ -0,0 +1,111 @@
+/*================================================================
+	* util/bitset.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Dense fixed size bitset with 64 bit words.
+=================================================================*/
+
+#ifndef MG_BITSET_H
+#define MG_BITSET_H
+
+#include <gs/gs.h>
+
+typedef struct mg_bitset_t
+{
+	uint32_t count;
+	uint32_t num_words;
+	uint64_t *words;
+} mg_bitset_t;
+
+static inline void mg_bitset_init(mg_bitset_t *set, uint32_t count)
+{
+	set->count     = count;
+	set->num_words = (count + 63) / 64;
+	set->words     = gs_calloc(gs_max(set->num_words, 1), sizeof(uint64_t));
+}
+
+static inline void mg_bitset_free(mg_bitset_t *set)
+{
+	gs_free(set->words);
+	set->words     = NULL;
+	set->count     = 0;
+	set->num_words = 0;
+}
+
+static inline void mg_bitset_clear(mg_bitset_t *set)
+{
+	memset(set->words, 0, set->num_words * sizeof(uint64_t));
+}
+
+static inline void mg_bitset_set(mg_bitset_t *set, uint32_t index)
+{
+	set->words[index >> 6] |= 1ull << (index & 63);
+}
+
+static inline void mg_bitset_unset(mg_bitset_t *set, uint32_t index)
+{
+	set->words[index >> 6] &= ~(1ull << (index & 63));
+}
+
+static inline bool32_t mg_bitset_test(const mg_bitset_t *set, uint32_t index)
+{
+	return (set->words[index >> 6] >> (index & 63)) & 1;
+}
+
+// Sets the bit, returns whether it was set before
+static inline bool32_t mg_bitset_test_and_set(mg_bitset_t *set, uint32_t index)
+{
+	uint64_t bit   = 1ull << (index & 63);
+	uint64_t *word = &set->words[index >> 6];
+	bool32_t was   = (*word & bit) != 0;
+	*word |= bit;
+	return was;
+}
+
+static inline uint32_t mg_bitset_count(const mg_bitset_t *set)
+{
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < set->num_words; i++)
+	{
+		count += __builtin_popcountll(set->words[i]);
+	}
+	return count;
+}
+
+// Bits set in both, sets must be the same size
+static inline uint32_t mg_bitset_count_and(const mg_bitset_t *a, const mg_bitset_t *b)
+{
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < a->num_words; i++)
+	{
+		count += __builtin_popcountll(a->words[i] & b->words[i]);
+	}
+	return count;
+}
+
+// Index of the first set bit at or after start, -1 if none.
+// for (int32_t i = mg_bitset_next(set, 0); i >= 0; i = mg_bitset_next(set, i + 1))
+static inline int32_t mg_bitset_next(const mg_bitset_t *set, uint32_t start)
+{
+	if (start >= set->count)
+	{
+		return -1;
+	}
+
+	uint32_t w    = start >> 6;
+	uint64_t word = set->words[w] & (~0ull << (start & 63));
+	while (word == 0)
+	{
+		if (++w >= set->num_words)
+		{
+			return -1;
+		}
+		word = set->words[w];
+	}
+
+	return (int32_t)(w * 64 + __builtin_ctzll(word));
+}
+
+#endif // MG_BITSET_H
@@ -15,6 +15,19 @@
 
 #include "transform.h"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MG_CAMERA_SIMD_WIDTH 8
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MG_CAMERA_SIMD_WIDTH 4
+#else
+#define MG_CAMERA_SIMD_WIDTH 1
+#endif
+
+// All six planes set in a frustum plane mask
+#define MG_CAMERA_FRUSTUM_MASK_ALL 0x3F
+
 #ifdef WIN32
 // stupid...
 #undef near
@@ -128,4 +141,137 @@ static inline bool mg_camera_aabb_in_frustum(const mg_camera_frustum_t fr, const
 	return true;
 }
 
+// AABB test against the planes set in mask.
+// Clears bits of planes the box is fully inside of,
+// boxes contained by this one can skip testing them.
+static inline bool mg_camera_aabb_in_frustum_masked(const mg_camera_frustum_t *fr, const gs_vec3 mins, const gs_vec3 maxs, uint8_t *mask)
+{
+	for (size_t i = 0; i < 6; i++)
+	{
+		if (!(*mask & (1 << i))) continue;
+
+		gs_vec4 plane = fr->planes[i];
+
+		// Corners furthest along and against the plane normal
+		float p_dist = plane.x * (plane.x >= 0 ? maxs.x : mins.x) + plane.y * (plane.y >= 0 ? maxs.y : mins.y) + plane.z * (plane.z >= 0 ? maxs.z : mins.z) + plane.w;
+		float n_dist = plane.x * (plane.x >= 0 ? mins.x : maxs.x) + plane.y * (plane.y >= 0 ? mins.y : maxs.y) + plane.z * (plane.z >= 0 ? mins.z : maxs.z) + plane.w;
+
+		if (p_dist < 0)
+		{
+			return false;
+		}
+
+		if (n_dist >= 0)
+		{
+			*mask &= ~(1 << i);
+		}
+	}
+
+	return true;
+}
+
+// Batched AABB test, boxes are given in SoA layout
+// (mins[0] = all min x, mins[1] = all min y, ...).
+// Uses the box corner furthest along each plane normal,
+// box is outside if that corner is behind any plane.
+// Writes 1 to visible[i] if box is inside or intersecting.
+// Returns the number of visible boxes.
+static inline uint32_t mg_camera_aabbs_in_frustum(const mg_camera_frustum_t *fr, const float *const mins[3], const float *const maxs[3], const uint32_t count, uint8_t *visible)
+{
+	// Plane is uniform across the batch,
+	// so corner selection is per plane only.
+	const float *px[6];
+	const float *py[6];
+	const float *pz[6];
+	for (size_t p = 0; p < 6; p++)
+	{
+		px[p] = fr->planes[p].x >= 0 ? maxs[0] : mins[0];
+		py[p] = fr->planes[p].y >= 0 ? maxs[1] : mins[1];
+		pz[p] = fr->planes[p].z >= 0 ? maxs[2] : mins[2];
+	}
+
+	uint32_t num_visible = 0;
+	uint32_t i	     = 0;
+
+#if MG_CAMERA_SIMD_WIDTH == 8
+	__m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+	for (size_t p = 0; p < 6; p++)
+	{
+		plane_x[p] = _mm256_set1_ps(fr->planes[p].x);
+		plane_y[p] = _mm256_set1_ps(fr->planes[p].y);
+		plane_z[p] = _mm256_set1_ps(fr->planes[p].z);
+		plane_w[p] = _mm256_set1_ps(fr->planes[p].w);
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+		for (size_t p = 0; p < 6; p++)
+		{
+			__m256 xy   = _mm256_add_ps(_mm256_mul_ps(plane_x[p], _mm256_loadu_ps(px[p] + i)), _mm256_mul_ps(plane_y[p], _mm256_loadu_ps(py[p] + i)));
+			__m256 zw   = _mm256_add_ps(_mm256_mul_ps(plane_z[p], _mm256_loadu_ps(pz[p] + i)), plane_w[p]);
+			__m256 dist = _mm256_add_ps(xy, zw);
+			inside	    = _mm256_and_ps(inside, _mm256_cmp_ps(dist, zero, _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		for (size_t k = 0; k < 8; k++)
+		{
+			visible[i + k] = (mask >> k) & 1;
+			num_visible += visible[i + k];
+		}
+	}
+#elif MG_CAMERA_SIMD_WIDTH == 4
+	__m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+	for (size_t p = 0; p < 6; p++)
+	{
+		plane_x[p] = _mm_set1_ps(fr->planes[p].x);
+		plane_y[p] = _mm_set1_ps(fr->planes[p].y);
+		plane_z[p] = _mm_set1_ps(fr->planes[p].z);
+		plane_w[p] = _mm_set1_ps(fr->planes[p].w);
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (size_t p = 0; p < 6; p++)
+		{
+			__m128 xy   = _mm_add_ps(_mm_mul_ps(plane_x[p], _mm_loadu_ps(px[p] + i)), _mm_mul_ps(plane_y[p], _mm_loadu_ps(py[p] + i)));
+			__m128 zw   = _mm_add_ps(_mm_mul_ps(plane_z[p], _mm_loadu_ps(pz[p] + i)), plane_w[p]);
+			__m128 dist = _mm_add_ps(xy, zw);
+			inside	    = _mm_and_ps(inside, _mm_cmpge_ps(dist, zero));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (size_t k = 0; k < 4; k++)
+		{
+			visible[i + k] = (mask >> k) & 1;
+			num_visible += visible[i + k];
+		}
+	}
+#endif
+
+	// Scalar fallback and remainder,
+	// same operation order as the SIMD paths.
+	for (; i < count; i++)
+	{
+		visible[i] = 1;
+		for (size_t p = 0; p < 6; p++)
+		{
+			float xy = fr->planes[p].x * px[p][i] + fr->planes[p].y * py[p][i];
+			float zw = fr->planes[p].z * pz[p][i] + fr->planes[p].w;
+			if (!(xy + zw >= 0))
+			{
+				visible[i] = 0;
+				break;
+			}
+		}
+		num_visible += visible[i];
+	}
+
+	return num_visible;
+}
+
 #endif // MG_UTIL_CAMERA_H
\ No newline at end of file
@@ -0,0 +1,51 @@
+/*================================================================
+	* util/hash.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Non-cryptographic 64-bit hashing for checksums and lookups.
+=================================================================*/
+
+#ifndef MG_HASH_H
+#define MG_HASH_H
+
+#include <gs/gs.h>
+
+#define MG_HASH_SEED  0x9e3779b97f4a7c15ull
+#define MG_HASH_PRIME 0x100000001b3ull
+
+// Final avalanche from MurmurHash3
+static inline uint64_t mg_hash_mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+// Hashes 8 bytes at a time, chain calls by passing the previous result as seed
+static inline uint64_t mg_hash_bytes(const void *data, size_t size, uint64_t seed)
+{
+	const uint8_t *bytes = data;
+	uint64_t h	     = seed ^ (size * MG_HASH_PRIME);
+
+	while (size >= sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, bytes, sizeof(uint64_t));
+		h = (h ^ mg_hash_mix(word)) * MG_HASH_PRIME;
+		bytes += sizeof(uint64_t);
+		size -= sizeof(uint64_t);
+	}
+
+	uint64_t tail = 0;
+	memcpy(&tail, bytes, size);
+	h = (h ^ mg_hash_mix(tail)) * MG_HASH_PRIME;
+
+	return mg_hash_mix(h);
+}
+
+#endif // MG_HASH_H
@@ -0,0 +1,158 @@
+/*================================================================
+	* util/name_map.h
+	*
+	* Copyright (c) 2022 Lauri Räsänen
+	* ================================
+
+	Open addressing hash map from names to registry indices.
+	Keys are interned into one string buffer owned by the map.
+	Registries return the index as a stable handle so hot
+	paths can skip hashing names altogether.
+=================================================================*/
+
+#ifndef MG_NAME_MAP_H
+#define MG_NAME_MAP_H
+
+#include <gs/gs.h>
+
+#include "hash.h"
+
+#define MG_NAME_MAP_INVALID	 UINT32_MAX
+#define MG_NAME_MAP_MIN_CAPACITY 16 // power of two
+
+typedef struct mg_name_map_slot_t
+{
+	uint64_t hash; // 0 for empty slots
+	uint32_t name; // offset in names
+	uint32_t value;
+} mg_name_map_slot_t;
+
+typedef struct mg_name_map_t
+{
+	mg_name_map_slot_t *slots;
+	uint32_t capacity; // power of two
+	uint32_t count;
+	gs_dyn_array(char) names; // interned keys, null terminated
+} mg_name_map_t;
+
+static inline void mg_name_map_init(mg_name_map_t *map, uint32_t count)
+{
+	// Keep the load factor under 3/4 for count names
+	uint32_t capacity = MG_NAME_MAP_MIN_CAPACITY;
+	while (capacity * 3 < count * 4)
+	{
+		capacity *= 2;
+	}
+
+	map->slots    = gs_calloc(capacity, sizeof(mg_name_map_slot_t));
+	map->capacity = capacity;
+	map->count    = 0;
+	map->names    = NULL;
+}
+
+static inline void mg_name_map_free(mg_name_map_t *map)
+{
+	gs_free(map->slots);
+	gs_dyn_array_free(map->names);
+	map->slots    = NULL;
+	map->names    = NULL;
+	map->capacity = 0;
+	map->count    = 0;
+}
+
+static inline uint64_t mg_name_map_hash(const char *name)
+{
+	uint64_t hash = mg_hash_bytes(name, strlen(name), MG_HASH_SEED);
+	return hash != 0 ? hash : 1;
+}
+
+static inline const char *mg_name_map_key(const mg_name_map_t *map, const mg_name_map_slot_t *slot)
+{
+	return map->names + slot->name;
+}
+
+// Slot holding name, or the empty slot where it would be inserted
+static inline mg_name_map_slot_t *_mg_name_map_slot(const mg_name_map_t *map, const char *name, uint64_t hash)
+{
+	uint32_t mask = map->capacity - 1;
+	for (uint32_t i = hash & mask;; i = (i + 1) & mask)
+	{
+		mg_name_map_slot_t *slot = &map->slots[i];
+		if (slot->hash == 0 || (slot->hash == hash && strcmp(mg_name_map_key(map, slot), name) == 0))
+		{
+			return slot;
+		}
+	}
+}
+
+static inline void _mg_name_map_grow(mg_name_map_t *map)
+{
+	mg_name_map_slot_t *old = map->slots;
+	uint32_t old_capacity	= map->capacity;
+
+	map->capacity = old_capacity * 2;
+	map->slots    = gs_calloc(map->capacity, sizeof(mg_name_map_slot_t));
+
+	for (uint32_t i = 0; i < old_capacity; i++)
+	{
+		if (old[i].hash == 0)
+		{
+			continue;
+		}
+
+		uint32_t mask = map->capacity - 1;
+		uint32_t j    = old[i].hash & mask;
+		while (map->slots[j].hash != 0)
+		{
+			j = (j + 1) & mask;
+		}
+		map->slots[j] = old[i];
+	}
+
+	gs_free(old);
+}
+
+// Returns the value for name, MG_NAME_MAP_INVALID if not found
+static inline uint32_t mg_name_map_find(const mg_name_map_t *map, const char *name)
+{
+	mg_name_map_slot_t *slot = _mg_name_map_slot(map, name, mg_name_map_hash(name));
+	return slot->hash != 0 ? slot->value : MG_NAME_MAP_INVALID;
+}
+
+// Inserts or replaces the value for name, returns the previous value
+// or MG_NAME_MAP_INVALID if name is new
+static inline uint32_t mg_name_map_set(mg_name_map_t *map, const char *name, uint32_t value)
+{
+	uint64_t hash		 = mg_name_map_hash(name);
+	mg_name_map_slot_t *slot = _mg_name_map_slot(map, name, hash);
+	if (slot->hash != 0)
+	{
+		uint32_t previous = slot->value;
+		slot->value	  = value;
+		return previous;
+	}
+
+	if ((map->count + 1) * 4 > map->capacity * 3)
+	{
+		_mg_name_map_grow(map);
+		slot = _mg_name_map_slot(map, name, hash);
+	}
+
+	uint32_t offset = gs_dyn_array_size(map->names);
+	size_t length	= strlen(name) + 1;
+	for (size_t i = 0; i < length; i++)
+	{
+		gs_dyn_array_push(map->names, name[i]);
+	}
+
+	*slot = (mg_name_map_slot_t){
+		.hash  = hash,
+		.name  = offset,
+		.value = value,
+	};
+	map->count++;
+
+	return MG_NAME_MAP_INVALID;
+}
+
+#endif // MG_NAME_MAP_H
@@ -78,4 +78,33 @@ static inline gs_vec3 mg_int16_to_vec3(int16_t value)
 	return vec;
 }
 
+// Blends position and scale linearly and rotation along the shorter arc.
+// Fine for the small steps between simulation ticks.
+static inline gs_vqs mg_vqs_lerp(const gs_vqs *a, const gs_vqs *b, float32_t t)
+{
+	gs_vqs out;
+	for (size_t i = 0; i < 3; i++)
+	{
+		out.position.xyz[i] = a->position.xyz[i] + (b->position.xyz[i] - a->position.xyz[i]) * t;
+		out.scale.xyz[i]    = a->scale.xyz[i] + (b->scale.xyz[i] - a->scale.xyz[i]) * t;
+	}
+
+	float32_t dot  = a->rotation.x * b->rotation.x + a->rotation.y * b->rotation.y + a->rotation.z * b->rotation.z + a->rotation.w * b->rotation.w;
+	float32_t sign = dot < 0 ? -1.0f : 1.0f;
+	float32_t len2 = 0;
+	for (size_t i = 0; i < 4; i++)
+	{
+		out.rotation.xyzw[i] = a->rotation.xyzw[i] + (sign * b->rotation.xyzw[i] - a->rotation.xyzw[i]) * t;
+		len2 += out.rotation.xyzw[i] * out.rotation.xyzw[i];
+	}
+
+	float32_t inv_len = len2 > 0 ? 1.0f / sqrtf(len2) : 0;
+	for (size_t i = 0; i < 4; i++)
+	{
+		out.rotation.xyzw[i] *= inv_len;
+	}
+
+	return out;
+}
+
 #endif // MG_TRANSFORM_H
\ No newline at end of file